@@ -1,11 +1,13 @@
 #pragma once
 
 #include <Arduino.h>
-#include <HardwareSerial.h>
 #include <bms2.h>
+#include "bms_uart.h"
 
-// ---- Expose the BMS instance for other modules (MQTT, CAN, Web UI) ----
-extern HardwareSerial& bmsSerial;
+// ---- BMS link and library instance ----
+// Owned by the BMS task once bmsInit() returns; other modules read the
+// published snapshot (bms_snapshot.h), never bms.get_*().
+extern BmsUart bmsSerial;
 extern OverkillSolarBms2 bms;
 
 // ---- UI-driven BMS MOSFET tracking ----
@@ -18,19 +20,33 @@ extern bool pendingMosdisChange;
 extern float inputWatt;
 extern float outputWatt;
 
-// ---- Loop helpers ----
-void bmsLoopInit();   // call once in setup()
-void bmsLoopTick();   // call every loop()
-
-
-// ---- Init RS485 + bind callbacks + first poll ----
+// ---- BMS task (core 1): RS485 request engine, poll schedule, param refresh ----
+void bmsTaskStart();  // called by bmsInit()
+
+
+// ---- Adaptive poll schedule (written by the BMS task, read anywhere) ----
+struct BmsPollInfo {
+  uint32_t basicIntervalMs;     // 0x03, 250 ms .. 4 s
+  uint32_t cellsIntervalMs;     // 0x04, 500 ms .. 8 s
+  uint32_t basicPolls;
+  uint32_t cellsPolls;
+  uint32_t basicFails;
+  uint32_t cellsFails;
+  bool     nearLimit;           // a cell is near the OV/UV trigger
+  uint32_t basicRttLastUs;      // request written -> reply parsed
+  uint32_t basicRttMaxUs;
+  uint32_t basicRttAvgUs;
+  uint32_t cellsRttLastUs;
+  uint32_t cellsRttMaxUs;
+  uint32_t cellsRttAvgUs;
+  uint32_t roundLastUs;         // whole round (0x03 and/or 0x04) queued -> last reply
+  uint32_t roundMaxUs;
+};
+void bmsPollInfoGet(BmsPollInfo& out);
+
+// ---- Init RS485 + bind callbacks + EEPROM params, then start the BMS task ----
 void bmsInit();
 // ---- Battery Master feature ----
 void batteryMasterInit();
 // ---- Non-blocking tick. Call once per loop ----
 void applyBatteryMasterIfChanged();
-
-// ---- Poll BMS now (blocking) ----
-inline void bmsPoll(bool force = true) {
-  bms.main_task(force);
-}
@@ -0,0 +1,34 @@
+#pragma once
+#include <Arduino.h>
+
+// ---- NVS layout version; bump when BmsParams changes shape ----
+#define BMS_PARAMS_NVS_VERSION 1
+
+// ---- Background refresh cadence (factory-mode reads are slow) ----
+#ifndef BMS_PARAMS_REFRESH_MS
+#define BMS_PARAMS_REFRESH_MS (6UL * 60UL * 60UL * 1000UL)
+#endif
+
+// ---- Cached BMS EEPROM parameters (served from RAM) ----
+struct BmsParams {
+  uint16_t fullChargeMv   = 0;  // 0x12
+  uint16_t emptyMv        = 0;  // 0x13
+  uint32_t designCapMah   = 0;  // 0x10
+  uint32_t cycleCapMah    = 0;  // 0x11
+  uint16_t cellOvTrigMv   = 0;  // 0x24
+  uint16_t cellUvTrigMv   = 0;  // 0x26
+};
+
+extern BmsParams bmsParams;
+extern bool      bmsParamsValid;
+extern uint32_t  bmsParamsLoadedMs;   // millis() of last successful BMS read (0 = from NVS, age unknown)
+
+// ---- Load from NVS; reads the BMS once if nothing usable is stored ----
+void bmsParamsInit();
+
+// ---- Ask for a fresh factory-mode read (runs once the CAN bus is quiet) ----
+void bmsParamsRequestRefresh();
+bool bmsParamsRefreshPending();
+
+// ---- Called by the BMS task; runs scheduled / requested refreshes ----
+void bmsParamsTick();
@@ -0,0 +1,58 @@
+#pragma once
+#include <Arduino.h>
+
+// ---- BMS state as a plain POD copy, built once per completed poll ----
+// Published with a seqlock: the single writer (the BMS poll context) never
+// waits, readers on any task/core copy it out and retry if a publish raced
+// them. Every CAN payload builder, MQTT and the web UI read this instead of
+// calling bms.get_*() or the live config fields.
+#define BMS_SNAP_CELLS 16       // cell slots carried in the EcoFlow payloads
+#define BMS_SNAP_NTCS  4
+
+struct BmsSnapshot {
+  uint32_t seq;                 // seqlock sequence: even when stable, +2 per publish; 0 = nothing published yet
+  uint32_t takenMs;
+  uint32_t basicMs;             // millis() of the 0x03 / 0x04 reply behind the values (0 = none yet)
+  uint32_t cellsMs;
+
+  // As reported by the BMS
+  uint16_t cellMv[BMS_SNAP_CELLS];   // 0 beyond numCells
+  uint8_t  numCells;
+  uint16_t minCellMv;           // over numCells (0 when none)
+  uint16_t maxCellMv;
+  uint16_t bmsPackMv;
+  int32_t  packMa;              // + charging / - discharging
+  uint8_t  bmsSoc;
+  uint8_t  numNtcs;
+  int16_t  ntcDeciC[BMS_SNAP_NTCS];
+  uint32_t balanceMah;          // remaining capacity
+  uint32_t rateMah;
+  int32_t  inputW;              // charge power, 0 while discharging
+  int32_t  outputW;             // discharge power (negative), 0 while charging
+  bool     moschg;
+  bool     mosdis;
+
+  // Values sent to the PowerStream: BMS-derived when config.batt is set,
+  // otherwise the manual values from the web UI
+  uint8_t  soc;
+  uint16_t packMv;
+  uint8_t  temp;
+  uint32_t chgRuntimeMin;
+  uint32_t disRuntimeMin;
+};
+
+// Effective data age: the older of the two registers (UINT32_MAX until both were read)
+inline uint32_t bmsSnapshotDataAgeMs(const BmsSnapshot& s) {
+  if (!s.basicMs || !s.cellsMs) return UINT32_MAX;
+  const uint32_t now = millis();
+  const uint32_t a = now - s.basicMs, b = now - s.cellsMs;
+  return a > b ? a : b;
+}
+
+void     bmsSnapshotPublish(const BmsSnapshot& s);   // writer side only (sets seq/takenMs)
+void     bmsSnapshotGet(BmsSnapshot& out);           // consistent copy, lock-free
+uint32_t bmsSnapshotSeq();                           // cheap change detection (odd while a publish is in progress)
+
+// Manual values changed outside the poll: republish from the BMS context
+void     bmsSnapshotRequestRebuild();
+bool     bmsSnapshotTakeRebuild();
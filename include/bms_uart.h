@@ -0,0 +1,47 @@
+#pragma once
+#include <Arduino.h>
+#include "driver/uart.h"
+
+// ---- RS485 BMS link on the ESP-IDF UART driver ----
+// A Stream for the JBD library (available/read/write/flush go straight to the
+// driver's ring buffers) plus frame-level wake-ups for the BMS task: the
+// driver flags a 0x77 stop byte followed by line idle (a 0x77 inside cell
+// data is followed by the next byte, not idle), and its RX timeout catches
+// frames that ended any other way.
+#ifndef BMS_UART_RX_BUF
+#define BMS_UART_RX_BUF    512
+#endif
+#define BMS_UART_TX_BUF    256
+#define BMS_UART_EVQ_LEN   16
+#define BMS_UART_POST_IDLE 12     // bit times of idle after 0x77 that make it a stop byte
+#define BMS_UART_RX_TOUT   3      // symbol times of idle that end a frame without one
+
+struct BmsUartStats {
+  uint32_t frames;        // stop-byte wake-ups
+  uint32_t rxTimeouts;    // idle-line wake-ups
+  uint32_t overruns;      // FIFO / ring overflows (input flushed)
+  uint32_t lineErrors;    // framing / parity
+};
+
+class BmsUart : public Stream {
+public:
+  bool begin(uart_port_t port, uint32_t baud, int rxPin, int txPin);
+
+  // Block up to timeoutMs for the end of a frame; false on timeout or on
+  // events that do not end one
+  bool waitFrame(uint32_t timeoutMs);
+  void stats(BmsUartStats& out) const { out = st; }
+
+  int    available() override;
+  int    read() override;
+  int    peek() override;
+  void   flush() override;        // waits for TX to leave the shift register
+  size_t write(uint8_t c) override;
+  size_t write(const uint8_t* buf, size_t n) override;
+
+private:
+  uart_port_t   port   = UART_NUM_1;
+  QueueHandle_t events = nullptr;
+  int           peeked = -1;
+  BmsUartStats  st     = {};
+};
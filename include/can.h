@@ -10,23 +10,91 @@
   #define TWAI_TXQ 16
 #endif
 
-// ---- CAN state ----
-extern bool twai_ok;
+// ---- Software RX ring between canRxTask and canDecodeTask (power of two) ----
+#ifndef CAN_RX_RING
+  #define CAN_RX_RING 256
+#endif
 
-extern QueueHandle_t canRxQ;
+// ---- Compact RX frame record ----
+struct CanFrame {
+  uint32_t ts_us;     // micros() at reception
+  uint32_t id;        // identifier (29-bit when extended)
+  uint8_t  dlc;
+  uint8_t  flags;     // CAN_FRAME_EXTD | CAN_FRAME_RTR
+  uint8_t  data[8];
+};
+#define CAN_FRAME_EXTD 0x01
+#define CAN_FRAME_RTR  0x02
+
+// ---- CAN state ----
+extern bool twai_ok;     // the installed transport (can_transport.h) is started
 
 extern volatile uint32_t can_rx_count;
 extern volatile uint32_t can_rx_dropped;
 extern volatile uint32_t can_decoded;
 
-// ---- Driver initialiser ----
+// ---- Driver alert counters (canRxTask) ----
+extern volatile uint32_t can_alert_wakeups;
+extern volatile uint32_t can_rx_overruns;
+extern volatile uint32_t can_bus_errors;
+extern volatile uint32_t can_err_passive;
+extern volatile uint32_t can_bus_off;
+extern volatile uint32_t can_bus_recovered;
+extern volatile uint32_t can_tx_failed;
+
+// ---- RX ring depth / high-water mark ----
+uint32_t canRxRingDepth();
+uint32_t canRxRingHighWater();
+
+// ---- Driver initialiser: starts the transport set with canSetTransport() ----
 void canInitDriver();
 
+// ---- Acceptance filter: consumed IDs only, or everything while CAN logging is live ----
+bool canFilterPromiscuous();
+void canFilterTick();   // call from loop(); reinstalls the driver when the mode flips
+
 // ---- Create RX queue + start tasks if driver ok ----
 void canStartTasks();
 
 // ---- /can_try_init Link ---- 
 bool canTryInitAndStart();
 
-// ---- CAN Frame EcoFlow sender ----
+// ---- Task bodies, one pass each: the FreeRTOS tasks loop on these, host harnesses call them ----
+void canRxPoll(uint32_t waitMs);   // wait for transport events, drain frames into the RX ring
+void canDecodePoll();              // decode everything in the ring, then expire stalled streams
+void canTxPoll();                  // send every queued message, high priority first
+
+// ---- CAN Frame EcoFlow sender (blocking; canTxTask only) ----
 bool sendCANFrame(uint32_t can_id, const uint8_t* data, uint8_t len);
+
+// ---- TX task: whole multi-frame messages, submitted without blocking ----
+#ifndef CAN_TX_MSG_MAX
+  #define CAN_TX_MSG_MAX 256     // header + payload + CRC of the largest message
+#endif
+#ifndef CAN_TX_Q_HIGH
+  #define CAN_TX_Q_HIGH 4
+  #define CAN_TX_Q_NORM 8
+#endif
+
+enum CanTxPrio : uint8_t { CAN_TX_HIGH = 0, CAN_TX_NORMAL = 1 };   // HIGH = heartbeat replies
+#define CAN_TX_LEN_PREFIX 0x01   // A0-style framing: [len][<=7 data]
+
+// Called by canTxTask right after the first frame went to the driver
+typedef void (*CanTxFirstFrameCb)(uint32_t tagUs);
+
+// Copies bytes; returns false at once if that priority's queue is full
+bool canSubmit(CanTxPrio prio, uint32_t idFirst, uint32_t idMiddle, uint32_t idLast,
+               const uint8_t* bytes, size_t len, uint8_t flags = 0,
+               CanTxFirstFrameCb onFirst = nullptr, uint32_t tagUs = 0);
+
+struct CanTxStats {
+  uint32_t depth[2];
+  uint32_t submitted[2];
+  uint32_t rejected[2];      // queue full / oversize
+  uint32_t waitLastUs[2];    // time in queue
+  uint32_t waitAvgUs[2];
+  uint32_t waitMaxUs[2];
+  uint32_t sent;
+  uint32_t failed;           // a frame failed; rest of that message dropped
+};
+void canTxGetStats(CanTxStats& out);
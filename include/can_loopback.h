@@ -0,0 +1,50 @@
+#pragma once
+#include "can_transport.h"
+#include "spsc_ring.h"
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+
+// ---- In-process bus: a frame sent on one port is received by the other ----
+// Each port owns a drop-oldest RX ring filled by its peer's send(). send()
+// waits up to timeoutMs while the peer ring is full, so a fast producer is
+// throttled instead of losing frames. Works on the board and on the host.
+#ifndef CAN_LOOPBACK_RING
+#define CAN_LOOPBACK_RING 1024      // frames per port (power of two)
+#endif
+
+class CanLoopbackPort : public CanTransport {
+public:
+  const char* name() const override { return "loopback"; }
+
+  bool     start(const CanFilter& filter) override;
+  void     stop() override;
+  bool     send(const CanFrame& f, uint32_t timeoutMs) override;
+  uint32_t wait(uint32_t timeoutMs) override;
+  bool     receive(CanFrame& f) override;
+  void     status(CanTransportStatus& out) override;
+
+private:
+  friend class CanLoopbackBus;
+  bool deliver(const CanFrame& f, uint32_t timeoutMs);   // peer side
+
+  CanLoopbackPort*  peer_    = nullptr;
+  CanFilter         filter_  = { 0, 0x1FFFFFFF };
+  std::atomic<bool> started_{false};
+  std::atomic<bool> rxWaiting_{false};    // wait() is blocked on cv_
+  std::atomic<bool> txWaiting_{false};    // peer send() is blocked for space
+  uint32_t          dropsSeen_ = 0;
+  SpscRing<CanFrame, CAN_LOOPBACK_RING> rx_;
+  std::mutex              mu_;
+  std::condition_variable cv_;
+};
+
+class CanLoopbackBus {
+public:
+  CanLoopbackBus() { a_.peer_ = &b_; b_.peer_ = &a_; }
+  CanLoopbackPort& a() { return a_; }
+  CanLoopbackPort& b() { return b_; }
+
+private:
+  CanLoopbackPort a_, b_;
+};
@@ -0,0 +1,46 @@
+#pragma once
+#include <Arduino.h>
+#include <ESPAsyncWebServer.h>
+#include "can_trace.h"
+
+// ---- Background CAN recorder: binary trace files on SD (SPIFFS fallback) ----
+// File layout: one 20-byte CanRecHeader, then raw CanTraceRec records.
+// Records reach the recorder through one lock-free ring per direction, fed
+// by the CAN RX/TX tasks themselves (canTraceRecord), whatever the /log
+// state; a low-priority task merges them by time, batches them into 4 KB
+// blocks and owns every write, rotation and cleanup.
+#ifndef CANREC_RING
+#define CANREC_RING       512        // records per direction buffered ahead of the task (power of two)
+#endif
+#define CANREC_BLOCK      4096       // write granularity
+#define CANREC_DIR        "/canrec"
+#define CANREC_FLUSH_MS   5000       // partial block written after this long
+#define CANREC_ROTATE_MS  3600000UL  // new file at least every hour
+
+// Per-medium limits: SD has room for many large files, SPIFFS shares the web UI partition
+#define CANREC_SD_FILE_MAX      (8UL * 1024 * 1024)
+#define CANREC_SD_KEEP          48
+#define CANREC_SPIFFS_FILE_MAX  (256UL * 1024)
+#define CANREC_SPIFFS_KEEP      3
+
+#define CANREC_MAGIC   0x524E4143UL  // "CANR"
+#define CANREC_VERSION 1
+
+struct CanRecHeader {
+  uint32_t magic;
+  uint8_t  version;
+  uint8_t  recSize;      // sizeof(CanTraceRec)
+  uint8_t  rsv[2];
+  uint32_t wallSec;      // wall clock when the file was opened (0 = no NTP)
+  uint32_t wallUsec;
+  uint32_t anchorUs;     // micros() at that instant; record time = wall + (ts_us - anchorUs)
+};
+static_assert(sizeof(CanRecHeader) == 20, "CanRecHeader must stay 20 bytes");
+
+void canRecInit();                   // mount SD (or fall back to SPIFFS), start the task
+bool canRecActive();                 // recording enabled and a medium is mounted
+void canRecSetEnabled(bool on);      // persisted; applied by the task
+void canRecPush(const CanTraceRec& r);   // producer side: one task per direction (r.dir)
+
+void canRecStatusJson(String& out);
+void canRecRoutes(AsyncWebServer& server);   // /api/canrec, start/stop, file download
@@ -0,0 +1,36 @@
+#pragma once
+#include <Arduino.h>
+
+// ---- Binary CAN trace: fixed 20-byte records, formatted only when drained ----
+// RX frames are recorded by canDecodeTask, TX frames by canTxTask (one
+// producer per ring), so the hot paths pay a gate check and a memcpy.
+// Each record goes to the /log rings below, drained by the trace pump in
+// webTick(), and straight to the recorder's own rings (can_rec.h), so a
+// capture does not depend on loop() or on the UI logging flags.
+#ifndef CAN_TRACE_RING
+#define CAN_TRACE_RING 256      // records per direction (power of two)
+#endif
+
+enum CanTraceDir : uint8_t { CAN_TRACE_RX = 0, CAN_TRACE_TX = 1 };
+
+struct CanTraceRec {
+  uint32_t ts_us;       // micros() at RX / after twai_transmit
+  uint32_t id;          // 29-bit identifier
+  uint8_t  dlc;
+  uint8_t  dir;         // CanTraceDir
+  uint8_t  rsv[2];
+  uint8_t  data[8];
+};
+static_assert(sizeof(CanTraceRec) == 20, "CanTraceRec must stay 20 bytes");
+
+// ---- Producers ----
+bool canTraceOn(CanTraceDir dir);     // /log client with rx/txlogging on, or the recorder running
+void canTraceRecord(CanTraceDir dir, uint32_t tsUs, uint32_t id, const uint8_t* data, uint8_t dlc);
+
+// ---- /log consumer (single task) ----
+bool     canTracePop(CanTraceRec& out);     // oldest first across RX and TX
+size_t   canTraceFormat(const CanTraceRec& r, char* buf, size_t cap);   // "(ts) vcanRx ID#DATA"
+size_t   canTraceFormatAt(const CanTraceRec& r, double ts, char* buf, size_t cap);   // explicit wall time
+void     canTraceClear();
+uint32_t canTraceDrops();
+uint32_t canTraceDepth();
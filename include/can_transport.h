@@ -0,0 +1,63 @@
+#pragma once
+#include <Arduino.h>
+#include "can.h"
+
+// ---- CAN transport: the only layer that talks to a bus ----
+// can.cpp (RX/decode/TX tasks) drives whichever backend is installed with
+// canSetTransport(): the TWAI controller on the board (can_twai.h), an
+// in-process loopback pair (can_loopback.h) or UDP between host processes
+// (can_udp.h). Frames use the same CanFrame record as the RX ring.
+//
+// Threading: wait()/receive() are called by one RX task, send() by one TX
+// task; start()/stop() only while both are parked (see canFilterTick()).
+
+// ---- Events returned by wait() ----
+#define CAN_EV_RX          0x01   // frames ready for receive()
+#define CAN_EV_RX_OVERRUN  0x02   // frames were lost before receive()
+#define CAN_EV_BUS_ERROR   0x04
+#define CAN_EV_ERR_PASSIVE 0x08
+#define CAN_EV_TX_FAILED   0x10
+#define CAN_EV_BUS_OFF     0x20   // call recover()
+#define CAN_EV_RECOVERED   0x40   // call restart()
+#define CAN_EV_ARB_LOST    0x80
+
+// ---- Acceptance filter: id accepted when ((id ^ code) & ~dontCare) == 0 ----
+struct CanFilter {
+  uint32_t code;
+  uint32_t dontCare;
+};
+CanFilter canFilterAll();
+CanFilter canFilterFromIds(const uint32_t* ids, size_t n);   // smallest single filter covering ids
+inline bool canFilterMatch(const CanFilter& f, uint32_t id) {
+  return (((id & 0x1FFFFFFF) ^ f.code) & ~f.dontCare) == 0;
+}
+
+struct CanTransportStatus {
+  uint32_t rxMissed;      // lost in the backend before receive()
+  uint32_t rxOverrun;     // controller / socket overruns
+  uint8_t  state;         // backend specific (TWAI: twai_state_t)
+};
+
+class CanTransport {
+public:
+  virtual ~CanTransport() {}
+  virtual const char* name() const = 0;
+
+  virtual bool start(const CanFilter& filter) = 0;
+  virtual void stop() = 0;
+
+  // Queue one frame; false if it could not be handed over within timeoutMs
+  virtual bool send(const CanFrame& f, uint32_t timeoutMs) = 0;
+  // Block up to timeoutMs for events; 0 on timeout
+  virtual uint32_t wait(uint32_t timeoutMs) = 0;
+  // Next received frame without blocking (ts_us is stamped by the caller)
+  virtual bool receive(CanFrame& f) = 0;
+
+  virtual void recover() {}
+  virtual void restart() {}
+  virtual void status(CanTransportStatus& out) { memset(&out, 0, sizeof(out)); }
+};
+
+// ---- Backend used by canInitDriver(); set once from setup() ----
+void          canSetTransport(CanTransport* t);
+CanTransport* canGetTransport();
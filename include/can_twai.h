@@ -0,0 +1,5 @@
+#pragma once
+#include "can_transport.h"
+
+// ---- ESP32 TWAI controller backend (CAN_TX / CAN_RX pins, 1 Mbit/s) ----
+CanTransport& canTwaiTransport();
@@ -0,0 +1,28 @@
+#pragma once
+#include "can_transport.h"
+
+// ---- Host backend: CAN frames as UDP datagrams between two local processes ----
+// Each side binds its own port and sends to the peer's, e.g. a bridge built
+// for the host on 47001 and a bus simulator on 47002. One 16-byte datagram
+// per frame (id LE, dlc, flags, 2 spare, data[8]); filtering is done here.
+// Linux/macOS only: compiled out of the firmware build.
+class CanUdpTransport : public CanTransport {
+public:
+  CanUdpTransport(uint16_t localPort, uint16_t peerPort) : localPort_(localPort), peerPort_(peerPort) {}
+  ~CanUdpTransport() override { stop(); }
+
+  const char* name() const override { return "udp"; }
+
+  bool     start(const CanFilter& filter) override;
+  void     stop() override;
+  bool     send(const CanFrame& f, uint32_t timeoutMs) override;
+  uint32_t wait(uint32_t timeoutMs) override;
+  bool     receive(CanFrame& f) override;
+  void     status(CanTransportStatus& out) override;
+
+private:
+  uint16_t  localPort_;
+  uint16_t  peerPort_;
+  int       fd_ = -1;
+  CanFilter filter_ = { 0, 0x1FFFFFFF };
+};
@@ -0,0 +1,21 @@
+#pragma once
+#include <Arduino.h>
+#include <stddef.h>
+
+// ---- Table variant: 1 = byte-at-a-time, 4 / 8 = slice-by-N ----
+#ifndef CRC16_SLICE
+#define CRC16_SLICE 4
+#endif
+
+// ---- Streaming CRC16 (EcoFlow framing: reflected poly 0xA001, init 0) ----
+// Start with crc16_init(), fold bytes in with crc16_update() as they arrive.
+inline uint16_t crc16_init() { return 0; }
+uint16_t crc16_update(uint16_t crc, const uint8_t* data, size_t len);
+
+// ---- Same, but folds (data[i] ^ key); CRCs an XOR-encoded payload without materialising it ----
+uint16_t crc16_update_xor(uint16_t crc, const uint8_t* data, size_t len, uint8_t key);
+
+// ---- One-shot helper ----
+inline uint16_t crc16(const uint8_t* data, size_t len) {
+  return crc16_update(crc16_init(), data, len);
+}
@@ -4,6 +4,7 @@
 #include "driver/twai.h"
 #include "config.h"
 #include "bms.h"
+#include "can.h"
 
 // ---- XOR state (set by decoder) ----
 extern uint8_t xor3C;
@@ -57,13 +58,37 @@ void ecoflowSend24(); //
 void ecoflowSendCB2031(); //
 void ecoflowSendCB2033(); //
 
+// ---- Heartbeat reply image / latency (C4 END frame -> first 3C frame at the driver) ----
+#define ECOFLOW_LAT_BUCKETS 8
+extern const uint32_t ecoflowLatEdgesUs[ECOFLOW_LAT_BUCKETS - 1];   // bucket upper bounds
+struct EcoflowLatency {
+  uint32_t hist[ECOFLOW_LAT_BUCKETS];
+  uint32_t count;
+  uint32_t lastUs;
+  uint32_t avgUs;
+  uint32_t maxUs;
+};
+void ecoflowC4LatencyGet(EcoflowLatency& out);
+void ecoflow3CImageTick();              // called from loop(); rebuilds the 3C image on change
+
+// ---- Sequencer step timing (per step / per action: lateness, send duration, frames) ----
+void ecoflowSeqStatsJson(String& out);
+void ecoflowSeqStatsReset();
+
+// ---- TX sequence table (built-in, or /txseq.json on SPIFFS; swapped at a cycle boundary) ----
+bool ecoflowTxSeqLoad();                // (re)load from SPIFFS; false = file invalid, built-in used
+bool ecoflowTxSeqUpload(const char* text, size_t len, String& err);   // validate, save, stage
+void ecoflowTxSeqUseBuiltin();          // delete the file and stage the built-in table
+void ecoflowTxSeqJson(String& out);     // active table + source / pending / last error
+
 // ---- API ----
 void ecoflowMessagesInit();             // xorCounter initialiser
 void canSequencer_onHeartbeatC4();      // called by decoder after heartbeat (type 0xC4)
-void canTxSequencerTick();              // called from loop()
+void ecoflowSequencerStart();           // starts the sequencer task (timer-driven)
+int64_t ecoflowSequencerService();      // one pass: runs due steps, µs to the next (-1 idle)
 
 // ---- Send helpers used by decoder ----
-void sendCANMessage(uint8_t* header, uint8_t* payload, size_t headerSize, size_t payloadSize);
+uint8_t sendCANMessage(uint8_t* header, uint8_t* payload, size_t headerSize, size_t payloadSize);
 
 // ---- Prepare functions used by decoder ----
 void prepareMessage13(uint8_t *message);
@@ -79,8 +104,71 @@ void prepareMessage8C(uint8_t *message);
 void prepareMessage24(uint8_t *message);
 void prepareMessageCB(uint8_t *message);
 
+// ---- 14001 multi-frame RX IDs ----
+#define MSG14001_START_ID   0x10014001UL
+#define MSG14001_MID_ID     0x10114001UL
+#define MSG14001_END_ID     0x10214001UL
+
+// ---- Multi-frame TX IDs ----
+#define MSG3001_FIRST_ID    0x10003001UL
+#define MSG3001_MID_ID      0x10103001UL
+#define MSG3001_END_ID      0x10203001UL
+
+// ---- IDs consumed by processEcoFlowCAN (drives the TWAI acceptance filter) ----
+extern const uint32_t ecoflowRxIds[];
+extern const size_t   ecoflowRxIdCount;
+
+// ---- Decoded 14001 message handed to handlers ----
+struct EcoflowMsg {
+  uint8_t        type;
+  uint8_t        xorKey;
+  uint16_t       trackerBE;
+  uint16_t       crc;
+  uint16_t       len;
+  const uint8_t* data;      // decoded payload; valid only during the call
+};
+typedef void (*EcoflowHandler)(const EcoflowMsg& m);
+
+#ifndef ECOFLOW_MAX_HANDLERS
+#define ECOFLOW_MAX_HANDLERS 16
+#endif
+#define ECOFLOW_ANY_TRACKER (-1)
+
+// ---- Handler registration (call from setup(), before CAN tasks start) ----
+// An exact tracker match wins over ECOFLOW_ANY_TRACKER. Runs on the decode task.
+bool ecoflowOnMessage(uint8_t type, int32_t tracker, EcoflowHandler fn, const char* name);
+void ecoflowHandlersInit();     // registers the built-in reply handlers
+
+// ---- Per-handler stats ----
+struct EcoflowHandlerInfo {
+  const char* name;
+  uint8_t     type;
+  int32_t     tracker;
+  uint32_t    calls;
+  uint32_t    totalUs;
+  uint32_t    maxUs;
+};
+size_t   ecoflowHandlerCount();
+bool     ecoflowHandlerInfo(size_t idx, EcoflowHandlerInfo& out);
+uint32_t ecoflowUnhandledCount();
+
 // ---- EcoFlow CAN Rx Processor ----
-void processEcoFlowCAN(const twai_message_t &rx);
+void processEcoFlowCAN(const twai_message_t &rx, uint32_t rxUs = 0);   // rxUs: micros() at reception
+
+// ---- Multi-frame reassembly deadline (decode task only) ----
+uint32_t ecoflowRxMsUntilDeadline();    // UINT32_MAX when no stream is open
+void     ecoflowRxCheckTimeout();       // evicts a stream past its deadline
+
+// ---- Multi-frame timeout evictions / slot pool ----
+uint32_t ecoflowRxTimeouts();
+uint32_t ecoflowRxEvictLatLastMs();
+uint32_t ecoflowRxEvictLatMaxMs();
+uint8_t  ecoflowRxActiveStreams();
+uint32_t ecoflowRxSlotSteals();
+
+// ---- 14001 RX CRC counters per message type (failed messages are dropped) ----
+uint32_t ecoflowRxCrcOk(uint8_t type);
+uint32_t ecoflowRxCrcFail(uint8_t type);
 
 // ---- Returns EcoFlow PowerStream serial from C4 ----
 const char* getPeerSerial();
@@ -0,0 +1,57 @@
+#pragma once
+#include <Arduino.h>
+#include <string.h>
+
+// ---- Fixed-size log2 histogram for µs timings ----
+// Bucket b holds samples in [2^(b-1), 2^b) µs (bucket 0 = 0 µs); the last
+// bucket is open-ended. Recording is a handful of integer ops, so it can stay
+// on in production. Percentiles are reported as the bucket's upper bound.
+#ifndef LAT_HIST_BUCKETS
+#define LAT_HIST_BUCKETS 20     // up to ~0.5 s resolved
+#endif
+
+struct LatHist {
+  uint32_t bucket[LAT_HIST_BUCKETS];
+  uint32_t count;
+  uint32_t minUs;
+  uint32_t maxUs;
+  uint64_t sumUs;
+
+  void reset() { memset(this, 0, sizeof(*this)); minUs = UINT32_MAX; }
+
+  void record(uint32_t us) {
+    uint8_t b = us ? (uint8_t)(32 - __builtin_clz(us)) : 0;
+    if (b >= LAT_HIST_BUCKETS) b = LAT_HIST_BUCKETS - 1;
+    bucket[b]++;
+    count++;
+    sumUs += us;
+    if (us < minUs) minUs = us;
+    if (us > maxUs) maxUs = us;
+  }
+
+  uint32_t avgUs() const { return count ? (uint32_t)(sumUs / count) : 0; }
+
+  // Upper bound of the bucket holding the p-th percentile (p in 1..100)
+  uint32_t percentileUs(uint8_t p) const {
+    if (!count) return 0;
+    uint32_t want = (uint32_t)(((uint64_t)count * p + 99) / 100);
+    uint32_t seen = 0;
+    for (uint8_t b = 0; b < LAT_HIST_BUCKETS; b++) {
+      seen += bucket[b];
+      if (seen >= want) {
+        uint32_t hi = (b == 0) ? 0 : ((1UL << b) - 1);
+        return (hi > maxUs) ? maxUs : hi;
+      }
+    }
+    return maxUs;
+  }
+
+  // {"n":..,"min":..,"avg":..,"p99":..,"max":..}
+  void appendJson(String& out) const {
+    char buf[96];
+    snprintf(buf, sizeof(buf), "{\"n\":%lu,\"min\":%lu,\"avg\":%lu,\"p99\":%lu,\"max\":%lu}",
+             (unsigned long)count, (unsigned long)(count ? minUs : 0), (unsigned long)avgUs(),
+             (unsigned long)percentileUs(99), (unsigned long)maxUs);
+    out += buf;
+  }
+};
@@ -0,0 +1,102 @@
+#pragma once
+#include <Arduino.h>
+#include <stddef.h>
+
+// ---- Pool size / per-stream capacity (all storage is static, no heap) ----
+#ifndef REASM_SLOTS
+#define REASM_SLOTS 4
+#endif
+#ifndef REASM_MAX_PAYLOAD
+#define REASM_MAX_PAYLOAD 2048
+#endif
+
+#define REASM_HDR_LEN  18
+#define REASM_BUF_CAP  (REASM_HDR_LEN + REASM_MAX_PAYLOAD + 2)
+
+// ---- EcoFlow multi-frame ID layout ----
+// 0x100xxxxx = first, 0x101xxxxx = middle, 0x102xxxxx = last.
+// The family is the ID with the position bits cleared (e.g. 0x10004001).
+#define REASM_POS_MASK   0x00300000UL
+#define REASM_POS_SHIFT  20
+
+inline bool reasmIsMultiFrameId(uint32_t id) {
+  id &= 0x1FFFFFFF;
+  return (id & 0x1FC00000UL) == 0x10000000UL && ((id & REASM_POS_MASK) >> REASM_POS_SHIFT) != 3;
+}
+inline uint32_t reasmFamily(uint32_t id) { return (id & 0x1FFFFFFF) & ~REASM_POS_MASK; }
+
+// ---- A completed message; pointers stay valid until the next feed() ----
+struct ReasmMessage {
+  uint32_t       family;
+  uint8_t        type;        // header[4]
+  uint8_t        xorKey;      // header[6]
+  uint16_t       payloadLen;  // header[2..3], little-endian
+  uint16_t       trackerBE;   // header[16..17]
+  uint16_t       crc;         // trailer, little-endian on the wire
+  uint16_t       crcCalc;     // over header + encoded payload
+  const uint8_t* header;      // REASM_HDR_LEN bytes
+  const uint8_t* payload;     // payloadLen bytes, still XOR-encoded
+};
+
+enum ReasmResult : uint8_t {
+  REASM_NONE = 0,     // frame absorbed (or ignored), nothing finished
+  REASM_COMPLETE,     // out holds a CRC-valid message
+  REASM_CRC_FAIL,     // out holds the message; CRC mismatch, stream dropped
+  REASM_OVERSIZE,     // declared length > REASM_MAX_PAYLOAD, stream dropped
+};
+
+// ---- Multi-stream reassembler for EcoFlow 18-byte-header messages ----
+// Single-threaded: feed(), expire() and msUntilDeadline() must all be
+// called from the same task.
+class Reassembler {
+public:
+  // pinnedFamily: its stream is never stolen to make room for another family
+  Reassembler(uint32_t timeoutMs, uint32_t pinnedFamily = 0)
+    : timeoutMs_(timeoutMs), pinned_(pinnedFamily) { reset(); }
+
+  ReasmResult feed(uint32_t id, const uint8_t* data, uint8_t dlc, uint32_t nowMs, ReasmMessage& out);
+
+  // Drop every stream whose last frame is older than the timeout; returns count
+  uint8_t  expire(uint32_t nowMs);
+  // ms until the earliest open stream expires; UINT32_MAX when none is open
+  uint32_t msUntilDeadline(uint32_t nowMs) const;
+
+  void reset();
+
+  // Stats
+  uint8_t  activeStreams() const;
+  uint32_t timeouts() const        { return timeouts_; }
+  uint32_t evictLatLastMs() const  { return latLast_; }
+  uint32_t evictLatMaxMs() const   { return latMax_; }
+  uint32_t slotSteals() const      { return steals_; }
+  uint32_t orphanFrames() const    { return orphans_; }
+
+private:
+  struct Slot {
+    bool     active;
+    bool     lenKnown;
+    uint32_t family;
+    uint32_t lastMs;
+    size_t   have;
+    size_t   targetTotal;   // 18 + payloadLen + 2 once known
+    uint16_t payloadLen;
+    uint16_t crcState;      // running CRC, stops short of the trailer
+    size_t   crcCovered;
+    uint8_t  buf[REASM_BUF_CAP];
+  };
+
+  Slot* find(uint32_t family);
+  Slot* claim(uint32_t family, uint32_t nowMs);
+  void  clear(Slot& s);
+  ReasmResult append(Slot& s, const uint8_t* data, uint8_t dlc, uint32_t nowMs);
+  ReasmResult finish(Slot& s, ReasmMessage& out);
+
+  Slot     slots_[REASM_SLOTS];
+  uint32_t timeoutMs_;
+  uint32_t pinned_;
+  uint32_t timeouts_ = 0;
+  uint32_t latLast_  = 0;
+  uint32_t latMax_   = 0;
+  uint32_t steals_   = 0;
+  uint32_t orphans_  = 0;
+};
@@ -0,0 +1,61 @@
+#pragma once
+#include <Arduino.h>
+#include <atomic>
+#include <string.h>
+
+// ---- Lock-free single-producer / single-consumer ring with drop-oldest ----
+// One task calls push(), one other task calls pop(). When full, push()
+// evicts the oldest record instead of failing; the consumer notices the
+// eviction through the CAS on tail and simply retries. T must be trivially
+// copyable. N must be a power of two.
+template <typename T, uint32_t N>
+class SpscRing {
+  static_assert((N & (N - 1)) == 0, "SpscRing size must be a power of two");
+
+public:
+  // Producer side. Returns false if the oldest record had to be dropped.
+  bool push(const T& item) {
+    bool dropped = false;
+    uint32_t h = head_.load(std::memory_order_relaxed);
+    uint32_t t = tail_.load(std::memory_order_acquire);
+    while (h - t >= N) {
+      // Full: evict oldest. Fails only if the consumer just popped it.
+      if (tail_.compare_exchange_weak(t, t + 1, std::memory_order_acq_rel)) {
+        dropped = true;
+        drops_.fetch_add(1, std::memory_order_relaxed);
+        break;
+      }
+    }
+    memcpy(&buf_[h & (N - 1)], &item, sizeof(T));
+    head_.store(h + 1, std::memory_order_release);
+
+    uint32_t used = h + 1 - tail_.load(std::memory_order_relaxed);
+    if (used > hiwat_.load(std::memory_order_relaxed)) hiwat_.store(used, std::memory_order_relaxed);
+    return !dropped;
+  }
+
+  // Consumer side. Returns false when empty.
+  bool pop(T& out) {
+    uint32_t t = tail_.load(std::memory_order_acquire);
+    for (;;) {
+      if (t == head_.load(std::memory_order_acquire)) return false;
+      memcpy(&out, &buf_[t & (N - 1)], sizeof(T));
+      // If the producer evicted slot t while we copied, the CAS fails and t reloads
+      if (tail_.compare_exchange_weak(t, t + 1, std::memory_order_acq_rel)) return true;
+    }
+  }
+
+  uint32_t size() const {
+    return head_.load(std::memory_order_acquire) - tail_.load(std::memory_order_acquire);
+  }
+  uint32_t capacity() const { return N; }
+  uint32_t drops() const    { return drops_.load(std::memory_order_relaxed); }
+  uint32_t highWater() const { return hiwat_.load(std::memory_order_relaxed); }
+
+private:
+  T buf_[N];
+  std::atomic<uint32_t> head_{0};
+  std::atomic<uint32_t> tail_{0};
+  std::atomic<uint32_t> drops_{0};
+  std::atomic<uint32_t> hiwat_{0};
+};
@@ -0,0 +1,34 @@
+#pragma once
+#include <Arduino.h>
+
+// ---- Data-driven TX sequence: SPIFFS file -> validated in-RAM step table ----
+// File format (JSON array, one object per step, "en" optional / default true):
+//   [{"act":"70","gap_ms":25},{"act":"0B_04","gap_ms":1,"en":false},...]
+// Action names are the sequencer's compiled-in actions (see kActionNames).
+#ifndef TXSEQ_MAX_STEPS
+#define TXSEQ_MAX_STEPS 48
+#endif
+#define TXSEQ_PATH          "/txseq.json"
+#define TXSEQ_MAX_FILE      4096
+#define TXSEQ_MAX_GAP_MS    10000
+#define TXSEQ_MIN_CYCLE_MS  50      // a whole cycle must not be shorter than this
+
+struct TxSeqStep {
+  uint8_t  act;       // index into the caller's action-name table
+  uint8_t  enabled;   // 0: step keeps its slot/gap but sends nothing
+  uint16_t gap_ms;    // delay to the next step
+};
+
+// Returns the step count, or 0 with err set (out may then be partly written)
+uint8_t txSeqParse(const char* text, size_t len,
+                   const char* const* actNames, uint8_t actCount,
+                   TxSeqStep* out, uint8_t maxSteps, String& err);
+
+// Same format as the parser accepts
+void txSeqToJson(const TxSeqStep* steps, uint8_t n, const char* const* actNames, String& out);
+
+// SPIFFS helpers. Load returns 0 with err set (err empty = file absent).
+uint8_t txSeqLoadFile(const char* const* actNames, uint8_t actCount,
+                      TxSeqStep* out, uint8_t maxSteps, String& err);
+bool    txSeqSaveFile(const char* text, size_t len);
+bool    txSeqRemoveFile();
@@ -14,6 +14,11 @@ void setupServerRoutes(AsyncWebServer &server);
 // Call from loop() (replaces the old inline flush/ping/BMS push block)
 void webTick();
 
-// Logging APIs used by CAN/EcoFlow modules
-void streamCanLog(const char* message);
+// Logging API used by CAN/EcoFlow modules (CAN frames go through can_trace.h)
 void streamDebug(const char* message);
+
+// True while a /log WebSocket client is attached
+bool webCanLogActive();
+
+// True while a /debug WebSocket client is attached (gate debug formatting on this)
+bool webDebugActive();
@@ -67,6 +67,21 @@ OverkillSolarBms2::OverkillSolarBms2() {
 
     m_param_success = true;
     m_param_timeout = false;
+
+    m_async_head = 0;
+    m_async_count = 0;
+    m_async_state = BMS_ASYNC_IDLE;
+    m_async_attempts = 0;
+    m_async_t0 = 0;
+    m_async_drain_ms = 0;
+    m_async_rx_done = false;
+    m_async_rx_ok = false;
+    m_async_sync_drain = false;
+    m_async_tx_us = 0;
+    m_async_rtt_us = 0;
+
+    _preTransmission = NULL;
+    _postTransmission = NULL;
 }
 
 // ###########################################################################
@@ -145,6 +160,131 @@ void OverkillSolarBms2::set_query_rate(uint16_t rate) {
 }
 
 
+// ###########################################################################
+// Non-blocking request/response engine
+// ###########################################################################
+
+bool OverkillSolarBms2::queue_read(uint8_t cmd_code, bms_request_cb_t cb) {
+    return queue_write(cmd_code, NULL, 0, cb);
+}
+
+// length == 0 sends a read (0xA5); otherwise a write (0x5A) of up to 2 data bytes
+bool OverkillSolarBms2::queue_write(uint8_t cmd_code, uint8_t* data, uint8_t length, bms_request_cb_t cb) {
+    if (m_async_count >= BMS_ASYNC_QUEUE_LEN || length > 2) {
+        return false;
+    }
+    BmsAsyncRequest &req = m_async_queue[(m_async_head + m_async_count) % BMS_ASYNC_QUEUE_LEN];
+    req.rw = (length == 0) ? BMS_READ : BMS_WRITE;
+    req.cmd_code = cmd_code;
+    req.length = length;
+    for (uint8_t i=0; i<length; i++) {
+        req.data[i] = data[i];
+    }
+    req.cb = cb;
+    m_async_count += 1;
+    return true;
+}
+
+bool OverkillSolarBms2::async_busy() {
+    return m_async_count > 0;
+}
+
+uint8_t OverkillSolarBms2::async_pending() {
+    return m_async_count;
+}
+
+// Lets a caller sleep on something else (e.g. UART events) between calls.
+// While waiting for a reply, the reply itself is also a reason to call.
+uint32_t OverkillSolarBms2::async_next_ms() {
+    if (m_async_state == BMS_ASYNC_IDLE) {
+        return (m_async_count > 0) ? 0 : UINT32_MAX;
+    }
+    uint32_t elapsed = millis() - m_async_t0;
+    uint32_t due = (m_async_state == BMS_ASYNC_TX_DRAIN) ? m_async_drain_ms : BMS_TIMEOUT;
+    return (elapsed >= due) ? 0 : due - elapsed;
+}
+
+void OverkillSolarBms2::async_set_sync_drain(bool on) {
+    m_async_sync_drain = on;
+}
+
+uint32_t OverkillSolarBms2::async_rtt_us() {
+    return m_async_rtt_us;
+}
+
+void OverkillSolarBms2::async_finish(bool success) {
+    BmsAsyncRequest req = m_async_queue[m_async_head];
+    m_async_rtt_us = success ? micros() - m_async_tx_us : 0;
+    m_async_head = (m_async_head + 1) % BMS_ASYNC_QUEUE_LEN;
+    m_async_count -= 1;
+    m_async_state = BMS_ASYNC_IDLE;
+    m_async_attempts = 0;
+    // Pop before the callback so it can queue follow-up requests
+    if (req.cb) {
+        req.cb(req.cmd_code, success);
+    }
+}
+
+void OverkillSolarBms2::async_task() {
+    if (!m_is_initialized) {
+        return;
+    }
+    uint32_t now = millis();
+
+    if (m_async_state == BMS_ASYNC_IDLE) {
+        if (m_async_count == 0) {
+            return;
+        }
+        BmsAsyncRequest &req = m_async_queue[m_async_head];
+        m_async_tx_us = micros();
+        write(req.rw, req.cmd_code, req.data, req.length);
+        m_async_attempts += 1;
+        m_async_t0 = now;
+        // start + status + cmd + len + data + 2x checksum + stop
+        m_async_drain_ms = ((7 + req.length) * BMS_ASYNC_TX_BYTE_US) / 1000 + 1;
+        m_async_rx_done = false;
+        m_async_rx_ok = false;
+        if (m_async_sync_drain) {
+            // serial_rx_task() blocks until the stop byte has left and
+            // releases the bus, so the reply can start right after it
+            m_async_state = BMS_ASYNC_WAIT_REPLY;
+            serial_rx_task();
+            return;
+        }
+        m_async_state = BMS_ASYNC_TX_DRAIN;
+        return;
+    }
+
+    if (m_async_state == BMS_ASYNC_TX_DRAIN) {
+        // serial_rx_task() flushes the TX buffer, so hold off until the
+        // request is already on the wire and the flush returns immediately.
+        if (now - m_async_t0 < m_async_drain_ms) {
+            return;
+        }
+        m_async_state = BMS_ASYNC_WAIT_REPLY;
+    }
+
+    serial_rx_task();
+
+    if (m_async_rx_done) {
+        if (m_async_rx_ok || m_async_attempts >= BMS_ASYNC_ATTEMPTS) {
+            async_finish(m_async_rx_ok);
+        }
+        else {
+            m_async_state = BMS_ASYNC_IDLE;  // NAK or bad checksum: resend
+        }
+    }
+    else if (now - m_async_t0 >= BMS_TIMEOUT) {
+        if (m_async_attempts >= BMS_ASYNC_ATTEMPTS) {
+            async_finish(false);
+        }
+        else {
+            m_async_state = BMS_ASYNC_IDLE;  // resend
+        }
+    }
+}
+
+
 // ###########################################################################
 // 0x03 Basic Info & Status
 // ###########################################################################
@@ -413,6 +553,26 @@ void OverkillSolarBms2::set_0xE1_mosfet_control_discharge(bool discharge) {
     write(BMS_WRITE, BMS_REG_CTL_MOSFET, m_0xE1_mosfet_control, 2);
 }
 
+bool OverkillSolarBms2::queue_0xE1_mosfet_control_charge(bool charge) {
+    if (charge) {
+        m_0xE1_mosfet_control[1] &= 0b10;  // Disable bit zero
+    }
+    else {
+        m_0xE1_mosfet_control[1] |= 0b01;  // Enable bit zero
+    }
+    return queue_write(BMS_REG_CTL_MOSFET, m_0xE1_mosfet_control, 2);
+}
+
+bool OverkillSolarBms2::queue_0xE1_mosfet_control_discharge(bool discharge) {
+    if (discharge) {
+        m_0xE1_mosfet_control[1] &= 0b01;  // Disable bit 1
+    }
+    else {
+        m_0xE1_mosfet_control[1] |= 0b10;  // Enable bit 1
+    }
+    return queue_write(BMS_REG_CTL_MOSFET, m_0xE1_mosfet_control, 2);
+}
+
 
 #ifdef BMS_OPTION_DEBUG
 void OverkillSolarBms2::debug() {
@@ -2017,6 +2177,13 @@ void OverkillSolarBms2::serial_rx_task() {
                     m_num_rx_errors += 1;
                 }
 
+                // Complete the in-flight async request, if this frame answers it
+                if (m_async_state == BMS_ASYNC_WAIT_REPLY &&
+                    m_rx_cmd_code == m_async_queue[m_async_head].cmd_code) {
+                    m_async_rx_done = true;
+                    m_async_rx_ok = (m_rx_checksum == calc_checksum && m_rx_status == 0x00 && c == BMS_STOPBYTE);
+                }
+
                 m_rx_state = BMS_STATE_WAIT_FOR_START_BYTE;
             }
             // #ifdef BMS_OPTION_DEBUG
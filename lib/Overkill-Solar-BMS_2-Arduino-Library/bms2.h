@@ -59,6 +59,11 @@ POSSIBILITY OF SUCH DAMAGE.
 #define BMS_STATE_WAIT_FOR_STOP_BYTE    0x07
 #define BMS_STATE_ERROR                 0xFF
 
+// Async request engine states
+#define BMS_ASYNC_IDLE        0x00
+#define BMS_ASYNC_TX_DRAIN    0x01
+#define BMS_ASYNC_WAIT_REPLY  0x02
+
 // replace min() because it doesnt work on the esp32 when the arguments have different data types
 #define __min(a,b) ((a)<(b)?(a):(b))
 
@@ -113,6 +118,19 @@ typedef struct DelayParamTuple {
 } DelayParamTuple;
 
 
+// Completion callback for queued requests: called once per request with the
+// command code and whether a valid reply was received.
+typedef void (*bms_request_cb_t)(uint8_t cmd_code, bool success);
+
+typedef struct BmsAsyncRequest {
+    uint8_t rw;         // BMS_READ or BMS_WRITE
+    uint8_t cmd_code;
+    uint8_t length;
+    uint8_t data[2];
+    bms_request_cb_t cb;
+} BmsAsyncRequest;
+
+
 // 0x03 Basic Info
 typedef struct BasicInfo {
     uint16_t voltage;  // The total voltage, stored as units of 10 mV
@@ -299,6 +317,20 @@ public:
     void set_query_rate(uint16_t rate);  // Set the
 
     bool get_comm_error_state();  // Returns true if the BMS is not responding
+
+    // #######################################################################
+    // Non-blocking request/response engine.
+    // Requests are queued and sent one at a time; async_task() advances the
+    // engine without ever waiting and fires the callback on reply or timeout.
+    bool    queue_read(uint8_t cmd_code, bms_request_cb_t cb = NULL);
+    bool    queue_write(uint8_t cmd_code, uint8_t* data, uint8_t length, bms_request_cb_t cb = NULL);
+    void    async_task();     // Call every loop(); never blocks
+    bool    async_busy();     // True while a request is queued or in flight
+    uint8_t async_pending();  // # of queued requests, including the one in flight
+    uint32_t async_next_ms(); // ms until async_task() has work to do (0 = now, UINT32_MAX = idle)
+    uint32_t async_rtt_us();  // request written -> reply parsed, for the callback running now (0 = failed)
+    void    async_set_sync_drain(bool on);  // block in async_task() while the request drains
+                                            // (dedicated task only) instead of timing it
    
    
     // #######################################################################
@@ -351,6 +383,8 @@ public:
     void set_0xE1_mosfet_control(bool charge, bool discharge);  // Controls the charge and discharge MOSFETs
     void set_0xE1_mosfet_control_charge(bool charge);
     void set_0xE1_mosfet_control_discharge(bool discharge);
+    bool queue_0xE1_mosfet_control_charge(bool charge);        // Non-blocking variants
+    bool queue_0xE1_mosfet_control_discharge(bool discharge);
 
     // #######################################################################
     // Config Parameters
@@ -643,6 +677,21 @@ private:
     bool     m_in_factory_mode;
 
 
+    // Async request engine state
+    BmsAsyncRequest m_async_queue[BMS_ASYNC_QUEUE_LEN];
+    uint8_t  m_async_head;
+    uint8_t  m_async_count;
+    uint8_t  m_async_state;
+    uint8_t  m_async_attempts;
+    uint32_t m_async_t0;
+    uint32_t m_async_drain_ms;
+    bool     m_async_rx_done;
+    bool     m_async_rx_ok;
+    bool     m_async_sync_drain;
+    uint32_t m_async_tx_us;
+    uint32_t m_async_rtt_us;
+    void     async_finish(bool success);
+
     uint16_t atomic_param_read(uint8_t cmd_code);
     uint16_t atomic_param_read(uint8_t cmd_code, uint32_t timeout);
 
@@ -15,6 +15,10 @@
 
 #define BMS_TIMEOUT         500  // The longest time to wait, in milliseconds for a response
 
+#define BMS_ASYNC_QUEUE_LEN  8     // Max # of queued non-blocking requests
+#define BMS_ASYNC_ATTEMPTS   3     // Attempts per queued request before reporting failure
+#define BMS_ASYNC_TX_BYTE_US 1042  // Time on the wire per byte (9600 8N1); RX is not polled before TX drains
+
 #define BMS_MAX_CELLS       16  // Preallocates this number of cells voltages in the array
 #define BMS_MAX_NTCs        4   // Preallocates this number of temperatures in the array
 #define BMS_MAX_RX_DATA_LEN 64  // Preallocates this number of bytes to store RX data field
@@ -1,12 +1,57 @@
 #include "bms.h"
+#include "bms_params.h"
+#include "bms_snapshot.h"
 #include "config.h"
 
 #include <math.h>
 
-// Internal 3s timer
-static unsigned long bmsTimer = 0;
 #define RS485_BAUD 9600
 
+// ---- Adaptive poll schedule (BMS task) ----
+// 0x03 (current, pack voltage, SOC, MOSFETs) and 0x04 (cells) run on their
+// own intervals. A register drops to its fast interval when its data moves
+// or a cell nears a protection trigger, then doubles back towards its slow
+// interval on every stable reply.
+#define BMS_POLL_03_FAST_MS   250
+#define BMS_POLL_03_SLOW_MS   4000
+#define BMS_POLL_04_FAST_MS   500
+#define BMS_POLL_04_SLOW_MS   8000
+#define BMS_ADAPT_CURRENT_MA  300     // current change between 0x03 replies
+#define BMS_ADAPT_SPREAD_MV   5       // cell spread (max - min) change between 0x04 replies
+#define BMS_ADAPT_NEAR_MV     50      // any cell this close to cellOvTrigMv / cellUvTrigMv
+
+struct BmsPollReg {
+  uint8_t  cmd;
+  uint32_t fastMs;
+  uint32_t slowMs;
+  uint32_t intervalMs;      // current interval, fastMs..slowMs
+  uint32_t queuedMs;        // millis() the last read was queued
+  uint32_t okMs;            // millis() of the last good reply (0 = none)
+  uint32_t polls;
+  uint32_t fails;
+  uint32_t rttLastUs;       // request written -> reply parsed
+  uint32_t rttMaxUs;
+  uint64_t rttSumUs;
+  uint32_t rttCount;
+};
+static BmsPollReg pollBasic = { BMS_REG_BASIC_SYSTEM_INFO, BMS_POLL_03_FAST_MS, BMS_POLL_03_SLOW_MS, BMS_POLL_03_FAST_MS };
+static BmsPollReg pollCells = { BMS_REG_CELL_VOLTAGES,     BMS_POLL_04_FAST_MS, BMS_POLL_04_SLOW_MS, BMS_POLL_04_FAST_MS };
+static uint8_t  pollOutstanding = 0;    // reads of the current round not yet completed
+static uint32_t roundT0Us       = 0;    // round queued -> last reply parsed
+static uint32_t roundLastUs     = 0;
+static uint32_t roundMaxUs      = 0;
+static bool     pollNearLimit   = false;
+static bool     havePrevMa      = false;
+static int32_t  prevPackMa      = 0;
+static int32_t  prevSpreadMv    = -1;
+
+// ---- BMS task ----
+#define BMS_TASK_CORE      1
+#define BMS_TASK_PRIO      2      // above loop(), below the CAN sequencer
+#define BMS_TASK_STACK     6144
+#define BMS_TASK_MAX_WAIT  100    // upper bound between ticks (rebuilds, param refresh)
+static TaskHandle_t bmsTaskHandle = nullptr;
+
 // These live in main.cpp (UI + pending MOS changes)
 extern bool lastWebMoschg;
 extern bool lastWebMosdis;
@@ -40,7 +85,9 @@ static void setRS485Transmit(bool enable) {
   digitalWrite(RS485_CALLBACK, enable ? LOW : HIGH); // LOW=Transmit, HIGH=Receive
 }
 
-HardwareSerial& bmsSerial = Serial1;
+static void bmsPublishSnapshot();
+
+BmsUart bmsSerial;
 OverkillSolarBms2 bms = OverkillSolarBms2();
 
 static void preTransmission() {
@@ -57,18 +104,23 @@ void bmsInit() {
   digitalWrite(RS485_EN, HIGH);
   setRS485Transmit(false);
   
-  bmsSerial.begin(RS485_BAUD, SERIAL_8N1, RS485_RX, RS485_TX);
+  if (!bmsSerial.begin(UART_NUM_1, RS485_BAUD, RS485_RX, RS485_TX)) {
+    Serial.println("[BMS] RS485 UART not available; BMS polls will time out");
+  }
 
   // Same library wiring
   bms.begin(&bmsSerial);
   bms.preTransmission(preTransmission);
   bms.postTransmission(postTransmission);
 
-  // First poll exactly as before
-  bms.main_task(true);
+  // Manual / config values until the first poll completes
+  bmsPublishSnapshot();
+
+  // EEPROM params: NVS cache, or one factory-mode read before CAN starts
+  bmsParamsInit();
 
   batteryMasterInit();
-  bmsLoopInit();
+  bmsTaskStart();
 }
 
 void batteryMasterInit() {
@@ -130,16 +182,49 @@ void applyBatteryMasterIfChanged() {
   batteryMasterLast = config.batteryMaster;
 }
 
-void bmsLoopInit() {
-  bmsTimer = millis();
-}
-
-void bmsLoopTick() {
-  if (millis() - bmsTimer <= 3000) return;
-  bmsTimer = millis();
+// Pack the library state + effective config values into the shared snapshot.
+// BMS context only: the bms.get_*() accessors read buffers the poll rewrites.
+static void bmsPublishSnapshot() {
+  BmsSnapshot s = {};
+
+  s.numCells = bms.get_num_cells();
+  if (s.numCells > BMS_SNAP_CELLS) s.numCells = BMS_SNAP_CELLS;
+  for (uint8_t i = 0; i < s.numCells; i++) {
+    uint16_t mv = (uint16_t)lroundf(bms.get_cell_voltage(i) * 1000.0f);
+    s.cellMv[i] = mv;
+    if (i == 0 || mv < s.minCellMv) s.minCellMv = mv;
+    if (mv > s.maxCellMv) s.maxCellMv = mv;
+  }
 
-  bms.main_task(true);
+  s.numNtcs = bms.get_num_ntcs();
+  if (s.numNtcs > BMS_SNAP_NTCS) s.numNtcs = BMS_SNAP_NTCS;
+  for (uint8_t i = 0; i < s.numNtcs; i++)
+    s.ntcDeciC[i] = (int16_t)lroundf(bms.get_ntc_temperature(i) * 10.0f);
+
+  s.bmsPackMv  = (uint16_t)lroundf(bms.get_voltage() * 1000.0f);
+  s.packMa     = (int32_t)lroundf(bms.get_current() * 1000.0f);
+  s.bmsSoc     = bms.get_state_of_charge();
+  s.balanceMah = (uint32_t)lroundf(bms.get_balance_capacity() * 1000.0f);
+  s.rateMah    = (uint32_t)lroundf(bms.get_rate_capacity() * 1000.0f);
+  s.inputW     = (int32_t)inputWatt;
+  s.outputW    = (int32_t)outputWatt;
+  s.moschg     = config.moschg;
+  s.mosdis     = config.mosdis;
+
+  s.soc           = config.soc;
+  s.packMv        = config.volt;
+  s.temp          = config.temp;
+  s.chgRuntimeMin = config.chgruntime;
+  s.disRuntimeMin = config.disruntime;
+
+  s.basicMs = pollBasic.okMs;
+  s.cellsMs = pollCells.okMs;
+
+  bmsSnapshotPublish(s);
+}
 
+// Runs once per completed poll round (0x03, 0x04 or both; from the completion callback)
+static void bmsApplyPoll() {
   // --- Charging runtime estimation ---
   float soc = bms.get_state_of_charge();
   float balance_capacity = bms.get_balance_capacity(); // Ah
@@ -179,8 +264,9 @@ void bmsLoopTick() {
   int hours = int(runtime_hours);
   int minutes = int((runtime_hours - hours) * 60);
 
-  if (bms.get_bms_name() != NULL) {
 #if VERBOSE_BMS_PRINTS
+  // get_bms_name() is a blocking round trip; only pay for it when printing
+  if (bms.get_bms_name() != NULL) {
     Serial.println("***********************************************");
     Serial.print("State of charge:\t"); Serial.print(bms.get_state_of_charge()); Serial.println("\t% ");
     Serial.print("Current:\t\t"); Serial.print(bms.get_current()); Serial.println("\tA  ");
@@ -220,18 +306,18 @@ void bmsLoopTick() {
     );
 
     Serial.printf("Estimated charging time: %d min\n", charge_runtime_minutes);
-#endif
   }
+#endif
 
   // Apply pending MOSFET changes requested from UI
   if (pendingMoschgChange && bms.get_charge_mosfet_status() != lastWebMoschg) {
-    bms.set_0xE1_mosfet_control_charge(lastWebMoschg);
+    bms.queue_0xE1_mosfet_control_charge(lastWebMoschg);
     Serial.print("Charge MOSFET set to: "); Serial.println(lastWebMoschg);
     pendingMoschgChange = false;
   }
 
   if (pendingMosdisChange && bms.get_discharge_mosfet_status() != lastWebMosdis) {
-    bms.set_0xE1_mosfet_control_discharge(lastWebMosdis);
+    bms.queue_0xE1_mosfet_control_discharge(lastWebMosdis);
     Serial.print("Discharge MOSFET set to: "); Serial.println(lastWebMosdis);
     pendingMosdisChange = false;
   }
@@ -247,5 +333,169 @@ void bmsLoopTick() {
     config.chgruntime = charge_runtime_minutes;
     config.disruntime = runtime_minutes;
   }
+
+  bmsPublishSnapshot();
+}
+
+static void bmsAdaptInterval(BmsPollReg& r, bool active) {
+  if (active) r.intervalMs = r.fastMs;
+  else        r.intervalMs = (r.intervalMs * 2 < r.slowMs) ? r.intervalMs * 2 : r.slowMs;
+}
+
+// Pick the next interval of the register that just replied from how its data moved
+static void bmsAdapt(uint8_t cmd) {
+  if (cmd == BMS_REG_BASIC_SYSTEM_INFO) {
+    const int32_t ma = (int32_t)lroundf(bms.get_current() * 1000.0f);
+    const bool moved = havePrevMa && abs(ma - prevPackMa) >= BMS_ADAPT_CURRENT_MA;
+    prevPackMa = ma;
+    havePrevMa = true;
+    bmsAdaptInterval(pollBasic, moved || pollNearLimit);
+    return;
+  }
+
+  uint16_t minMv = 0, maxMv = 0;
+  const uint8_t n = bms.get_num_cells();
+  for (uint8_t i = 0; i < n; i++) {
+    uint16_t mv = (uint16_t)lroundf(bms.get_cell_voltage(i) * 1000.0f);
+    if (i == 0 || mv < minMv) minMv = mv;
+    if (mv > maxMv) maxMv = mv;
+  }
+  const int32_t spread = n ? (int32_t)(maxMv - minMv) : -1;
+  const bool moved = prevSpreadMv >= 0 && spread >= 0 && abs(spread - prevSpreadMv) >= BMS_ADAPT_SPREAD_MV;
+  prevSpreadMv = spread;
+
+  pollNearLimit = false;
+  if (n && bmsParamsValid) {
+    if (bmsParams.cellOvTrigMv && maxMv + BMS_ADAPT_NEAR_MV >= bmsParams.cellOvTrigMv) pollNearLimit = true;
+    if (bmsParams.cellUvTrigMv && minMv <= bmsParams.cellUvTrigMv + BMS_ADAPT_NEAR_MV) pollNearLimit = true;
+  }
+  bmsAdaptInterval(pollCells, moved || pollNearLimit);
+  // Near a trigger the current matters as much as the cells
+  if (pollNearLimit) bmsAdaptInterval(pollBasic, true);
+}
+
+static void onBmsReply(uint8_t cmd, bool ok) {
+  BmsPollReg& r = (cmd == BMS_REG_BASIC_SYSTEM_INFO) ? pollBasic : pollCells;
+  r.polls++;
+  if (ok) {
+    r.okMs = millis();
+    const uint32_t rtt = bms.async_rtt_us();
+    r.rttLastUs = rtt;
+    if (rtt > r.rttMaxUs) r.rttMaxUs = rtt;
+    r.rttSumUs += rtt;
+    r.rttCount++;
+    bmsAdapt(cmd);
+  } else {
+    r.fails++;
+  }
+  // The last read of the round closes it (kept values on failure)
+  if (pollOutstanding && --pollOutstanding == 0) {
+    roundLastUs = micros() - roundT0Us;
+    if (roundLastUs > roundMaxUs) roundMaxUs = roundLastUs;
+    bmsApplyPoll();
+  }
+}
+
+static uint32_t bmsPollDueInMs(const BmsPollReg& r, uint32_t now) {
+  const uint32_t since = now - r.queuedMs;
+  return since >= r.intervalMs ? 0 : r.intervalMs - since;
+}
+
+// Queue every register that is due as one round; false when nothing is
+static bool bmsPollQueueDue() {
+  const uint32_t now = millis();
+  // A MOSFET change from the UI is applied after the next 0x03, so fetch it now
+  const bool basicDue = bmsPollDueInMs(pollBasic, now) == 0 || pendingMoschgChange || pendingMosdisChange;
+  const bool cellsDue = bmsPollDueInMs(pollCells, now) == 0;
+  if (!basicDue && !cellsDue) return false;
+
+  pollOutstanding = 0;
+  roundT0Us = micros();
+  if (basicDue && bms.queue_read(pollBasic.cmd, onBmsReply)) {
+    pollBasic.queuedMs = now;
+    pollOutstanding++;
+  }
+  if (cellsDue && bms.queue_read(pollCells.cmd, onBmsReply)) {
+    pollCells.queuedMs = now;
+    pollOutstanding++;
+  }
+  return pollOutstanding > 0;
 }
 
+void bmsPollInfoGet(BmsPollInfo& out) {
+  out.basicIntervalMs = pollBasic.intervalMs;
+  out.cellsIntervalMs = pollCells.intervalMs;
+  out.basicPolls      = pollBasic.polls;
+  out.cellsPolls      = pollCells.polls;
+  out.basicFails      = pollBasic.fails;
+  out.cellsFails      = pollCells.fails;
+  out.nearLimit       = pollNearLimit;
+  out.basicRttLastUs  = pollBasic.rttLastUs;
+  out.basicRttMaxUs   = pollBasic.rttMaxUs;
+  out.basicRttAvgUs   = pollBasic.rttCount ? (uint32_t)(pollBasic.rttSumUs / pollBasic.rttCount) : 0;
+  out.cellsRttLastUs  = pollCells.rttLastUs;
+  out.cellsRttMaxUs   = pollCells.rttMaxUs;
+  out.cellsRttAvgUs   = pollCells.rttCount ? (uint32_t)(pollCells.rttSumUs / pollCells.rttCount) : 0;
+  out.roundLastUs     = roundLastUs;
+  out.roundMaxUs      = roundMaxUs;
+}
+
+// ================= BMS task =================
+// Owns bms.* after setup(): the request engine, the poll schedule, EEPROM
+// parameter refreshes and snapshot publishing. It sleeps on the UART event
+// queue, so a reply is one wake-up when its stop byte (or the line idle)
+// arrives; the engine's own deadlines (TX drain, reply timeout) bound the
+// wait, so loop(), the web server and CAN TX never wait on RS485.
+
+// Advance the engine until it has to wait for the wire. The reads of a round
+// are queued together and a completed reply puts the next request out in the
+// same pass, so a round is back-to-back on the bus: request, reply, request,
+// reply, with only the BMS's own turnaround in between.
+static void bmsAsyncRun() {
+  do {
+    bms.async_task();
+  } while (bms.async_next_ms() == 0);
+}
+
+static void bmsTaskTick() {
+  bmsAsyncRun();
+
+  // Manual values edited in the web UI
+  if (bmsSnapshotTakeRebuild()) bmsPublishSnapshot();
+
+  // Factory-mode reads block this task only; they skip while a poll is out
+  bmsParamsTick();
+
+  if (bms.async_busy()) return;   // previous round still in flight
+  if (bmsPollQueueDue()) bmsAsyncRun();
+}
+
+static void bmsTask(void*) {
+  for (;;) {
+    bmsTaskTick();
+
+    uint32_t waitMs = BMS_TASK_MAX_WAIT;
+    const uint32_t engineMs = bms.async_next_ms();
+    if (engineMs < waitMs) waitMs = engineMs;
+    if (!bms.async_busy()) {
+      const uint32_t now = millis();
+      const uint32_t basicMs = bmsPollDueInMs(pollBasic, now);
+      const uint32_t cellsMs = bmsPollDueInMs(pollCells, now);
+      if (basicMs < waitMs) waitMs = basicMs;
+      if (cellsMs < waitMs) waitMs = cellsMs;
+    }
+    if (waitMs) bmsSerial.waitFrame(waitMs);
+  }
+}
+
+void bmsTaskStart() {
+  if (bmsTaskHandle) return;
+  // This task may block for a request's ~7 ms on the wire; the bus is
+  // released the moment the stop byte leaves instead of on a ms timer
+  bms.async_set_sync_drain(true);
+  // First round right away
+  const uint32_t now = millis();
+  pollBasic.queuedMs = now - pollBasic.intervalMs;
+  pollCells.queuedMs = now - pollCells.intervalMs;
+  xTaskCreatePinnedToCore(bmsTask, "bms", BMS_TASK_STACK, nullptr, BMS_TASK_PRIO, &bmsTaskHandle, BMS_TASK_CORE);
+}
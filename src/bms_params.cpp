@@ -0,0 +1,122 @@
+#include "bms_params.h"
+#include "bms.h"
+#include "config.h"
+
+#include <Preferences.h>
+
+// --- Definitions for externs ---
+BmsParams bmsParams;
+bool      bmsParamsValid    = false;
+uint32_t  bmsParamsLoadedMs = 0;
+
+// Refresh scheduling
+static bool     refreshRequested = false;
+static uint32_t lastRefreshMs    = 0;
+
+// ---------- NVS ----------
+// Local Preferences handles: these run on the BMS task while web/MQTT
+// handlers use the global prefs from other tasks.
+static bool loadFromNvs() {
+  Preferences nvs;
+  nvs.begin("bmsparam", true);
+  uint8_t ver = nvs.getUChar("ver", 0);
+  BmsParams p;
+  size_t n = 0;
+  if (ver == BMS_PARAMS_NVS_VERSION && nvs.getBytesLength("blob") == sizeof(p)) {
+    n = nvs.getBytes("blob", &p, sizeof(p));
+  }
+  nvs.end();
+
+  if (n != sizeof(p) || p.fullChargeMv == 0) return false;
+  bmsParams = p;
+  return true;
+}
+
+static void saveToNvs() {
+  Preferences nvs;
+  nvs.begin("bmsparam", false);
+  nvs.putUChar("ver", BMS_PARAMS_NVS_VERSION);
+  nvs.putBytes("blob", &bmsParams, sizeof(bmsParams));
+  nvs.end();
+}
+
+// ---------- BMS read (blocking, factory mode) ----------
+static bool readFromBms() {
+  if (!bms.enter_factory_mode()) {
+    Serial.println("[BmsParams] enter factory mode failed");
+    return false;
+  }
+  bms.param_clear_errors();
+
+  BmsParams p;
+  p.fullChargeMv = bms.get_0x12_full_charge_voltage();
+  p.emptyMv      = bms.get_0x13_end_of_discharge_voltage();
+  p.designCapMah = bms.get_0x10_designed_capacity();
+  p.cycleCapMah  = bms.get_0x11_cycle_capacity();
+  p.cellOvTrigMv = bms.get_0x24_cell_over_volt_trig();
+  p.cellUvTrigMv = bms.get_0x26_cell_under_volt_trig();
+
+  const bool ok = bms.param_success();
+  bms.exit_factory_mode(false);
+
+  if (!ok || p.fullChargeMv == 0) {
+    Serial.println("[BmsParams] EEPROM read failed; keeping cached values");
+    return false;
+  }
+
+  bmsParams = p;
+  return true;
+}
+
+static void refreshNow() {
+  lastRefreshMs = millis();
+  if (!readFromBms()) return;
+
+  bmsParamsValid    = true;
+  bmsParamsLoadedMs = millis();
+  saveToNvs();
+  Serial.printf("[BmsParams] refreshed: full=%u mV empty=%u mV design=%lu mAh\n",
+                (unsigned)bmsParams.fullChargeMv, (unsigned)bmsParams.emptyMv,
+                (unsigned long)bmsParams.designCapMah);
+}
+
+// ---------- Public API ----------
+void bmsParamsInit() {
+  if (loadFromNvs()) {
+    bmsParamsValid = true;
+    lastRefreshMs  = millis();
+    Serial.printf("[BmsParams] loaded from NVS: full=%u mV\n", (unsigned)bmsParams.fullChargeMv);
+    return;
+  }
+  // Nothing stored yet: read once now, before CAN TX starts
+  refreshNow();
+}
+
+void bmsParamsRequestRefresh() {
+  refreshRequested = true;
+}
+
+bool bmsParamsRefreshPending() {
+  return refreshRequested;
+}
+
+void bmsParamsTick() {
+  // Factory-mode reads use the blocking path; never interleave with async polls
+  if (bms.async_busy()) return;
+
+  // Requested and periodic refreshes both wait for a quiet bus: factory-mode
+  // reads hold the BMS task for seconds, leaving the CAN payloads on stale
+  // pack data while the inverter is talking.
+  if (canHealth) return;
+
+  if (refreshRequested) {
+    refreshRequested = false;
+    refreshNow();
+    return;
+  }
+
+  if (bmsParamsValid && millis() - lastRefreshMs < BMS_PARAMS_REFRESH_MS) return;
+  if (!bmsParamsValid && millis() - lastRefreshMs < 60000UL) return;   // retry slowly after a failure
+
+  refreshNow();
+}
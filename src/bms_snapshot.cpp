@@ -0,0 +1,48 @@
+#include "bms_snapshot.h"
+
+#include <atomic>
+#include <string.h>
+
+static BmsSnapshot           snap;
+static std::atomic<uint32_t> snapSeq{0};          // odd while a publish is in progress
+static std::atomic<bool>     rebuildReq{false};
+
+// The copy runs in a critical section so a reader that preempts the writer
+// on the same core can never spin on an odd sequence.
+static portMUX_TYPE snapMux = portMUX_INITIALIZER_UNLOCKED;
+
+void bmsSnapshotPublish(const BmsSnapshot& s) {
+  portENTER_CRITICAL(&snapMux);
+  uint32_t seq = snapSeq.load(std::memory_order_relaxed);
+  snapSeq.store(seq + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+
+  memcpy(&snap, &s, sizeof(snap));
+  snap.seq     = seq + 2;
+  snap.takenMs = millis();
+
+  snapSeq.store(seq + 2, std::memory_order_release);
+  portEXIT_CRITICAL(&snapMux);
+}
+
+void bmsSnapshotGet(BmsSnapshot& out) {
+  for (;;) {
+    uint32_t s1 = snapSeq.load(std::memory_order_acquire);
+    if (s1 & 1) continue;
+    memcpy(&out, &snap, sizeof(out));
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (snapSeq.load(std::memory_order_relaxed) == s1) return;
+  }
+}
+
+uint32_t bmsSnapshotSeq() {
+  return snapSeq.load(std::memory_order_acquire);
+}
+
+void bmsSnapshotRequestRebuild() {
+  rebuildReq.store(true, std::memory_order_relaxed);
+}
+
+bool bmsSnapshotTakeRebuild() {
+  return rebuildReq.exchange(false, std::memory_order_relaxed);
+}
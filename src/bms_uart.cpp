@@ -0,0 +1,118 @@
+#include "bms_uart.h"
+#include <bms2.h>
+
+bool BmsUart::begin(uart_port_t p, uint32_t baud, int rxPin, int txPin) {
+  port = p;
+
+  uart_config_t cfg = {};
+  cfg.baud_rate  = (int)baud;
+  cfg.data_bits  = UART_DATA_8_BITS;
+  cfg.parity     = UART_PARITY_DISABLE;
+  cfg.stop_bits  = UART_STOP_BITS_1;
+  cfg.flow_ctrl  = UART_HW_FLOWCTRL_DISABLE;
+  cfg.source_clk = UART_SCLK_APB;
+
+  if (uart_driver_install(port, BMS_UART_RX_BUF, BMS_UART_TX_BUF, BMS_UART_EVQ_LEN, &events, 0) != ESP_OK) {
+    Serial.println("[BmsUart] driver install failed");
+    return false;
+  }
+  if (uart_param_config(port, &cfg) != ESP_OK ||
+      uart_set_pin(port, txPin, rxPin, UART_PIN_NO_CHANGE, UART_PIN_NO_CHANGE) != ESP_OK) {
+    Serial.println("[BmsUart] config failed");
+    uart_driver_delete(port);
+    events = nullptr;
+    return false;
+  }
+
+  // One-character pattern; chr_tout only matters for multi-character patterns.
+  // Without these wake-ups waitFrame() would sleep out every poll's timeout.
+  if (uart_enable_pattern_det_baud_intr(port, BMS_STOPBYTE, 1, 9, BMS_UART_POST_IDLE, 0) != ESP_OK ||
+      uart_pattern_queue_reset(port, BMS_UART_EVQ_LEN) != ESP_OK ||
+      uart_set_rx_timeout(port, BMS_UART_RX_TOUT) != ESP_OK) {
+    Serial.println("[BmsUart] frame detection setup failed");
+    uart_driver_delete(port);
+    events = nullptr;
+    return false;
+  }
+  return true;
+}
+
+bool BmsUart::waitFrame(uint32_t timeoutMs) {
+  if (!events) {
+    vTaskDelay(pdMS_TO_TICKS(timeoutMs) ? pdMS_TO_TICKS(timeoutMs) : 1);
+    return false;
+  }
+  TickType_t ticks = pdMS_TO_TICKS(timeoutMs);
+  uart_event_t ev;
+  if (xQueueReceive(events, &ev, ticks ? ticks : 1) != pdTRUE) return false;
+
+  // Take everything already queued so one frame is one wake-up
+  bool frameEnd = false;
+  do {
+    switch (ev.type) {
+      case UART_PATTERN_DET:
+        // The library reads bytes itself; positions are not needed
+        while (uart_pattern_pop_pos(port) >= 0) {}
+        st.frames++;
+        frameEnd = true;
+        break;
+      case UART_DATA:
+        if (ev.timeout_flag) {
+          st.rxTimeouts++;
+          frameEnd = true;
+        }
+        break;
+      case UART_FIFO_OVF:
+      case UART_BUFFER_FULL:
+        st.overruns++;
+        uart_flush_input(port);
+        xQueueReset(events);
+        peeked = -1;
+        return true;              // let the framer resync on what follows
+      case UART_FRAME_ERR:
+      case UART_PARITY_ERR:
+        st.lineErrors++;
+        break;
+      default:
+        break;
+    }
+  } while (xQueueReceive(events, &ev, 0) == pdTRUE);
+  return frameEnd;
+}
+
+// ---- Stream ----
+int BmsUart::available() {
+  size_t n = 0;
+  if (events) uart_get_buffered_data_len(port, &n);
+  return (int)n + (peeked >= 0 ? 1 : 0);
+}
+
+int BmsUart::read() {
+  if (peeked >= 0) {
+    int c = peeked;
+    peeked = -1;
+    return c;
+  }
+  uint8_t c;
+  if (!events || uart_read_bytes(port, &c, 1, 0) != 1) return -1;
+  return c;
+}
+
+int BmsUart::peek() {
+  if (peeked < 0) peeked = read();
+  return peeked;
+}
+
+void BmsUart::flush() {
+  if (events) uart_wait_tx_done(port, pdMS_TO_TICKS(100));
+}
+
+size_t BmsUart::write(uint8_t c) {
+  return write(&c, 1);
+}
+
+size_t BmsUart::write(const uint8_t* buf, size_t n) {
+  if (!events) return 0;
+  int w = uart_write_bytes(port, (const char*)buf, n);
+  return w > 0 ? (size_t)w : 0;
+}
@@ -1,117 +1,303 @@
 #include "can.h"
+#include "can_transport.h"
 #include "ecoflow.h"
-#include <esp_err.h>
+#include "web.h"
+#include "spsc_ring.h"
+#include "can_trace.h"
+#include "can_rec.h"
 
 // --- CAN fast pipeline counters ---
 volatile uint32_t can_rx_count   = 0;
 volatile uint32_t can_rx_dropped = 0;
 volatile uint32_t can_decoded    = 0;
 
-// --- RX queue ---
-QueueHandle_t canRxQ = nullptr;
+// --- Driver alert counters ---
+volatile uint32_t can_alert_wakeups = 0;
+volatile uint32_t can_rx_overruns   = 0;
+volatile uint32_t can_bus_errors    = 0;
+volatile uint32_t can_err_passive   = 0;
+volatile uint32_t can_bus_off       = 0;
+volatile uint32_t can_bus_recovered = 0;
+volatile uint32_t can_tx_failed     = 0;
+
+// --- RX ring (lock-free, drop-oldest) ---
+static SpscRing<CanFrame, CAN_RX_RING> canRxRing;
+static TaskHandle_t canRxTaskHandle     = nullptr;
+static TaskHandle_t canDecodeTaskHandle = nullptr;
+
+uint32_t canRxRingDepth()     { return canRxRing.size(); }
+uint32_t canRxRingHighWater() { return canRxRing.highWater(); }
 
 // --- Driver status ---
 bool twai_ok = false;
+static volatile bool canRxParked = true;   // canRxTask is outside all transport calls
+static CanTransport* canBus = nullptr;
 
-// ---------------- Driver init ----------------
-void canInitDriver() {
-  twai_general_config_t g =
-      TWAI_GENERAL_CONFIG_DEFAULT((gpio_num_t)CAN_TX, (gpio_num_t)CAN_RX, TWAI_MODE_NORMAL);
+void          canSetTransport(CanTransport* t) { canBus = t; }
+CanTransport* canGetTransport()                { return canBus; }
+
+// --- Acceptance filter mode ---
+static bool filterPromisc = false;
 
-  g.rx_queue_len = TWAI_RXQ;
-  g.tx_queue_len = TWAI_TXQ;
-  g.intr_flags   = 0;  // don't force IRAM
+bool canFilterPromiscuous() { return filterPromisc; }
 
-  twai_timing_config_t t = TWAI_TIMING_CONFIG_1MBITS();
-  twai_filter_config_t f = TWAI_FILTER_CONFIG_ACCEPT_ALL();
+static bool canWantPromiscuous() {
+  return (config.rxlogging && webCanLogActive()) || canRecActive();
+}
 
-  Serial.printf("TWAI pins TX=%d RX=%d, rxQ=%d txQ=%d\n",
-                (int)g.tx_io, (int)g.rx_io, g.rx_queue_len, g.tx_queue_len);
+// ---------------- Acceptance filter ----------------
+// Single 29-bit filter covering every ID in the table: any bit that differs
+// between table entries is opened up.
+CanFilter canFilterAll() {
+  return { 0, 0x1FFFFFFF };
+}
 
-  esp_err_t err = twai_driver_install(&g, &t, &f);
-  if (err != ESP_OK) {
-    Serial.printf("TWAI install failed: %s (rxQ=%d txQ=%d) FreeHeap=%u\n",
-                  esp_err_to_name(err), g.rx_queue_len, g.tx_queue_len, (unsigned)ESP.getFreeHeap());
-    twai_ok = false;
-    return;
-  }
+CanFilter canFilterFromIds(const uint32_t* ids, size_t n) {
+  if (n == 0) return canFilterAll();
 
-  err = twai_start();
-  if (err != ESP_OK) {
-    Serial.printf("TWAI start failed: %s\n", esp_err_to_name(err));
-    twai_driver_uninstall();
+  uint32_t code = ids[0] & 0x1FFFFFFF;
+  uint32_t diff = 0;
+  for (size_t i = 1; i < n; i++) diff |= (ids[i] & 0x1FFFFFFF) ^ code;
+  return { code & ~diff, diff };
+}
+
+// ---------------- Driver init ----------------
+void canInitDriver() {
+  if (!canBus) {
+    Serial.println("CAN: no transport installed");
     twai_ok = false;
     return;
   }
+  filterPromisc = canWantPromiscuous();
+  CanFilter f = filterPromisc ? canFilterAll() : canFilterFromIds(ecoflowRxIds, ecoflowRxIdCount);
+  Serial.printf("CAN %s filter %s\n", canBus->name(), filterPromisc ? "promiscuous" : "consumed-ids");
 
-  uint32_t alerts = TWAI_ALERT_RX_DATA | TWAI_ALERT_RX_QUEUE_FULL |
-                    TWAI_ALERT_RX_FIFO_OVERRUN | TWAI_ALERT_ERR_PASS |
-                    TWAI_ALERT_BUS_ERROR | TWAI_ALERT_ARB_LOST |
-                    TWAI_ALERT_TX_FAILED | TWAI_ALERT_TX_SUCCESS;
-  twai_reconfigure_alerts(alerts, NULL);
-
-  twai_ok = true;
-  Serial.println("TWAI CAN initialized (1Mbps)");
+  twai_ok = canBus->start(f);
 }
 
 // ---------------- TX primitive ----------------
 bool sendCANFrame(uint32_t can_id, const uint8_t* data, uint8_t len) {
+  if (!twai_ok) return false;
   if (!data || len == 0 || len > 8) {
     Serial.printf("sendCANFrame: bad args (data=%p len=%u)\n", data, len);
     return false;
   }
-  twai_message_t msg = {};
-  msg.identifier       = can_id & 0x1FFFFFFF;
-  msg.extd             = 1;
-  msg.rtr              = 0;
-  msg.data_length_code = len;
-  memcpy(msg.data, data, len);
-
-  esp_err_t err = twai_transmit(&msg, pdMS_TO_TICKS(100));
-  if (err != ESP_OK) {
+  CanFrame f = {};
+  f.id    = can_id & 0x1FFFFFFF;
+  f.dlc   = len;
+  f.flags = CAN_FRAME_EXTD;
+  memcpy(f.data, data, len);
+  return canBus->send(f, 100);
+}
+
+// ---------------- TX task ----------------
+// Owns canBus->send(). Whole messages are queued by priority and sent back to
+// back; a message is never interleaved with another (they share frame IDs),
+// so a heartbeat reply waits at most for the message already on the wire.
+struct CanTxMsg {
+  uint32_t          ids[3];      // first / middle / last
+  uint32_t          submitUs;
+  uint32_t          tagUs;
+  CanTxFirstFrameCb onFirst;
+  uint16_t          len;
+  uint8_t           flags;
+  uint8_t           bytes[CAN_TX_MSG_MAX];
+};
+
+static QueueHandle_t canTxQ[2]          = { nullptr, nullptr };   // CAN_TX_HIGH, CAN_TX_NORMAL
+static TaskHandle_t  canTxTaskHandle    = nullptr;
+static volatile bool canTxBusy          = false;
+
+static volatile uint32_t txSubmitted[2], txRejected[2];
+static volatile uint32_t txSent = 0, txFailed = 0;
+static volatile uint32_t txWaitLastUs[2], txWaitMaxUs[2];
+static uint64_t          txWaitSumUs[2];
+static uint32_t          txWaitCount[2];
+
+bool canSubmit(CanTxPrio prio, uint32_t idFirst, uint32_t idMiddle, uint32_t idLast,
+               const uint8_t* bytes, size_t len, uint8_t flags,
+               CanTxFirstFrameCb onFirst, uint32_t tagUs) {
+  if (prio > CAN_TX_NORMAL) prio = CAN_TX_NORMAL;
+  if (!canTxQ[prio] || !bytes || len == 0) return false;
+  if (len > CAN_TX_MSG_MAX) {
+    Serial.printf("canSubmit: %u bytes > CAN_TX_MSG_MAX\n", (unsigned)len);
+    txRejected[prio]++;
+    return false;
+  }
+
+  CanTxMsg msg;
+  msg.ids[0] = idFirst; msg.ids[1] = idMiddle; msg.ids[2] = idLast;
+  msg.submitUs = micros();
+  msg.tagUs    = tagUs;
+  msg.onFirst  = onFirst;
+  msg.len      = (uint16_t)len;
+  msg.flags    = flags;
+  memcpy(msg.bytes, bytes, len);
+
+  if (xQueueSend(canTxQ[prio], &msg, 0) != pdTRUE) {
+    txRejected[prio]++;
     return false;
   }
+  txSubmitted[prio]++;
+  xTaskNotifyGive(canTxTaskHandle);
   return true;
 }
 
-// ---------------- Tasks ----------------
-static void canRxTask(void *arg) {
-  twai_message_t msg;
+static bool canTxSendMessage(const CanTxMsg& m) {
+  const bool lenPrefix = (m.flags & CAN_TX_LEN_PREFIX) != 0;
+  const uint8_t per = lenPrefix ? 7 : 8;
+  const bool trace = canTraceOn(CAN_TRACE_TX);
+  size_t pos = 0, frame_idx = 0;
+
+  while (pos < m.len) {
+    size_t   remain = m.len - pos;
+    uint8_t  chunk  = (remain > per) ? per : (uint8_t)remain;
+    bool     last   = (remain <= per);
+    uint32_t id     = (frame_idx == 0) ? m.ids[0] : (last ? m.ids[2] : m.ids[1]);
+
+    bool ok;
+    if (lenPrefix) {
+      // [len][<=7 data] → DLC = len + 1
+      uint8_t fb[8];
+      fb[0] = chunk;
+      memcpy(&fb[1], &m.bytes[pos], chunk);
+      ok = sendCANFrame(id, fb, (uint8_t)(chunk + 1));
+      if (ok && trace) canTraceRecord(CAN_TRACE_TX, micros(), id, fb, (uint8_t)(chunk + 1));
+    } else {
+      ok = sendCANFrame(id, &m.bytes[pos], chunk);
+      if (ok && trace) canTraceRecord(CAN_TRACE_TX, micros(), id, &m.bytes[pos], chunk);
+    }
+    if (!ok) return false;   // rest of a broken message is useless to the receiver
+
+    if (frame_idx == 0 && m.onFirst) m.onFirst(m.tagUs);
+    pos += chunk;
+    frame_idx++;
+  }
+  return true;
+}
+
+void canTxPoll() {
+  static CanTxMsg m;
   for (;;) {
-    if (!twai_ok) { vTaskDelay(pdMS_TO_TICKS(10)); continue; }
+    // High priority first, re-checked after every message
+    uint8_t p;
+    if      (xQueueReceive(canTxQ[CAN_TX_HIGH],   &m, 0) == pdTRUE) p = CAN_TX_HIGH;
+    else if (xQueueReceive(canTxQ[CAN_TX_NORMAL], &m, 0) == pdTRUE) p = CAN_TX_NORMAL;
+    else break;
+
+    uint32_t waited = micros() - m.submitUs;
+    txWaitLastUs[p] = waited;
+    if (waited > txWaitMaxUs[p]) txWaitMaxUs[p] = waited;
+    txWaitSumUs[p] += waited;
+    txWaitCount[p]++;
+
+    canTxBusy = true;
+    bool ok = twai_ok && canTxSendMessage(m);
+    canTxBusy = false;
+
+    if (ok) txSent++; else txFailed++;
+  }
+}
 
-    esp_err_t r = twai_receive(&msg, pdMS_TO_TICKS(20));
+static void canTxTask(void*) {
+  for (;;) {
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    canTxPoll();
+  }
+}
 
-    if (r == ESP_OK) {
-      can_rx_count++;
+void canTxGetStats(CanTxStats& out) {
+  for (int p = 0; p < 2; p++) {
+    out.depth[p]     = canTxQ[p] ? (uint32_t)uxQueueMessagesWaiting(canTxQ[p]) : 0;
+    out.submitted[p] = txSubmitted[p];
+    out.rejected[p]  = txRejected[p];
+    out.waitLastUs[p] = txWaitLastUs[p];
+    out.waitMaxUs[p]  = txWaitMaxUs[p];
+    out.waitAvgUs[p]  = txWaitCount[p] ? (uint32_t)(txWaitSumUs[p] / txWaitCount[p]) : 0;
+  }
+  out.sent   = txSent;
+  out.failed = txFailed;
+}
 
-      // RX enabled gate (identical logic)
-      if (!config.canRxEnabled) {
-        continue;
-      }
+// ---------------- Tasks ----------------
+// Move every frame currently held by the transport into the ring
+static void canDrainDriver() {
+  CanFrame f;
+  bool pushed = false;
 
-      if (canRxQ && xQueueSend(canRxQ, &msg, 0) != pdTRUE) {
-        twai_message_t dump;
-        xQueueReceive(canRxQ, &dump, 0);
-        xQueueSend(canRxQ, &msg, 0);
-        can_rx_dropped++;
-      }
+  while (canBus->receive(f)) {
+    can_rx_count++;
 
-    } else if (r == ESP_ERR_TIMEOUT) {
-      // idle
-    } else {
-      vTaskDelay(pdMS_TO_TICKS(2));
+    // RX enabled gate (identical logic)
+    if (!config.canRxEnabled) {
+      continue;
     }
+
+    f.ts_us = micros();
+    if (!canRxRing.push(f)) can_rx_dropped++;   // oldest frame was evicted
+    pushed = true;
   }
+
+  if (pushed) xTaskNotifyGive(canDecodeTaskHandle);
 }
 
-static void canDecodeTask(void *arg) {
-  twai_message_t msg;
+void canRxPoll(uint32_t waitMs) {
+  uint32_t ev = canBus->wait(waitMs);
+  if (!ev) return;
+  can_alert_wakeups++;
+
+  if (ev & CAN_EV_RX_OVERRUN)  can_rx_overruns++;
+  if (ev & CAN_EV_BUS_ERROR)   can_bus_errors++;
+  if (ev & CAN_EV_ERR_PASSIVE) can_err_passive++;
+  if (ev & CAN_EV_TX_FAILED)   can_tx_failed++;
+
+  if (ev & CAN_EV_RX) canDrainDriver();
+
+  if (ev & CAN_EV_BUS_OFF) {
+    can_bus_off++;
+    Serial.printf("CAN %s bus-off; initiating recovery\n", canBus->name());
+    canBus->recover();
+  }
+  if (ev & CAN_EV_RECOVERED) {
+    can_bus_recovered++;
+    canBus->restart();
+  }
+}
+
+static void canRxTask(void*) {
   for (;;) {
-    if (xQueueReceive(canRxQ, &msg, portMAX_DELAY) == pdTRUE) {
-      processEcoFlowCAN(msg);
-      can_decoded++;
-    }
+    if (!twai_ok) { canRxParked = true; vTaskDelay(pdMS_TO_TICKS(10)); continue; }
+    canRxParked = false;
+
+    // Finite wait so a transport that goes away (twai_ok=false) is noticed
+    canRxPoll(100);
+  }
+}
+
+void canDecodePoll() {
+  CanFrame f;
+  twai_message_t msg = {};
+  const bool trace = canTraceOn(CAN_TRACE_RX);
+  while (canRxRing.pop(f)) {
+    msg.identifier       = f.id;
+    msg.extd             = (f.flags & CAN_FRAME_EXTD) ? 1 : 0;
+    msg.rtr              = (f.flags & CAN_FRAME_RTR) ? 1 : 0;
+    msg.data_length_code = f.dlc;
+    memcpy(msg.data, f.data, 8);
+    processEcoFlowCAN(msg, f.ts_us);
+    can_decoded++;
+    if (trace) canTraceRecord(CAN_TRACE_RX, f.ts_us, f.id, f.data, f.dlc);
+  }
+  ecoflowRxCheckTimeout();
+}
+
+static void canDecodeTask(void*) {
+  for (;;) {
+    // Sleep until frames arrive or the open 14001 stream hits its deadline
+    uint32_t waitMs = ecoflowRxMsUntilDeadline();
+    TickType_t waitTicks = (waitMs == UINT32_MAX) ? portMAX_DELAY : pdMS_TO_TICKS(waitMs) + 1;
+    ulTaskNotifyTake(pdTRUE, waitTicks);
+    canDecodePoll();
   }
 }
 
@@ -119,13 +305,16 @@ static void canDecodeTask(void *arg) {
 void canStartTasks() {
   if (!twai_ok) return;
 
-  if (!canRxQ) {
-    canRxQ = xQueueCreate(256, sizeof(twai_message_t));
-  }
+  // Ring is single-producer/single-consumer: never start a second pair
+  if (canRxTaskHandle) return;
+
+  canTxQ[CAN_TX_HIGH]   = xQueueCreate(CAN_TX_Q_HIGH, sizeof(CanTxMsg));
+  canTxQ[CAN_TX_NORMAL] = xQueueCreate(CAN_TX_Q_NORM, sizeof(CanTxMsg));
 
   // Same priorities/cores as your current baseline
-  xTaskCreatePinnedToCore(canRxTask,     "canRx",     4096, nullptr, 8, nullptr, 0);
-  xTaskCreatePinnedToCore(canDecodeTask, "canDecode", 6144, nullptr, 7, nullptr, 0);
+  xTaskCreatePinnedToCore(canDecodeTask, "canDecode", 6144, nullptr, 7, &canDecodeTaskHandle, 0);
+  xTaskCreatePinnedToCore(canRxTask,     "canRx",     4096, nullptr, 8, &canRxTaskHandle,     0);
+  xTaskCreatePinnedToCore(canTxTask,     "canTx",     4096, nullptr, 7, &canTxTaskHandle,     0);
 }
 
 bool canTryInitAndStart() {
@@ -138,3 +327,30 @@ bool canTryInitAndStart() {
   }
   return false;
 }
+
+// ---------------- Filter mode switch ----------------
+// A transport takes its filter at start() (TWAI installs the driver with
+// it), so a mode change means a full stop/start cycle. canRxTask parks
+// itself once twai_ok drops and canTxTask stops starting new messages.
+void canFilterTick() {
+  static uint32_t lastCheck = 0;
+  uint32_t now = millis();
+  if (now - lastCheck < 500) return;
+  lastCheck = now;
+
+  if (!twai_ok) return;
+  const bool want = canWantPromiscuous();
+  if (want == filterPromisc) return;
+
+  twai_ok = false;
+  uint32_t t0 = millis();
+  while ((!canRxParked || canTxBusy) && millis() - t0 < 300) vTaskDelay(pdMS_TO_TICKS(5));
+  if (!canRxParked || canTxBusy) {
+    Serial.println("TWAI filter switch: CAN tasks did not park; keeping current filter");
+    twai_ok = true;
+    return;
+  }
+
+  canBus->stop();
+  canInitDriver();
+}
@@ -0,0 +1,83 @@
+#include "can_loopback.h"
+#include <chrono>
+
+// Wake-ups only take the mutex when the other side is actually blocked.
+// The seq_cst fences pair "publish, then check the flag" with "set the
+// flag, then re-check", so neither side can miss the other.
+static void wakeIf(std::atomic<bool>& waiting, std::mutex& mu, std::condition_variable& cv) {
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  if (!waiting.load(std::memory_order_relaxed)) return;
+  { std::lock_guard<std::mutex> lk(mu); }
+  cv.notify_all();
+}
+
+bool CanLoopbackPort::start(const CanFilter& filter) {
+  filter_ = filter;
+  CanFrame f;
+  while (rx_.pop(f)) {}
+  dropsSeen_ = rx_.drops();
+  started_ = true;
+  return true;
+}
+
+void CanLoopbackPort::stop() {
+  started_ = false;
+  wakeIf(rxWaiting_, mu_, cv_);
+}
+
+bool CanLoopbackPort::send(const CanFrame& f, uint32_t timeoutMs) {
+  if (!started_) return false;
+  return peer_->deliver(f, timeoutMs);
+}
+
+bool CanLoopbackPort::deliver(const CanFrame& f, uint32_t timeoutMs) {
+  // A stopped node or a filtered ID: the frame still went out on the bus
+  if (!started_ || !canFilterMatch(filter_, f.id)) return true;
+
+  if (rx_.size() >= rx_.capacity()) {
+    if (!timeoutMs) return false;
+    std::unique_lock<std::mutex> lk(mu_);
+    txWaiting_ = true;
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    bool room = cv_.wait_for(lk, std::chrono::milliseconds(timeoutMs),
+                             [&] { return rx_.size() < rx_.capacity() || !started_; });
+    txWaiting_ = false;
+    if (!room || !started_) return false;
+  }
+  rx_.push(f);
+  wakeIf(rxWaiting_, mu_, cv_);
+  return true;
+}
+
+uint32_t CanLoopbackPort::wait(uint32_t timeoutMs) {
+  auto events = [&]() -> uint32_t {
+    uint32_t ev = 0;
+    if (rx_.size()) ev |= CAN_EV_RX;
+    if (rx_.drops() != dropsSeen_) ev |= CAN_EV_RX_OVERRUN;
+    return ev;
+  };
+
+  uint32_t ev = events();
+  if (!ev && timeoutMs && started_) {
+    std::unique_lock<std::mutex> lk(mu_);
+    rxWaiting_ = true;
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    cv_.wait_for(lk, std::chrono::milliseconds(timeoutMs), [&] { return events() || !started_; });
+    rxWaiting_ = false;
+    ev = events();
+  }
+  dropsSeen_ = rx_.drops();
+  return ev;
+}
+
+bool CanLoopbackPort::receive(CanFrame& f) {
+  if (!rx_.pop(f)) return false;
+  wakeIf(txWaiting_, mu_, cv_);
+  return true;
+}
+
+void CanLoopbackPort::status(CanTransportStatus& out) {
+  out.rxMissed  = rx_.drops();
+  out.rxOverrun = 0;
+  out.state     = started_ ? 1 : 0;
+}
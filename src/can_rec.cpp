@@ -0,0 +1,360 @@
+#include "can_rec.h"
+#include "config.h"
+#include "spsc_ring.h"
+#include "time_ntp.h"
+
+#include <FS.h>
+#include <SPIFFS.h>
+#include <SD.h>
+#include <SPI.h>
+#include <Preferences.h>
+#include <math.h>
+#include <memory>
+
+// NVS goes through function-local Preferences: the global prefs belongs to
+// the web/config code on other tasks, and the recorder writes from canRec.
+
+// ---------------- Medium ----------------
+static SPIClass    sdSpi(HSPI);
+static fs::FS*     recFs      = nullptr;
+static bool        recOnSd    = false;
+static uint32_t    recFileMax = 0;
+static uint8_t     recKeep    = 0;
+
+// ---------------- Shared state ----------------
+static SpscRing<CanTraceRec, CANREC_RING> recRing[2];   // [CAN_TRACE_RX], [CAN_TRACE_TX]
+static volatile bool recEnabled    = false;
+static TaskHandle_t  recTaskHandle = nullptr;
+
+static volatile uint32_t recRecords     = 0;
+static volatile uint32_t recWriteErrors = 0;
+static volatile uint32_t recCurSeq      = 0;
+static volatile uint32_t recCurBytes    = 0;
+static volatile bool     recFileOpen    = false;
+
+// ---------------- Task-owned state ----------------
+static CanTraceRec recStaged[2];          // one lookahead per ring, to merge by time
+static bool        recHaveStaged[2] = {false, false};
+static File     recFile;
+static uint32_t recNextSeq     = 0;
+static uint32_t recOpenedMs    = 0;
+static uint32_t recLastWriteMs = 0;
+static uint32_t recLastOpenTry = 0;
+static uint8_t  recBlock[CANREC_BLOCK];
+static size_t   recBlockUsed   = 0;
+
+static void recPath(uint32_t seq, char* buf, size_t cap) {
+  snprintf(buf, cap, CANREC_DIR "/%05lu.bin", (unsigned long)seq);
+}
+
+// Calls fn(seq, bytes) for every recording on the medium
+template <typename Fn>
+static void recForEachFile(Fn fn) {
+  File dir = recFs->open(CANREC_DIR);
+  if (!dir || !dir.isDirectory()) return;
+  for (File f = dir.openNextFile(); f; f = dir.openNextFile()) {
+    const char* name = strrchr(f.name(), '/');
+    name = name ? name + 1 : f.name();
+    char* end;
+    unsigned long seq = strtoul(name, &end, 10);
+    if (end != name && strcmp(end, ".bin") == 0) fn((uint32_t)seq, (uint32_t)f.size());
+  }
+}
+
+static bool recNeedsSpace(uint8_t files) {
+  if (files >= recKeep) return true;
+  if (recOnSd) return false;
+  return SPIFFS.totalBytes() - SPIFFS.usedBytes() < recFileMax + CANREC_BLOCK;
+}
+
+// Delete oldest recordings until one more file fits
+static void recPrune() {
+  for (;;) {
+    uint8_t  files  = 0;
+    uint32_t oldest = UINT32_MAX;
+    recForEachFile([&](uint32_t seq, uint32_t) {
+      files++;
+      if (seq < oldest) oldest = seq;
+    });
+    if (files == 0 || !recNeedsSpace(files)) return;
+
+    char path[32];
+    recPath(oldest, path, sizeof(path));
+    if (!recFs->remove(path)) return;
+    Serial.printf("[CanRec] removed %s\n", path);
+  }
+}
+
+static void recWriteBlock() {
+  if (!recBlockUsed) return;
+  size_t put = recFile.write(recBlock, recBlockUsed);
+  if (put != recBlockUsed) recWriteErrors++;
+  recCurBytes   += put;
+  recBlockUsed   = 0;
+  recLastWriteMs = millis();
+}
+
+static void recClose() {
+  if (!recFile) return;
+  recWriteBlock();
+  recFile.close();
+  recFileOpen = false;
+}
+
+static void recOpenNext() {
+  recLastOpenTry = millis();
+  recFs->mkdir(CANREC_DIR);
+  recPrune();
+
+  char path[32];
+  recPath(recNextSeq, path, sizeof(path));
+  recFile = recFs->open(path, "w");
+  if (!recFile) {
+    Serial.printf("[CanRec] open %s failed\n", path);
+    return;
+  }
+
+  CanRecHeader h = {};
+  h.magic   = CANREC_MAGIC;
+  h.version = CANREC_VERSION;
+  h.recSize = sizeof(CanTraceRec);
+  double now = now_seconds();
+  h.anchorUs = micros();
+  h.wallSec  = (uint32_t)now;
+  h.wallUsec = (uint32_t)((now - floor(now)) * 1e6);
+  recFile.write((const uint8_t*)&h, sizeof(h));
+
+  recCurSeq      = recNextSeq++;
+  recCurBytes    = sizeof(h);
+  recOpenedMs    = millis();
+  recLastWriteMs = recOpenedMs;
+  recFileOpen    = true;
+
+  Preferences nvs;
+  nvs.begin("canrec", false);
+  nvs.putUInt("seq", recNextSeq);
+  nvs.end();
+  Serial.printf("[CanRec] recording to %s (%s)\n", path, recOnSd ? "SD" : "SPIFFS");
+}
+
+// Oldest record across both rings
+static bool recPop(CanTraceRec& out) {
+  for (uint8_t d = 0; d < 2; d++)
+    if (!recHaveStaged[d]) recHaveStaged[d] = recRing[d].pop(recStaged[d]);
+
+  int pick;
+  if (recHaveStaged[0] && recHaveStaged[1])
+    pick = ((int32_t)(recStaged[1].ts_us - recStaged[0].ts_us) < 0) ? 1 : 0;
+  else if (recHaveStaged[0]) pick = 0;
+  else if (recHaveStaged[1]) pick = 1;
+  else return false;
+
+  out = recStaged[pick];
+  recHaveStaged[pick] = false;
+  return true;
+}
+
+// ---------------- Task ----------------
+// Low priority: everything here may block on flash/SD without touching the CAN path
+static void canRecTask(void*) {
+  bool recording = false;
+  CanTraceRec r;
+  for (;;) {
+    ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(100));
+
+    if (recEnabled != recording) {
+      recording = recEnabled;
+      if (recording) recOpenNext(); else recClose();
+    }
+    if (recording && !recFile && millis() - recLastOpenTry > 10000) recOpenNext();
+
+    if (!recording || !recFile) {
+      while (recPop(r)) {}
+      continue;
+    }
+
+    while (recPop(r)) {
+      if (recBlockUsed + sizeof(r) > CANREC_BLOCK) recWriteBlock();
+      memcpy(recBlock + recBlockUsed, &r, sizeof(r));
+      recBlockUsed += sizeof(r);
+      recRecords++;
+    }
+
+    uint32_t now = millis();
+    if (recBlockUsed && now - recLastWriteMs >= CANREC_FLUSH_MS) {
+      recWriteBlock();
+      recFile.flush();
+    }
+    // Hourly rotation also keeps each file well inside one micros() wrap
+    if (recCurBytes + recBlockUsed >= recFileMax || now - recOpenedMs >= CANREC_ROTATE_MS) {
+      recClose();
+      recOpenNext();
+    }
+  }
+}
+
+// ---------------- Public API ----------------
+void canRecInit() {
+  sdSpi.begin(SD_SCLK, SD_MISO, SD_MOSI, SD_CS);
+  if (SD.begin(SD_CS, sdSpi)) {
+    recFs      = &SD;
+    recOnSd    = true;
+    recFileMax = CANREC_SD_FILE_MAX;
+    recKeep    = CANREC_SD_KEEP;
+  } else {
+    sdSpi.end();
+    recFs      = &SPIFFS;
+    recOnSd    = false;
+    recFileMax = CANREC_SPIFFS_FILE_MAX;
+    recKeep    = CANREC_SPIFFS_KEEP;
+  }
+
+  Preferences nvs;
+  nvs.begin("canrec", true);
+  recEnabled = nvs.getBool("on", false);
+  recNextSeq = nvs.getUInt("seq", 0);
+  nvs.end();
+
+  // Never reuse a number that is still on the medium
+  recForEachFile([](uint32_t seq, uint32_t) {
+    if (seq >= recNextSeq) recNextSeq = seq + 1;
+  });
+
+  Serial.printf("[CanRec] medium=%s enabled=%d next=%lu\n",
+                recOnSd ? "SD" : "SPIFFS", recEnabled ? 1 : 0, (unsigned long)recNextSeq);
+  xTaskCreatePinnedToCore(canRecTask, "canRec", 4096, nullptr, 1, &recTaskHandle, 1);
+}
+
+bool canRecActive() {
+  return recEnabled && recFs != nullptr;
+}
+
+void canRecSetEnabled(bool on) {
+  recEnabled = on;
+  Preferences nvs;
+  nvs.begin("canrec", false);
+  nvs.putBool("on", on);
+  nvs.end();
+  if (recTaskHandle) xTaskNotifyGive(recTaskHandle);
+}
+
+void canRecPush(const CanTraceRec& r) {
+  if (!canRecActive()) return;
+  SpscRing<CanTraceRec, CANREC_RING>& ring = recRing[r.dir & 1];
+  ring.push(r);
+  // Wake the task early under bursts instead of waiting out its 100 ms tick
+  if (ring.size() == CANREC_RING / 2 && recTaskHandle) xTaskNotifyGive(recTaskHandle);
+}
+
+void canRecStatusJson(String& out) {
+  char buf[160];
+  snprintf(buf, sizeof(buf),
+           "{\"enabled\":%s,\"medium\":\"%s\",\"open\":%s,\"file\":\"%05lu\",\"bytes\":%lu,"
+           "\"records\":%lu,\"ring_drops\":%lu,\"write_errors\":%lu,\"files\":[",
+           recEnabled ? "true" : "false", recFs ? (recOnSd ? "sd" : "spiffs") : "none",
+           recFileOpen ? "true" : "false", (unsigned long)recCurSeq, (unsigned long)recCurBytes,
+           (unsigned long)recRecords, (unsigned long)(recRing[0].drops() + recRing[1].drops()),
+           (unsigned long)recWriteErrors);
+  out = buf;
+  if (recFs) {
+    bool first = true;
+    recForEachFile([&](uint32_t seq, uint32_t bytes) {
+      snprintf(buf, sizeof(buf), "%s{\"name\":\"%05lu\",\"bytes\":%lu}",
+               first ? "" : ",", (unsigned long)seq, (unsigned long)bytes);
+      out += buf;
+      first = false;
+    });
+  }
+  out += "]}";
+}
+
+// ---------------- Download (binary -> candump on the fly) ----------------
+struct RecDownload {
+  File        f;
+  double      wallBase;
+  uint32_t    prevTs;
+  int64_t     elapsedUs;    // unwrapped micros() since the header anchor
+  char        line[64];
+  size_t      lineLen = 0;
+  size_t      linePos = 0;
+};
+
+// Next candump line into d.line; false at end of file
+static bool recNextLine(RecDownload& d) {
+  CanTraceRec r;
+  if (d.f.read((uint8_t*)&r, sizeof(r)) != sizeof(r)) return false;
+  d.elapsedUs += (int32_t)(r.ts_us - d.prevTs);
+  d.prevTs = r.ts_us;
+
+  size_t n = canTraceFormatAt(r, d.wallBase + (double)d.elapsedUs * 1e-6, d.line, sizeof(d.line) - 1);
+  d.line[n++] = '\n';
+  d.lineLen = n;
+  d.linePos = 0;
+  return true;
+}
+
+void canRecRoutes(AsyncWebServer& server) {
+  server.on("/api/canrec", HTTP_GET, [](AsyncWebServerRequest* request) {
+    String json;
+    canRecStatusJson(json);
+    request->send(200, "application/json", json);
+  });
+
+  server.on("/api/canrec/start", HTTP_POST, [](AsyncWebServerRequest* request) {
+    canRecSetEnabled(true);
+    request->send(200, "application/json", "{\"ok\":true}");
+  });
+
+  server.on("/api/canrec/stop", HTTP_POST, [](AsyncWebServerRequest* request) {
+    canRecSetEnabled(false);
+    request->send(200, "application/json", "{\"ok\":true}");
+  });
+
+  // GET /api/canrec/file?name=00012[&fmt=bin]; the open file reads up to its last flush
+  server.on("/api/canrec/file", HTTP_GET, [](AsyncWebServerRequest* request) {
+    if (!recFs || !request->hasParam("name")) { request->send(400, "text/plain", "name required"); return; }
+    String name = request->getParam("name")->value();
+    char* end;
+    unsigned long seq = strtoul(name.c_str(), &end, 10);
+    if (end == name.c_str() || *end) { request->send(400, "text/plain", "bad name"); return; }
+
+    char path[32];
+    recPath((uint32_t)seq, path, sizeof(path));
+    if (!recFs->exists(path)) { request->send(404, "text/plain", "File not found"); return; }
+
+    if (request->hasParam("fmt") && request->getParam("fmt")->value() == "bin") {
+      request->send(*recFs, path, "application/octet-stream", true);
+      return;
+    }
+
+    auto d = std::make_shared<RecDownload>();
+    d->f = recFs->open(path, "r");
+    CanRecHeader h;
+    if (!d->f || d->f.read((uint8_t*)&h, sizeof(h)) != sizeof(h) ||
+        h.magic != CANREC_MAGIC || h.recSize != sizeof(CanTraceRec)) {
+      request->send(500, "text/plain", "bad recording");
+      return;
+    }
+    d->wallBase  = (double)h.wallSec + (double)h.wallUsec * 1e-6;
+    d->prevTs    = h.anchorUs;
+    d->elapsedUs = 0;
+
+    AsyncWebServerResponse* res = request->beginChunkedResponse("text/plain",
+      [d](uint8_t* buf, size_t maxLen, size_t) -> size_t {
+        size_t put = 0;
+        while (put < maxLen) {
+          if (d->linePos == d->lineLen && !recNextLine(*d)) break;
+          size_t n = d->lineLen - d->linePos;
+          if (n > maxLen - put) n = maxLen - put;
+          memcpy(buf + put, d->line + d->linePos, n);
+          d->linePos += n;
+          put += n;
+        }
+        return put;
+      });
+    char disp[64];
+    snprintf(disp, sizeof(disp), "attachment; filename=\"canrec_%05lu.log\"", seq);
+    res->addHeader("Content-Disposition", disp);
+    request->send(res);
+  });
+}
@@ -0,0 +1,85 @@
+#include "can_trace.h"
+#include "config.h"
+#include "web.h"
+#include "can_rec.h"
+#include "time_ntp.h"
+#include "spsc_ring.h"
+#include <string.h>
+
+static SpscRing<CanTraceRec, CAN_TRACE_RING> traceRing[2];   // [CAN_TRACE_RX], [CAN_TRACE_TX]
+
+// Consumer-side lookahead: one record per ring, so output can be merged by time
+static CanTraceRec staged[2];
+static bool        haveStaged[2] = {false, false};
+
+// ---------------- Producers ----------------
+static bool canTraceLive(CanTraceDir dir) {
+  const bool enabled = (dir == CAN_TRACE_RX) ? config.rxlogging : config.txlogging;
+  return enabled && webCanLogActive();
+}
+
+bool canTraceOn(CanTraceDir dir) {
+  return canTraceLive(dir) || canRecActive();
+}
+
+void canTraceRecord(CanTraceDir dir, uint32_t tsUs, uint32_t id, const uint8_t* data, uint8_t dlc) {
+  CanTraceRec r;
+  r.ts_us  = tsUs;
+  r.id     = id & 0x1FFFFFFF;
+  r.dlc    = dlc > 8 ? 8 : dlc;
+  r.dir    = dir;
+  r.rsv[0] = r.rsv[1] = 0;
+  memset(r.data, 0, sizeof(r.data));
+  memcpy(r.data, data, r.dlc);
+  if (canTraceLive(dir)) traceRing[dir].push(r);
+  canRecPush(r);
+}
+
+// ---------------- Consumer ----------------
+bool canTracePop(CanTraceRec& out) {
+  for (uint8_t d = 0; d < 2; d++)
+    if (!haveStaged[d]) haveStaged[d] = traceRing[d].pop(staged[d]);
+
+  int pick;
+  if (haveStaged[0] && haveStaged[1])
+    pick = ((int32_t)(staged[1].ts_us - staged[0].ts_us) < 0) ? 1 : 0;
+  else if (haveStaged[0]) pick = 0;
+  else if (haveStaged[1]) pick = 1;
+  else return false;
+
+  out = staged[pick];
+  haveStaged[pick] = false;
+  return true;
+}
+
+void canTraceClear() {
+  CanTraceRec r;
+  while (canTracePop(r)) {}
+}
+
+size_t canTraceFormat(const CanTraceRec& r, char* buf, size_t cap) {
+  // Record time -> wall clock, relative to now (micros() wraps every ~71 min)
+  double ts = now_seconds() - (double)(uint32_t)(micros() - r.ts_us) * 1e-6;
+  return canTraceFormatAt(r, ts, buf, cap);
+}
+
+size_t canTraceFormatAt(const CanTraceRec& r, double ts, char* buf, size_t cap) {
+  static const char hex[] = "0123456789ABCDEF";
+  int n = snprintf(buf, cap, "(%012.6f) vcan%s %08lX#", ts,
+                   r.dir == CAN_TRACE_TX ? "Tx" : "Rx", (unsigned long)r.id);
+  if (n < 0 || (size_t)n + r.dlc * 2 + 1 > cap) return 0;
+  for (uint8_t i = 0; i < r.dlc; i++) {
+    buf[n++] = hex[r.data[i] >> 4];
+    buf[n++] = hex[r.data[i] & 0x0F];
+  }
+  buf[n] = 0;
+  return (size_t)n;
+}
+
+uint32_t canTraceDrops() {
+  return traceRing[CAN_TRACE_RX].drops() + traceRing[CAN_TRACE_TX].drops();
+}
+
+uint32_t canTraceDepth() {
+  return traceRing[CAN_TRACE_RX].size() + traceRing[CAN_TRACE_TX].size();
+}
@@ -0,0 +1,123 @@
+#include "can_twai.h"
+#include "driver/twai.h"
+#include <esp_err.h>
+
+// Owns twai_driver_install/uninstall. The driver holds one filter for its
+// lifetime, so start() is a full install with the requested filter.
+class TwaiTransport : public CanTransport {
+public:
+  const char* name() const override { return "twai"; }
+
+  bool start(const CanFilter& filter) override {
+    twai_general_config_t g =
+        TWAI_GENERAL_CONFIG_DEFAULT((gpio_num_t)CAN_TX, (gpio_num_t)CAN_RX, TWAI_MODE_NORMAL);
+    g.rx_queue_len = TWAI_RXQ;
+    g.tx_queue_len = TWAI_TXQ;
+    g.intr_flags   = 0;  // don't force IRAM
+
+    twai_timing_config_t t = TWAI_TIMING_CONFIG_1MBITS();
+
+    twai_filter_config_t f = TWAI_FILTER_CONFIG_ACCEPT_ALL();
+    if (filter.dontCare != 0x1FFFFFFF) {
+      f.acceptance_code = filter.code << 3;              // RTR bit (2) must be 0
+      f.acceptance_mask = (filter.dontCare << 3) | 0x3;  // bits 1:0 unused in extended format
+      f.single_filter   = true;
+    }
+
+    Serial.printf("TWAI pins TX=%d RX=%d, rxQ=%d txQ=%d\n",
+                  (int)g.tx_io, (int)g.rx_io, g.rx_queue_len, g.tx_queue_len);
+    Serial.printf("TWAI filter code=0x%08lX mask=0x%08lX\n",
+                  (unsigned long)f.acceptance_code, (unsigned long)f.acceptance_mask);
+
+    esp_err_t err = twai_driver_install(&g, &t, &f);
+    if (err != ESP_OK) {
+      Serial.printf("TWAI install failed: %s (rxQ=%d txQ=%d) FreeHeap=%u\n",
+                    esp_err_to_name(err), g.rx_queue_len, g.tx_queue_len, (unsigned)ESP.getFreeHeap());
+      return false;
+    }
+
+    err = twai_start();
+    if (err != ESP_OK) {
+      Serial.printf("TWAI start failed: %s\n", esp_err_to_name(err));
+      twai_driver_uninstall();
+      return false;
+    }
+
+    // canRxTask sleeps on these; TX_SUCCESS is left out so every transmit
+    // doesn't wake the RX task.
+    uint32_t alerts = TWAI_ALERT_RX_DATA | TWAI_ALERT_RX_QUEUE_FULL |
+                      TWAI_ALERT_RX_FIFO_OVERRUN | TWAI_ALERT_ERR_PASS |
+                      TWAI_ALERT_BUS_ERROR | TWAI_ALERT_ARB_LOST |
+                      TWAI_ALERT_TX_FAILED | TWAI_ALERT_BUS_OFF |
+                      TWAI_ALERT_BUS_RECOVERED;
+    twai_reconfigure_alerts(alerts, NULL);
+
+    Serial.println("TWAI CAN initialized (1Mbps)");
+    return true;
+  }
+
+  void stop() override {
+    twai_stop();
+    twai_driver_uninstall();
+  }
+
+  bool send(const CanFrame& f, uint32_t timeoutMs) override {
+    twai_message_t msg = {};
+    msg.identifier       = f.id & 0x1FFFFFFF;
+    msg.extd             = (f.flags & CAN_FRAME_EXTD) ? 1 : 0;
+    msg.rtr              = (f.flags & CAN_FRAME_RTR) ? 1 : 0;
+    msg.data_length_code = f.dlc;
+    memcpy(msg.data, f.data, f.dlc);
+    return twai_transmit(&msg, pdMS_TO_TICKS(timeoutMs)) == ESP_OK;
+  }
+
+  uint32_t wait(uint32_t timeoutMs) override {
+    uint32_t alerts;
+    if (twai_read_alerts(&alerts, pdMS_TO_TICKS(timeoutMs)) != ESP_OK) return 0;
+
+    uint32_t ev = 0;
+    if (alerts & TWAI_ALERT_RX_DATA) ev |= CAN_EV_RX;
+    // The driver queue still holds valid frames after an overrun
+    if (alerts & (TWAI_ALERT_RX_QUEUE_FULL | TWAI_ALERT_RX_FIFO_OVERRUN)) ev |= CAN_EV_RX | CAN_EV_RX_OVERRUN;
+    if (alerts & TWAI_ALERT_BUS_ERROR)     ev |= CAN_EV_BUS_ERROR;
+    if (alerts & TWAI_ALERT_ERR_PASS)      ev |= CAN_EV_ERR_PASSIVE;
+    if (alerts & TWAI_ALERT_TX_FAILED)     ev |= CAN_EV_TX_FAILED;
+    if (alerts & TWAI_ALERT_BUS_OFF)       ev |= CAN_EV_BUS_OFF;
+    if (alerts & TWAI_ALERT_BUS_RECOVERED) ev |= CAN_EV_RECOVERED;
+    if (alerts & TWAI_ALERT_ARB_LOST)      ev |= CAN_EV_ARB_LOST;
+    return ev;
+  }
+
+  bool receive(CanFrame& f) override {
+    twai_message_t msg;
+    if (twai_receive(&msg, 0) != ESP_OK) return false;
+    f.id    = msg.identifier;
+    f.dlc   = msg.data_length_code > 8 ? 8 : msg.data_length_code;
+    f.flags = (msg.extd ? CAN_FRAME_EXTD : 0) | (msg.rtr ? CAN_FRAME_RTR : 0);
+    memcpy(f.data, msg.data, 8);
+    return true;
+  }
+
+  void recover() override {
+    twai_initiate_recovery();
+  }
+
+  void restart() override {
+    esp_err_t err = twai_start();
+    Serial.printf("TWAI bus recovered; restart %s\n", esp_err_to_name(err));
+  }
+
+  void status(CanTransportStatus& out) override {
+    twai_status_info_t st;
+    memset(&out, 0, sizeof(out));
+    if (twai_get_status_info(&st) != ESP_OK) return;
+    out.rxMissed  = st.rx_missed_count;
+    out.rxOverrun = st.rx_overrun_count;
+    out.state     = (uint8_t)st.state;
+  }
+};
+
+CanTransport& canTwaiTransport() {
+  static TwaiTransport t;
+  return t;
+}
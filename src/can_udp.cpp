@@ -0,0 +1,92 @@
+#ifndef ARDUINO
+#include "can_udp.h"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+struct UdpFrame {
+  uint8_t id[4];      // little-endian
+  uint8_t dlc;
+  uint8_t flags;
+  uint8_t rsv[2];
+  uint8_t data[8];
+};
+static_assert(sizeof(UdpFrame) == 16, "UdpFrame must stay 16 bytes");
+
+static sockaddr_in loopbackAddr(uint16_t port) {
+  sockaddr_in a = {};
+  a.sin_family      = AF_INET;
+  a.sin_port        = htons(port);
+  a.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  return a;
+}
+
+bool CanUdpTransport::start(const CanFilter& filter) {
+  stop();
+  filter_ = filter;
+  fd_ = socket(AF_INET, SOCK_DGRAM, 0);
+  if (fd_ < 0) return false;
+
+  // Room for a burst of a few thousand frames while the RX task is busy
+  int rcvbuf = 1 << 20;
+  setsockopt(fd_, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+
+  sockaddr_in local = loopbackAddr(localPort_);
+  if (bind(fd_, (const sockaddr*)&local, sizeof(local)) != 0) {
+    Serial.printf("CAN udp: bind %u failed\n", localPort_);
+    stop();
+    return false;
+  }
+  return true;
+}
+
+void CanUdpTransport::stop() {
+  if (fd_ >= 0) close(fd_);
+  fd_ = -1;
+}
+
+bool CanUdpTransport::send(const CanFrame& f, uint32_t timeoutMs) {
+  if (fd_ < 0) return false;
+  UdpFrame u = {};
+  const uint32_t id = f.id & 0x1FFFFFFF;
+  for (int i = 0; i < 4; i++) u.id[i] = (uint8_t)(id >> (8 * i));
+  u.dlc   = f.dlc > 8 ? 8 : f.dlc;
+  u.flags = f.flags;
+  memcpy(u.data, f.data, u.dlc);
+
+  pollfd p = { fd_, POLLOUT, 0 };
+  if (poll(&p, 1, (int)timeoutMs) <= 0) return false;
+  const sockaddr_in peer = loopbackAddr(peerPort_);
+  return sendto(fd_, &u, sizeof(u), 0, (const sockaddr*)&peer, sizeof(peer)) == (ssize_t)sizeof(u);
+}
+
+uint32_t CanUdpTransport::wait(uint32_t timeoutMs) {
+  if (fd_ < 0) return 0;
+  pollfd p = { fd_, POLLIN, 0 };
+  if (poll(&p, 1, (int)timeoutMs) <= 0) return 0;
+  return (p.revents & POLLIN) ? CAN_EV_RX : CAN_EV_BUS_ERROR;
+}
+
+bool CanUdpTransport::receive(CanFrame& f) {
+  if (fd_ < 0) return false;
+  UdpFrame u;
+  for (;;) {
+    if (recv(fd_, &u, sizeof(u), MSG_DONTWAIT) != (ssize_t)sizeof(u)) return false;
+    f.id = (uint32_t)u.id[0] | (uint32_t)u.id[1] << 8 | (uint32_t)u.id[2] << 16 | (uint32_t)u.id[3] << 24;
+    if (!canFilterMatch(filter_, f.id)) continue;
+    f.dlc   = u.dlc > 8 ? 8 : u.dlc;
+    f.flags = u.flags;
+    memcpy(f.data, u.data, 8);
+    return true;
+  }
+}
+
+void CanUdpTransport::status(CanTransportStatus& out) {
+  out.rxMissed  = 0;
+  out.rxOverrun = 0;
+  out.state     = fd_ >= 0 ? 1 : 0;
+}
+#endif
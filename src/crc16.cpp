@@ -0,0 +1,97 @@
+#include "crc16.h"
+
+#if CRC16_SLICE != 1 && CRC16_SLICE != 4 && CRC16_SLICE != 8
+#error "CRC16_SLICE must be 1, 4 or 8"
+#endif
+
+// Base table (one byte per step)
+static const uint16_t kCrc16Table[256] PROGMEM = {
+  0, 49345, 49537, 320, 49921, 960, 640, 49729,
+  50689, 1728, 1920, 51009, 1280, 50625, 50305, 1088,
+  52225, 3264, 3456, 52545, 3840, 53185, 52865, 3648,
+  2560, 51905, 52097, 2880, 51457, 2496, 2176, 51265,
+  55297, 6336, 6528, 55617, 6912, 56257, 55937, 6720,
+  7680, 57025, 57217, 8000, 56577, 7616, 7296, 56385,
+  5120, 54465, 54657, 5440, 55041, 6080, 5760, 54849,
+  53761, 4800, 4992, 54081, 4352, 53697, 53377, 4160,
+  61441, 12480, 12672, 61761, 13056, 62401, 62081, 12864,
+  13824, 63169, 63361, 14144, 62721, 13760, 13440, 62529,
+  15360, 64705, 64897, 15680, 65281, 16320, 16000, 65089,
+  64001, 15040, 15232, 64321, 14592, 63937, 63617, 14400,
+  10240, 59585, 59777, 10560, 60161, 11200, 10880, 59969,
+  60929, 11968, 12160, 61249, 11520, 60865, 60545, 11328,
+  58369, 9408, 9600, 58689, 9984, 59329, 59009, 9792,
+  8704, 58049, 58241, 9024, 57601, 8640, 8320, 57409,
+  40961, 24768, 24960, 41281, 25344, 41921, 41601, 25152,
+  26112, 42689, 42881, 26432, 42241, 26048, 25728, 42049,
+  27648, 44225, 44417, 27968, 44801, 28608, 28288, 44609,
+  43521, 27328, 27520, 43841, 26880, 43457, 43137, 26688,
+  30720, 47297, 47489, 31040, 47873, 31680, 31360, 47681,
+  48641, 32448, 32640, 48961, 32000, 48577, 48257, 31808,
+  46081, 29888, 30080, 46401, 30464, 47041, 46721, 30272,
+  29184, 45761, 45953, 29504, 45313, 29120, 28800, 45121,
+  20480, 37057, 37249, 20800, 37633, 21440, 21120, 37441,
+  38401, 22208, 22400, 38721, 21760, 38337, 38017, 21568,
+  39937, 23744, 23936, 40257, 24320, 40897, 40577, 24128,
+  23040, 39617, 39809, 23360, 39169, 22976, 22656, 38977,
+  34817, 18624, 18816, 35137, 19200, 35777, 35457, 19008,
+  19968, 36545, 36737, 20288, 36097, 19904, 19584, 35905,
+  17408, 33985, 34177, 17728, 34561, 18368, 18048, 34369,
+  33281, 17088, 17280, 33601, 16640, 33217, 32897, 16448};
+
+#if CRC16_SLICE > 1
+// Slice tables: T[k][b] = CRC contribution of byte b followed by k zero bytes
+struct Crc16Slices { uint16_t t[CRC16_SLICE][256]; };
+
+static Crc16Slices buildSlices() {
+  Crc16Slices s;
+  for (int b = 0; b < 256; b++) s.t[0][b] = pgm_read_word_near(kCrc16Table + b);
+  for (int k = 1; k < CRC16_SLICE; k++) {
+    for (int b = 0; b < 256; b++) {
+      uint16_t v = s.t[k - 1][b];
+      s.t[k][b] = (v >> 8) ^ s.t[0][v & 0xFF];
+    }
+  }
+  return s;
+}
+
+// Built on first use (thread-safe static init); lives in RAM for fast lookups
+static const Crc16Slices& slices() {
+  static const Crc16Slices s = buildSlices();
+  return s;
+}
+#endif
+
+static inline uint16_t crc16_step(uint16_t crc, uint8_t b) {
+  return pgm_read_word_near(kCrc16Table + ((crc ^ b) & 0xFF)) ^ (crc >> 8);
+}
+
+static inline uint16_t crc16_fold(uint16_t crc, const uint8_t* d, size_t len, uint8_t key) {
+#if CRC16_SLICE > 1
+  const Crc16Slices& s = slices();
+  while (len >= CRC16_SLICE) {
+    uint16_t x = crc ^ (uint16_t)((d[0] ^ key) | ((d[1] ^ key) << 8));
+#if CRC16_SLICE == 8
+    crc = s.t[7][x & 0xFF] ^ s.t[6][x >> 8] ^
+          s.t[5][d[2] ^ key] ^ s.t[4][d[3] ^ key] ^
+          s.t[3][d[4] ^ key] ^ s.t[2][d[5] ^ key] ^
+          s.t[1][d[6] ^ key] ^ s.t[0][d[7] ^ key];
+#else
+    crc = s.t[3][x & 0xFF] ^ s.t[2][x >> 8] ^
+          s.t[1][d[2] ^ key] ^ s.t[0][d[3] ^ key];
+#endif
+    d   += CRC16_SLICE;
+    len -= CRC16_SLICE;
+  }
+#endif
+  while (len--) crc = crc16_step(crc, *d++ ^ key);
+  return crc;
+}
+
+uint16_t crc16_update(uint16_t crc, const uint8_t* data, size_t len) {
+  return crc16_fold(crc, data, len, 0x00);
+}
+
+uint16_t crc16_update_xor(uint16_t crc, const uint8_t* data, size_t len, uint8_t key) {
+  return crc16_fold(crc, data, len, key);
+}
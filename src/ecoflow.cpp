@@ -2,7 +2,15 @@
 #include "web.h"
 #include "ecoflow.h"
 #include "can.h"   // must provide sendCANFrame()
+#include "bms_params.h"
+#include "bms_snapshot.h"
+#include "crc16.h"
+#include "reassembler.h"
+#include "lat_hist.h"
+#include "tx_seq.h"
 #include <string.h>
+#include <atomic>
+#include <esp_timer.h>
 
 //EcoFlow PowerStream serial (from C4), 16 chars + null
 static char SerialPS[17] = {0};
@@ -15,10 +23,6 @@ extern volatile uint32_t can_rx_count;
 extern volatile uint32_t can_rx_dropped;
 extern volatile uint32_t can_decoded;
 
-extern float inputWatt;
-extern float outputWatt;
-extern String canLog;
-
 
 // ================= XOR state =================
 uint8_t xor3C; // Save C4 XOR
@@ -44,7 +48,20 @@ enum TxAction : uint8_t {
   A_CB_150,
 };
 
-// One cycle step: each action and the gap in ms
+static const uint8_t kActionCount = A_CB_150 + 1;
+static const char* const kActionNames[kActionCount] = {
+  "70",
+  "0B_04", "0B_02", "0B_05", "0B_50", "0B_08",
+  "4F",
+  "68",
+  "13",
+  "CB_321", "CB_141",
+  "5C",
+  "CB_150",
+};
+
+// One cycle step: each action and the gap in ms. kSeq is the built-in table;
+// /txseq.json on SPIFFS replaces it at runtime (see tx_seq.h).
 struct Step { TxAction act; uint16_t gap_ms; };
 
 static const Step kSeq[] = {
@@ -73,15 +90,48 @@ static const Step kSeq[] = {
   {A_0B_08,200},
 };
 static const uint8_t kSeqCount = sizeof(kSeq)/sizeof(kSeq[0]);
-
-// Runtime state
-static bool     g_seqRunning = false;
-static uint8_t  g_seqIndex   = 0;
-static uint32_t g_nextDueMs  = 0;
-static uint32_t g_lastC4ms   = 0;
+static_assert(kSeqCount <= TXSEQ_MAX_STEPS, "built-in sequence exceeds TXSEQ_MAX_STEPS");
+
+// Active step table. canSeqTask only reads seqTab[seqActive]; a load writes
+// the other table under seqTabMux and marks it pending, and the task adopts
+// it when the cycle wraps back to step 0 (or while idle).
+static TxSeqStep      seqTab[2][TXSEQ_MAX_STEPS];
+static uint8_t        seqTabCount[2]    = {0, 0};
+static bool           seqTabFromFile[2] = {false, false};
+static uint8_t        seqActive         = 0;
+static volatile int8_t seqPending       = -1;
+static String         seqLoadError;
+static portMUX_TYPE   seqTabMux = portMUX_INITIALIZER_UNLOCKED;
+
+// Runtime state (owned by canSeqTask; the decoder only touches g_lastC4ms / g_seqStartReq)
+static bool          g_seqRunning  = false;
+static uint8_t       g_seqIndex    = 0;
+static int64_t       g_nextDueUs   = 0;
+static volatile uint32_t g_lastC4ms   = 0;
+static volatile bool     g_seqStartReq = false;
+
+static TaskHandle_t       seqTaskHandle = nullptr;
+static esp_timer_handle_t seqTimer      = nullptr;
+
+// Step timing: lateness vs. plan and time spent in sendAction (prepare + submit)
+#ifndef SEQ_RESYNC_US
+#define SEQ_RESYNC_US 50000     // further behind than this: restart the schedule from now
+#endif
+struct SeqTiming {
+  LatHist  late;
+  LatHist  dur;
+  uint32_t frames;
+  void reset() { late.reset(); dur.reset(); frames = 0; }
+};
+static SeqTiming     seqAll;
+static SeqTiming     seqPerStep[TXSEQ_MAX_STEPS];
+static SeqTiming     seqPerAction[kActionCount];
+static uint32_t      seqResyncs = 0;
+static volatile bool seqStatsResetReq = true;   // also initialises min fields
 
 // Forward
-static void sendAction(TxAction a);
+static uint8_t sendAction(TxAction a);
+static void send3CFast(uint32_t rxUs);
 
 // ================= Headers =================
 uint8_t header_3C[] = {
@@ -431,72 +481,51 @@ uint8_t payload_24[] = { //Version Date
 // ================= Prepare functions =================
 
 
-void prepareMessage13(uint8_t *message) {
-  message[7] = config.temp;
-  message[12] = config.volt& 0xFF;
-  message[13] = (config.volt>> 8) & 0xFF;
-  message[20] = config.temp;
-  
-  message[43] = config.temp;
-  message[44] = config.temp;
-  message[45] = config.temp;
-  message[46] = config.temp;
-
-uint8_t cell_offset = 77;
-uint16_t minCellMv = 65535; // Start with highest possible
-uint16_t maxCellMv = 0;     // Start with lowest possible
-
-for (uint8_t i = 0; i < 16; i++) {
-    float cellVoltage = bms.get_cell_voltage(i);
-    uint16_t cell_mv = (uint16_t)(cellVoltage * 1000.0f); // Convert V to mV
-
-    // Store in message buffer
-    message[cell_offset + i * 2]     = cell_mv & 0xFF;
-    message[cell_offset + i * 2 + 1] = (cell_mv >> 8) & 0xFF;
-
-    // Track min and max
-    if (cell_mv < minCellMv) minCellMv = cell_mv;
-    if (cell_mv > maxCellMv) maxCellMv = cell_mv;
-}
-
-// Store Max Cell Voltage (message[39-40])
-message[39] = maxCellMv & 0xFF;
-message[40] = (maxCellMv >> 8) & 0xFF;
-
-// Store Min Cell Voltage (message[41-42])
-message[41] = minCellMv & 0xFF;
-message[42] = (minCellMv >> 8) & 0xFF;
+// All live battery values come from one snapshot copy per message
+static void putLE16(uint8_t* p, uint16_t v) { p[0] = v & 0xFF; p[1] = (v >> 8) & 0xFF; }
+static void putLE32(uint8_t* p, uint32_t v) { putLE16(p, (uint16_t)v); putLE16(p + 2, (uint16_t)(v >> 16)); }
 
-int16_t outputWattInt = (int16_t)outputWatt;  // Convert float to int16_t
-int16_t inputWattInt = (int16_t)inputWatt;  // Convert float to int16_t
-  message[57] = inputWattInt & 0xFF;
-  message[58] = (inputWattInt >> 8) & 0xFF;
-  message[61] = outputWattInt & 0xFF;
-  message[62] = (outputWattInt >> 8) & 0xFF;
+void prepareMessage13(uint8_t *message) {
+  BmsSnapshot b;
+  bmsSnapshotGet(b);
+
+  message[7] = b.temp;
+  putLE16(&message[12], b.packMv);
+  message[20] = b.temp;
+
+  message[43] = b.temp;
+  message[44] = b.temp;
+  message[45] = b.temp;
+  message[46] = b.temp;
+
+  // Cell voltages (77..108), max (39-40), min (41-42)
+  const uint8_t cell_offset = 77;
+  for (uint8_t i = 0; i < BMS_SNAP_CELLS; i++)
+    putLE16(&message[cell_offset + i * 2], b.cellMv[i]);
+  putLE16(&message[39], b.maxCellMv);
+  putLE16(&message[41], b.minCellMv);
+
+  putLE16(&message[57], (uint16_t)(int16_t)b.inputW);
+  putLE16(&message[61], (uint16_t)(int16_t)b.outputW);
   memcpy(&message[122], config.serialStr, 16);
-  message[148] = (bms.get_0x12_full_charge_voltage()) & 0xFF;
-  message[149] = ((bms.get_0x12_full_charge_voltage()) >> 8) & 0xFF;
-
+  // Cached EEPROM value; never a factory-mode read on the TX path
+  if (bmsParamsValid) {
+    putLE16(&message[148], bmsParams.fullChargeMv);
+  }
 }
 
 void prepareMessage3C(uint8_t *message) {
+  BmsSnapshot b;
+  bmsSnapshotGet(b);
+
   memcpy(&message[3], config.serialStr, 16);
-  message[41] = (config.chgvolt + 3) & 0xFF;
-  message[42] = ((config.chgvolt + 3) >> 8) & 0xFF;
-  message[56] = config.soc;
-  message[57] = (config.volt) & 0xFF;
-  message[58] = ((config.volt) >> 8) & 0xFF;
-  message[114] = message[115] = config.temp;
-
-  message[120] = config.chgruntime & 0xFF;
-  message[121] = (config.chgruntime >> 8) & 0xFF;
-  message[122] = (config.chgruntime >> 16) & 0xFF;
-  message[123] = (config.chgruntime >> 24) & 0xFF;
-
-  message[124] = config.disruntime & 0xFF;
-  message[125] = (config.disruntime >> 8) & 0xFF;
-  message[126] = (config.disruntime >> 16) & 0xFF;
-  message[127] = (config.disruntime >> 24) & 0xFF;
+  putLE16(&message[41], config.chgvolt + 3);
+  message[56] = b.soc;
+  putLE16(&message[57], b.packMv);
+  message[114] = message[115] = b.temp;
+
+  putLE32(&message[120], b.chgRuntimeMin);
+  putLE32(&message[124], b.disRuntimeMin);
 
   message[128] = config.bmsChgUp;
   message[129] = config.bmsChgDn;
@@ -507,11 +536,11 @@ void prepareMessageEB(uint8_t *message) {
 }
 
 void prepareMessage0B(uint8_t *message) {
-  message[1] = (config.volt + 1000) & 0xFF;         // Consistently +1000mV Battery Voltage
-  message[2] = ((config.volt + 1000) >> 8) & 0xFF;
+  BmsSnapshot b;
+  bmsSnapshotGet(b);
 
-  message[9] = (config.volt - 1896) & 0xFF;         //Roughly - 1896, Maybe BMS release or trigger voltage?
-  message[10] = ((config.volt - 1896) >> 8) & 0xFF; //
+  putLE16(&message[1], b.packMv + 1000);            // Consistently +1000mV Battery Voltage
+  putLE16(&message[9], b.packMv - 1896);            // Roughly - 1896, Maybe BMS release or trigger voltage?
 }
 
 void prepareMessageCB(uint8_t *message) {
@@ -523,78 +552,46 @@ void prepareMessage70(uint8_t *message) {
 }
 
 void prepareMessage5C(uint8_t *message) {
-  message[2] = (config.volt) & 0xFF;
-  message[3] = ((config.volt) >> 8) & 0xFF;
+  BmsSnapshot b;
+  bmsSnapshotGet(b);
+
+  putLE16(&message[2], b.packMv);
   message[4] = 0x00;
 }
 
 void prepareMessage68(uint8_t *message) {
-  int16_t outputWattInt = (int16_t)outputWatt;  // Convert float to int16_t
-  int16_t inputWattInt = (int16_t)inputWatt;  // Convert float to int16_t
+  BmsSnapshot b;
+  bmsSnapshotGet(b);
+
   memcpy(&message[0], config.serialStr, 16);
-  message[37] = config.soc;
-  message[38] = (config.volt) & 0xFF;
-  message[39] = ((config.volt) >> 8) & 0xFF;
-  message[46] = config.temp;
-  if(inputWattInt > 0) message[47] = 0x02; else message[47] = 0x00;
-  int16_t balanceCapInt = (int16_t)bms.get_balance_capacity();  // Convert float to int16_t
-  message[57] = (balanceCapInt * 1000) & 0xFF;
-  message[58] = ((balanceCapInt * 1000) >> 8) & 0xFF;
-
-//uint8_t cell_offset = 77;
-uint16_t minCellMv = 65535; // Start with highest possible
-uint16_t maxCellMv = 0;     // Start with lowest possible
-
-for (uint8_t i = 0; i < 16; i++) {
-    float cellVoltage = bms.get_cell_voltage(i);
-    uint16_t cell_mv = (uint16_t)(cellVoltage * 1000.0f); // Convert V to mV
-
-    // Store in message buffer
-  //  message[cell_offset + i * 2]     = cell_mv & 0xFF;
-  //  message[cell_offset + i * 2 + 1] = (cell_mv >> 8) & 0xFF;
-
-    // Track min and max
-    if (cell_mv < minCellMv) minCellMv = cell_mv;
-    if (cell_mv > maxCellMv) maxCellMv = cell_mv;
-}
-message[65] = maxCellMv & 0xFF;
-message[66] = (maxCellMv >> 8) & 0xFF;
-message[69] = minCellMv & 0xFF;
-message[70] = (minCellMv >> 8) & 0xFF;
+  message[37] = b.soc;
+  putLE16(&message[38], b.packMv);
+  message[46] = b.temp;
+  message[47] = ((int16_t)b.inputW > 0) ? 0x02 : 0x00;
+  int16_t balanceCapInt = (int16_t)(b.balanceMah / 1000);   // whole Ah, as before
+  putLE16(&message[57], (uint16_t)(balanceCapInt * 1000));
 
+  putLE16(&message[65], b.maxCellMv);
+  putLE16(&message[69], b.minCellMv);
 
-  message[78] = inputWattInt & 0xFF;
-  message[79] = (inputWattInt >> 8) & 0xFF;
-  message[82] = outputWattInt & 0xFF;
-  message[83] = (outputWattInt >> 8) & 0xFF;
+  putLE16(&message[78], (uint16_t)(int16_t)b.inputW);
+  putLE16(&message[82], (uint16_t)(int16_t)b.outputW);
 
-  message[86] = config.disruntime & 0xFF;
-  message[87] = (config.disruntime >> 8) & 0xFF;
-  message[88] = (config.disruntime >> 16) & 0xFF;
-  message[89] = (config.disruntime >> 24) & 0xFF;
+  putLE32(&message[86], b.disRuntimeMin);
 
   message[91] = config.bmsChgUp;
   message[92] = config.bmsChgDn;
 }
 
 void prepareMessage4F(uint8_t *message) {
-int32_t outputWattInt = (int32_t)outputWatt;
-int32_t inputWattInt  = (int32_t)inputWatt;
-  // Convert float to int16_t
-  message[0] = config.soc;
-  if(inputWattInt > 0) message[1] = 0x02; else message[1] = 0x00;
-  message[2] = inputWattInt & 0xFF;
-  message[3] = (inputWattInt >> 8) & 0xFF;
-  message[4] = (inputWattInt >> 16) & 0xFF;
-  message[5] = (inputWattInt >> 24) & 0xFF;
-  message[6] = outputWattInt & 0xFF;
-  message[7] = (outputWattInt >> 8) & 0xFF;
-  message[8] = (outputWattInt >> 16) & 0xFF;
-  message[9] = (outputWattInt >> 24) & 0xFF;
-  message[10] = config.chgruntime & 0xFF;
-  message[11] = (config.chgruntime >> 8) & 0xFF;
-  message[12] = (config.chgruntime >> 16) & 0xFF;
-  message[13] = (config.chgruntime >> 24) & 0xFF;
+  BmsSnapshot b;
+  bmsSnapshotGet(b);
+
+  message[0] = b.soc;
+  message[1] = (b.inputW > 0) ? 0x02 : 0x00;
+  putLE32(&message[2], (uint32_t)b.inputW);
+  putLE32(&message[6], (uint32_t)b.outputW);
+  putLE32(&message[10], b.chgRuntimeMin);
   message[15] = config.bmsChgUp;
   message[16] = config.bmsChgDn;
 }
@@ -607,84 +604,332 @@ void prepareMessage24(uint8_t *message) {
   memcpy(&message[8], config.serialStr, 16);
 }
 
+// ================= TX key selection =================
+// Replies echo the key of the message they answer; everything else rolls xorCounter
+static uint8_t txKeyFor(uint8_t msg_type, uint16_t trackerBE) {
+  if (msg_type == 0x3C) return xor3C;
+  if (msg_type == 0x8C) return xor8C;
+  if (msg_type == 0x24) return xor24;
+  if (msg_type == 0xCB && (trackerBE == 0x2031 || trackerBE == 0x2033)) return xorCB;
+  return xorCounter++;
+}
+
+// ================= TX frame templates =================
+// Messages whose payload is static apart from a few fields are cached as their
+// final wire bytes (header, encoded payload, CRC) in frame order. prepareMessageXX
+// writes only the declared fields, so on send just those bytes are compared and
+// patched; the key-0 CRC is recomputed only after one of them changed.
+// CRC-16/ARC is linear (init 0), so the CRC for the actual key is that base CRC
+// xor'd with the precomputed terms of its two key nibbles. Messages that
+// rewrite most of their payload (4F, 68, 13) stay on prepare + sendCANMessage.
+// A template is only ever sent from one task.
+struct TxField { uint8_t off, len; };
+
+struct TxTemplate {
+  const uint8_t* header;     // header_XX (byte 6 is replaced by the key)
+  uint8_t        hdrSize;
+  const uint8_t* payload;    // payload_XX, untouched template bytes
+  uint16_t       plSize;
+  void         (*prepare)(uint8_t*);   // nullptr: payload is static
+  const TxField* fields;     // every byte prepare writes
+  uint8_t        nFields;
+  uint8_t*       img;        // prepared, unencoded payload (nullptr if static)
+  uint8_t*       wire;       // hdrSize + plSize + 2
+  uint16_t       crcBase;    // CRC with key 0
+  uint16_t       keyLo[16];  // CRC term of key & 0x0F, key 0 elsewhere
+  uint16_t       keyHi[16];  // same for key & 0xF0
+  uint8_t        wireKey;
+  bool           ready;
+};
+
+#define TX_TEMPLATE_STATIC(var, hdr, pl)                                  \
+  static uint8_t var##_wire[sizeof(hdr) + sizeof(pl) + 2];                \
+  static TxTemplate var = { hdr, (uint8_t)sizeof(hdr), pl, (uint16_t)sizeof(pl), nullptr, \
+                            nullptr, 0, nullptr, var##_wire, 0, {0}, {0}, 0, false }
+
+// Payloads with fields are prepared into a stack buffer of this size
+#define TX_TEMPLATE_FIELD_MAX 64
+
+#define TX_TEMPLATE(var, hdr, pl, prep, flds)                             \
+  static_assert(sizeof(pl) <= TX_TEMPLATE_FIELD_MAX, #pl " too large for a field template"); \
+  static uint8_t var##_img[sizeof(pl)];                                   \
+  static uint8_t var##_wire[sizeof(hdr) + sizeof(pl) + 2];                \
+  static TxTemplate var = { hdr, (uint8_t)sizeof(hdr), pl, (uint16_t)sizeof(pl), prep, \
+                            flds, (uint8_t)(sizeof(flds) / sizeof(flds[0])), \
+                            var##_img, var##_wire, 0, {0}, {0}, 0, false }
+
+// Fields written by the prepare functions below
+static const TxField kFields70[] = { {1, 16} };            // serial
+static const TxField kFields0B[] = { {1, 2}, {9, 2} };     // pack mV derived
+static const TxField kFields5C[] = { {2, 3} };             // pack mV, [4] = 0
+static const TxField kFields24[] = { {8, 16} };            // serial
+
+TX_TEMPLATE(tpl70,      header_70,      payload_70, prepareMessage70, kFields70);
+TX_TEMPLATE(tpl0B_04,   header_0B_04,   payload_0B, prepareMessage0B, kFields0B);
+TX_TEMPLATE(tpl0B_02,   header_0B_02,   payload_0B, prepareMessage0B, kFields0B);
+TX_TEMPLATE(tpl0B_05,   header_0B_05,   payload_0B, prepareMessage0B, kFields0B);
+TX_TEMPLATE(tpl0B_50,   header_0B_50,   payload_0B, prepareMessage0B, kFields0B);
+TX_TEMPLATE(tpl0B_08,   header_0B_08,   payload_0B, prepareMessage0B, kFields0B);
+TX_TEMPLATE(tpl5C,      header_5C,      payload_5C, prepareMessage5C, kFields5C);
+TX_TEMPLATE(tpl24,      header_24,      payload_24, prepareMessage24, kFields24);
+TX_TEMPLATE_STATIC(tplCB_321,  header_CB_321,  payload_CB);
+TX_TEMPLATE_STATIC(tplCB_141,  header_CB_141,  payload_CB);
+TX_TEMPLATE_STATIC(tplCB_150,  header_CB_150,  payload_CB);
+TX_TEMPLATE_STATIC(tplCB_2031, header_CB_2031, payload_CB);
+TX_TEMPLATE_STATIC(tplCB_2033, header_CB_2033, payload_CB);
+TX_TEMPLATE_STATIC(tpl8C,      header_8C,      payload_8C);
+
+static void tplInit(TxTemplate& t) {
+  memcpy(t.wire, t.header, t.hdrSize);
+  t.wire[6] = 0;
+  uint8_t* enc = t.wire + t.hdrSize;
+  memcpy(enc, t.payload, t.plSize);
+  if (t.prepare) {
+    t.prepare(enc);
+    memcpy(t.img, enc, t.plSize);
+  }
+  t.wireKey = 0;
+  t.crcBase = crc16_update(crc16_init(), t.wire, t.hdrSize + t.plSize);
+
+  // Term of key k: CRC of the message with every byte 0 except header[6]
+  // and the payload, which are k. Linear in k, so two nibble tables cover it.
+  uint16_t bit[8];
+  for (uint8_t b = 0; b < 8; b++) {
+    const uint8_t k = (uint8_t)(1u << b);
+    uint16_t crc = crc16_init();
+    for (uint8_t i = 0; i < t.hdrSize; i++) {
+      uint8_t v = (i == 6) ? k : 0;
+      crc = crc16_update(crc, &v, 1);
+    }
+    for (uint16_t i = 0; i < t.plSize; i++) crc = crc16_update(crc, &k, 1);
+    bit[b] = crc;
+  }
+  for (uint8_t n = 0; n < 16; n++) {
+    t.keyLo[n] = t.keyHi[n] = 0;
+    for (uint8_t b = 0; b < 4; b++) {
+      if (n & (1u << b)) { t.keyLo[n] ^= bit[b]; t.keyHi[n] ^= bit[b + 4]; }
+    }
+  }
+  t.ready = true;
+}
+
+static inline uint16_t tplKeyCrc(const TxTemplate& t, uint8_t key) {
+  return t.keyLo[key & 0x0F] ^ t.keyHi[key >> 4];
+}
+
+// Returns the number of CAN frames queued (0 if the TX queue was full)
+static uint8_t sendTemplate(TxTemplate& t, CanTxPrio prio = CAN_TX_NORMAL) {
+  if (!t.ready) tplInit(t);
+  uint8_t* enc = t.wire + t.hdrSize;
+
+  if (t.prepare) {
+    // prepare writes only the declared fields, so the rest of fresh is never read
+    uint8_t fresh[TX_TEMPLATE_FIELD_MAX];
+    t.prepare(fresh);
+
+    bool dirty = false;
+    for (uint8_t f = 0; f < t.nFields; f++) {
+      const uint8_t off = t.fields[f].off, len = t.fields[f].len;
+      if (memcmp(fresh + off, t.img + off, len) == 0) continue;   // usually unchanged
+      for (uint8_t i = off; i < off + len; i++) {
+        t.img[i] = fresh[i];
+        enc[i]   = fresh[i] ^ t.wireKey;
+      }
+      dirty = true;
+    }
+    // Rare (pack voltage or serial changed): full CRC of the current wire, back to key 0
+    if (dirty)
+      t.crcBase = crc16_update(crc16_init(), t.wire, t.hdrSize + t.plSize) ^ tplKeyCrc(t, t.wireKey);
+  }
+
+  // Apply the key: header byte, re-key the encoded payload, CRC via key terms
+  const uint16_t trackerBE = ((uint16_t)t.header[16] << 8) | t.header[17];
+  const uint8_t  key = txKeyFor(t.header[4], trackerBE);
+  if (key != t.wireKey) {
+    const uint8_t flip = key ^ t.wireKey;
+    for (uint16_t i = 0; i < t.plSize; i++) enc[i] ^= flip;
+    t.wireKey = key;
+  }
+  t.wire[6] = key;
+
+  const uint16_t crc  = t.crcBase ^ tplKeyCrc(t, key);
+  const size_t   body = (size_t)t.hdrSize + t.plSize;
+  t.wire[body]     = (uint8_t)(crc & 0xFF);
+  t.wire[body + 1] = (uint8_t)(crc >> 8);
+
+  // canTxTask copies the wire bytes, so the template is free again on return
+  const size_t total = body + 2;
+  if (!canSubmit(prio, MSG3001_FIRST_ID, MSG3001_MID_ID, MSG3001_END_ID, t.wire, total)) return 0;
+  return (uint8_t)((total + 7) / 8);
+}
+
 // ================= Wrapper functions =================
 
 void ecoflowSend3C() {
-  prepareMessage3C(payload_3C);
-  sendCANMessage(header_3C, payload_3C, sizeof(header_3C), sizeof(payload_3C));
+  send3CFast(0);
 }
 
 void ecoflowSend8C() {
-  prepareMessage8C(payload_8C);
-  sendCANMessage(header_8C, payload_8C, sizeof(header_8C), sizeof(payload_8C));
+  sendTemplate(tpl8C, CAN_TX_HIGH);
 }
 
 void ecoflowSend24() {
-  prepareMessage24(payload_24);
-  sendCANMessage(header_24, payload_24, sizeof(header_24), sizeof(payload_24));
+  sendTemplate(tpl24, CAN_TX_HIGH);
 }
 
 void ecoflowSendCB2031() {
-  prepareMessageCB(payload_CB);
-  sendCANMessage(header_CB_2031, payload_CB, sizeof(header_CB_2031), sizeof(payload_CB));
+  sendTemplate(tplCB_2031, CAN_TX_HIGH);
 }
 
 void ecoflowSendCB2033() {
-  prepareMessageCB(payload_CB);
-  sendCANMessage(header_CB_2033, payload_CB, sizeof(header_CB_2033), sizeof(payload_CB));
+  sendTemplate(tplCB_2033, CAN_TX_HIGH);
+}
+
+
+// ================= Heartbeat (3C) fast path =================
+// The 3C reply is kept pre-built (header + unencoded payload + CRC of the
+// key-0 message). CRC-16/ARC is linear with init 0, so the CRC for any XOR
+// key is the base CRC xor'd with one precomputed term per set key bit.
+// loop() rebuilds the image only when its contents change, into the
+// inactive one of two buffers, and publishes it with a release store of the
+// index. Each buffer also carries a sequence (odd while being written): the
+// decode task builds its reply from the active buffer, then checks that
+// sequence and starts over from the newly active buffer if a later refresh
+// rewrote it meanwhile. The reader never waits on the writer.
+struct Image3C {
+  uint8_t  hdr[sizeof(header_3C)];
+  uint8_t  pl[sizeof(payload_3C)];
+  uint16_t crcBase;
+};
+
+static Image3C               img3C[2];
+static std::atomic<uint32_t> img3CSeq[2];
+static std::atomic<uint8_t>  img3CActive{0};
+static std::atomic<bool>     img3CReady{false};
+static uint16_t              crc3CKeyBit[8];
+
+#ifndef IMG3C_REFRESH_MS
+#define IMG3C_REFRESH_MS 50
+#endif
+
+// C4 END frame -> first 3C frame handed to the driver
+const uint32_t ecoflowLatEdgesUs[ECOFLOW_LAT_BUCKETS - 1] = { 250, 500, 1000, 2000, 5000, 10000, 20000 };
+static uint32_t c4LatHist[ECOFLOW_LAT_BUCKETS];
+static uint32_t c4LatCount = 0, c4LatLastUs = 0, c4LatMaxUs = 0;
+static uint64_t c4LatSumUs = 0;
+
+static void c4LatRecord(uint32_t us) {
+  uint8_t b = 0;
+  while (b < ECOFLOW_LAT_BUCKETS - 1 && us >= ecoflowLatEdgesUs[b]) b++;
+  c4LatHist[b]++;
+  c4LatCount++;
+  c4LatLastUs = us;
+  c4LatSumUs += us;
+  if (us > c4LatMaxUs) c4LatMaxUs = us;
 }
 
+// canTxTask callback: first 3C frame is with the driver
+static void c4LatRecordSince(uint32_t rxUs) {
+  c4LatRecord(micros() - rxUs);
+}
+
+void ecoflowC4LatencyGet(EcoflowLatency& out) {
+  memcpy(out.hist, c4LatHist, sizeof(out.hist));
+  out.count  = c4LatCount;
+  out.lastUs = c4LatLastUs;
+  out.maxUs  = c4LatMaxUs;
+  out.avgUs  = c4LatCount ? (uint32_t)(c4LatSumUs / c4LatCount) : 0;
+}
 
-// ================= CRC helper =================
-
-uint16_t crc16(const uint8_t *data, uint16_t len) {
-  static const uint16_t table[] PROGMEM = {
-      0, 49345, 49537, 320, 49921, 960, 640, 49729,
-      50689, 1728, 1920, 51009, 1280, 50625, 50305, 1088,
-      52225, 3264, 3456, 52545, 3840, 53185, 52865, 3648,
-      2560, 51905, 52097, 2880, 51457, 2496, 2176, 51265,
-      55297, 6336, 6528, 55617, 6912, 56257, 55937, 6720,
-      7680, 57025, 57217, 8000, 56577, 7616, 7296, 56385,
-      5120, 54465, 54657, 5440, 55041, 6080, 5760, 54849,
-      53761, 4800, 4992, 54081, 4352, 53697, 53377, 4160,
-      61441, 12480, 12672, 61761, 13056, 62401, 62081, 12864,
-      13824, 63169, 63361, 14144, 62721, 13760, 13440, 62529,
-      15360, 64705, 64897, 15680, 65281, 16320, 16000, 65089,
-      64001, 15040, 15232, 64321, 14592, 63937, 63617, 14400,
-      10240, 59585, 59777, 10560, 60161, 11200, 10880, 59969,
-      60929, 11968, 12160, 61249, 11520, 60865, 60545, 11328,
-      58369, 9408, 9600, 58689, 9984, 59329, 59009, 9792,
-      8704, 58049, 58241, 9024, 57601, 8640, 8320, 57409,
-      40961, 24768, 24960, 41281, 25344, 41921, 41601, 25152,
-      26112, 42689, 42881, 26432, 42241, 26048, 25728, 42049,
-      27648, 44225, 44417, 27968, 44801, 28608, 28288, 44609,
-      43521, 27328, 27520, 43841, 26880, 43457, 43137, 26688,
-      30720, 47297, 47489, 31040, 47873, 31680, 31360, 47681,
-      48641, 32448, 32640, 48961, 32000, 48577, 48257, 31808,
-      46081, 29888, 30080, 46401, 30464, 47041, 46721, 30272,
-      29184, 45761, 45953, 29504, 45313, 29120, 28800, 45121,
-      20480, 37057, 37249, 20800, 37633, 21440, 21120, 37441,
-      38401, 22208, 22400, 38721, 21760, 38337, 38017, 21568,
-      39937, 23744, 23936, 40257, 24320, 40897, 40577, 24128,
-      23040, 39617, 39809, 23360, 39169, 22976, 22656, 38977,
-      34817, 18624, 18816, 35137, 19200, 35777, 35457, 19008,
-      19968, 36545, 36737, 20288, 36097, 19904, 19584, 35905,
-      17408, 33985, 34177, 17728, 34561, 18368, 18048, 34369,
-      33281, 17088, 17280, 33601, 16640, 33217, 32897, 16448};
-  uint16_t crc = 0;
-  for (uint16_t i = 0; i < len; i++) {
-    crc = pgm_read_word_near(table + ((crc ^ data[i]) & 0xFF)) ^ (crc >> 8);
+static void build3CKeyTerms() {
+  for (uint8_t b = 0; b < 8; b++) {
+    const uint8_t k = (uint8_t)(1u << b);
+    uint16_t crc = crc16_init();
+    for (size_t i = 0; i < sizeof(header_3C); i++) {
+      uint8_t v = (i == 6) ? k : 0;
+      crc = crc16_update(crc, &v, 1);
+    }
+    for (size_t i = 0; i < sizeof(payload_3C); i++) crc = crc16_update(crc, &k, 1);
+    crc3CKeyBit[b] = crc;
   }
-  return crc;
+}
+
+// Rebuild the 3C image if anything it carries changed; loop() context only
+static void refresh3CImage() {
+  const uint8_t cur = img3CActive.load(std::memory_order_relaxed);
+  Image3C fresh;
+  memcpy(fresh.hdr, header_3C, sizeof(fresh.hdr));
+  fresh.hdr[6] = 0;
+  memcpy(fresh.pl, payload_3C, sizeof(fresh.pl));
+  prepareMessage3C(fresh.pl);
+
+  const bool ready = img3CReady.load(std::memory_order_relaxed);
+  if (ready && memcmp(fresh.pl, img3C[cur].pl, sizeof(fresh.pl)) == 0) return;
+  fresh.crcBase = crc16_update(crc16_update(crc16_init(), fresh.hdr, sizeof(fresh.hdr)), fresh.pl, sizeof(fresh.pl));
+
+  // A reader may still be on the inactive buffer from before the last flip
+  const uint8_t next = cur ^ 1;
+  const uint32_t s = img3CSeq[next].load(std::memory_order_relaxed);
+  img3CSeq[next].store(s + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  memcpy(&img3C[next], &fresh, sizeof(fresh));
+  img3CSeq[next].store(s + 2, std::memory_order_release);
+
+  img3CActive.store(next, std::memory_order_release);
+  img3CReady.store(true, std::memory_order_release);
+}
+
+void ecoflow3CImageTick() {
+  static uint32_t last = 0, lastSeq = 0;
+  uint32_t now = millis();
+  uint32_t seq = bmsSnapshotSeq();
+  // New BMS data right away; the timer still covers config-only edits
+  if (img3CReady.load(std::memory_order_relaxed) && seq == lastSeq && now - last < IMG3C_REFRESH_MS) return;
+  last = now;
+  lastSeq = seq;
+  refresh3CImage();
+}
+
+// rxUs: micros() of the C4 END frame, 0 when not answering a heartbeat
+static void send3CFast(uint32_t rxUs) {
+  if (!img3CReady.load(std::memory_order_acquire)) return;
+  const uint8_t key = xor3C;
+
+  uint8_t wire[sizeof(Image3C::hdr) + sizeof(Image3C::pl) + 2];
+  const size_t hdrSize = sizeof(Image3C::hdr);
+  const size_t body    = hdrSize + sizeof(Image3C::pl);
+  for (;;) {
+    const uint8_t  idx = img3CActive.load(std::memory_order_acquire);
+    const uint32_t s1  = img3CSeq[idx].load(std::memory_order_acquire);
+    if (s1 & 1) continue;                 // rewritten since we loaded idx: take the new active one
+    const Image3C& im = img3C[idx];
+
+    uint16_t crc = im.crcBase;
+    for (uint8_t b = 0; b < 8; b++)
+      if (key & (1u << b)) crc ^= crc3CKeyBit[b];
+
+    memcpy(wire, im.hdr, hdrSize);
+    wire[6] = key;
+    for (size_t i = 0; i < sizeof(im.pl); i++) wire[hdrSize + i] = im.pl[i] ^ key;
+    wire[body]     = (uint8_t)(crc & 0xFF);
+    wire[body + 1] = (uint8_t)(crc >> 8);
+
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (img3CSeq[idx].load(std::memory_order_relaxed) == s1) break;
+  }
+
+  // Heartbeat replies jump the sequencer queue; latency is stamped by canTxTask
+  canSubmit(CAN_TX_HIGH, MSG3001_FIRST_ID, MSG3001_MID_ID, MSG3001_END_ID,
+            wire, sizeof(wire), 0, rxUs ? c4LatRecordSince : nullptr, rxUs);
 }
 
 // ================= sendCANMessage =================
-void sendCANMessage(uint8_t* header, uint8_t* payload, size_t headerSize, size_t payloadSize) {
+uint8_t sendCANMessage(uint8_t* header, uint8_t* payload, size_t headerSize, size_t payloadSize) {
 
   #define IDX_TRK0   16  // tracker = last 4 header bytes
   #define IDX_TRK1   17
 
-  if (!header || headerSize < 7) { Serial.println("sendCANMessage: bad header"); return; }
+  if (!header || headerSize < 7) { Serial.println("sendCANMessage: bad header"); return 0; }
 
   // Message type (5th byte) selects ID set and framing mode
   const uint8_t msg_type = header[4];
@@ -712,121 +957,41 @@ void sendCANMessage(uint8_t* header, uint8_t* payload, size_t headerSize, size_t
     id_last   = 0x10203001;
   }*else */
  
-   uint8_t xor_key;
+    id_first  = MSG3001_FIRST_ID;
+    id_middle = MSG3001_MID_ID;
+    id_last   = MSG3001_END_ID;
 
-    id_first  = 0x10003001;
-    id_middle = 0x10103001;
-    id_last   = 0x10203001;
-
-  if (msg_type == 0x3C) {
-    xor_key = xor3C;
-  } else if (msg_type == 0x8C) {
-    xor_key = xor8C;
-  } else if (msg_type == 0x24) {
-    xor_key = xor24;
-  } else if (msg_type == 0xCB) {
-    if (trackerBE == 0x2031 || trackerBE == 0x2033) {
-      xor_key = xorCB; 
-    } else xor_key = xorCounter++;
-  } else {
-      xor_key = xorCounter++;
-    }
+  uint8_t xor_key = txKeyFor(msg_type, trackerBE);
 
   // ALWAYS generate a new XOR key and write it into header[6]
   //uint8_t xor_key = (uint8_t)random(0, 256);
   header[6] = xor_key;
 
-  // Encode payload (safe if payload == nullptr)
-  uint8_t encoded[(payloadSize > 0) ? payloadSize : 1];
-  for (size_t i = 0; i < payloadSize; i++) {
-    uint8_t src = payload ? payload[i] : 0x00;
-    encoded[i] = src ^ xor_key;
+  // CRC (LE) over header + encoded payload, folded straight from the sources
+  uint16_t crc = crc16_update(crc16_init(), header, headerSize);
+  if (payload) {
+    crc = crc16_update_xor(crc, payload, payloadSize, xor_key);
+  } else {
+    for (size_t i = 0; i < payloadSize; i++) crc = crc16_update(crc, &xor_key, 1);
   }
 
-  // Build final message: header + encoded payload + CRC(LE, unencoded)
-  uint8_t crc_buf[headerSize + payloadSize];
-  memcpy(crc_buf, header, headerSize);
-  if (payloadSize) memcpy(crc_buf + headerSize, encoded, payloadSize);
-  uint16_t crc = crc16(crc_buf, headerSize + payloadSize);
-
-  uint8_t final_msg[headerSize + payloadSize + 2];
-  memcpy(final_msg, crc_buf, headerSize + payloadSize);
-  final_msg[headerSize + payloadSize]     = (uint8_t)(crc & 0xFF);
-  final_msg[headerSize + payloadSize + 1] = (uint8_t)(crc >> 8);
-
-  const size_t total = sizeof(final_msg);
-  char logBuffer[128];
-
-  // --- Framing & TX ---
-  size_t pos = 0;
-  size_t frame_idx = 0;
-
-  while (pos < total) {
-    size_t remain = total - pos;
-
-    if (!use_length_byte) {
-      // 13/49 etc: raw 8B frames
-      uint8_t chunk = (remain > 8) ? 8 : (uint8_t)remain;
-      bool is_last  = (remain <= 8);
-      uint32_t id   = (frame_idx == 0) ? id_first : (is_last ? id_last : id_middle);
-
-      sendCANFrame(id, &final_msg[pos], chunk);
-if (config.txlogging) {
-#if CANDUMP
-      double ts = now_seconds();
-      int len = snprintf(logBuffer, sizeof(logBuffer), "(%012.6f) vcanTx %08lX#", ts, id);
-      for (uint8_t j = 0; j < chunk; j++) {
-        len += snprintf(logBuffer + len, sizeof(logBuffer) - len, "%02X", final_msg[pos + j]);
-      }
-      streamCanLog(logBuffer);
-#else
-      canLog += "TX 0x" + String(id, HEX) + ": ";
-      for (uint8_t j = 0; j < chunk; j++) {
-        if (final_msg[pos + j] < 0x10) canLog += "0";
-        canLog += String(final_msg[pos + j], HEX) + (j + 1 < chunk ? " " : "");
-      }
-      canLog += "<br>";
-#endif
-    }
-      pos += chunk;
-
-    } else {
-      // A0: [len][<=7 data] → DLC = len + 1
-      uint8_t chunk = (remain > 7) ? 7 : (uint8_t)remain;
-      if (chunk == 0) break;
-
-      uint8_t frame_bytes[8];
-      frame_bytes[0] = chunk;                       // length of following bytes
-      memcpy(&frame_bytes[1], &final_msg[pos], chunk);
-
-      bool is_last  = (remain <= 7);
-      uint32_t id   = (frame_idx == 0) ? id_first : (is_last ? id_last : id_middle);
-
-      sendCANFrame(id, frame_bytes, (uint8_t)(chunk + 1));
-if (config.txlogging) {
-#if CANDUMP
-      double ts = now_seconds();
-      int len = snprintf(logBuffer, sizeof(logBuffer), "(%012.6f) vcanTx %08lX#", ts, id);
-      for (uint8_t j = 0; j < (uint8_t)(chunk + 1); j++) {
-        len += snprintf(logBuffer + len, sizeof(logBuffer) - len, "%02X", frame_bytes[j]);
-      }
-      streamCanLog(logBuffer);
-#else
-      canLog += "TX 0x" + String(id, HEX) + ": ";
-      for (uint8_t j = 0; j < (uint8_t)(chunk + 1); j++) {
-        if (frame_bytes[j] < 0x10) canLog += "0";
-        canLog += String(frame_bytes[j], HEX) + (j + 1 < (uint8_t)(chunk + 1) ? " " : "");
-      }
-      canLog += "<br>";
-#endif
-    }
-      pos += chunk;
-    }
-
-    frame_idx++;
-    // vTaskDelay(1);   // remove this hard delay
-if (frame_idx & 0x3) taskYIELD(); // tiny cooperative yield every 4 frames
+  // Final message = header + encoded payload + CRC
+  const size_t bodySize = headerSize + payloadSize;
+  const size_t total    = bodySize + 2;
+  if (total > CAN_TX_MSG_MAX) {
+    Serial.printf("sendCANMessage: %u bytes > CAN_TX_MSG_MAX\n", (unsigned)total);
+    return 0;
   }
+  uint8_t wire[CAN_TX_MSG_MAX];
+  memcpy(wire, header, headerSize);
+  for (size_t i = 0; i < payloadSize; i++)
+    wire[headerSize + i] = (payload ? payload[i] : 0x00) ^ xor_key;
+  wire[bodySize]     = (uint8_t)(crc & 0xFF);
+  wire[bodySize + 1] = (uint8_t)(crc >> 8);
+
+  if (!canSubmit(CAN_TX_NORMAL, id_first, id_middle, id_last, wire, total,
+                 use_length_byte ? CAN_TX_LEN_PREFIX : 0)) return 0;
+  return (uint8_t)(use_length_byte ? (total + 6) / 7 : (total + 7) / 8);   // length-prefixed frames carry 7
 }
 
 // ================= Sequencer =================
@@ -834,126 +999,310 @@ if (frame_idx & 0x3) taskYIELD(); // tiny cooperative yield every 4 frames
 void canSequencer_onHeartbeatC4() {
   g_lastC4ms = millis();
   if (!g_seqRunning) {
-    g_seqRunning = true;
-    g_seqIndex   = 0;
-    g_nextDueMs  = millis();   // start immediately
-    canHealth = true;
+    g_seqStartReq = true;
+    if (seqTaskHandle) xTaskNotifyGive(seqTaskHandle);
+  }
+}
+
+// Called by canSeqTask at a cycle boundary; per-step stats restart with the table
+static void seqAdoptPending() {
+  if (seqPending < 0) return;
+  portENTER_CRITICAL(&seqTabMux);
+  seqActive  = (uint8_t)seqPending;
+  seqPending = -1;
+  portEXIT_CRITICAL(&seqTabMux);
+  for (auto& t : seqPerStep) t.reset();
+  Serial.printf("Sequencer: %u-step %s table active\n",
+                seqTabCount[seqActive], seqTabFromFile[seqActive] ? "SPIFFS" : "built-in");
+}
+
+// Stage a table for the next cycle boundary (loop / web context)
+static void seqStage(const TxSeqStep* steps, uint8_t n, bool fromFile) {
+  portENTER_CRITICAL(&seqTabMux);
+  uint8_t dst = seqActive ^ 1;
+  memcpy(seqTab[dst], steps, n * sizeof(TxSeqStep));
+  seqTabCount[dst]    = n;
+  seqTabFromFile[dst] = fromFile;
+  seqPending = (int8_t)dst;
+  portEXIT_CRITICAL(&seqTabMux);
+  if (seqTaskHandle) xTaskNotifyGive(seqTaskHandle);
+}
+
+static void seqStageBuiltin() {
+  TxSeqStep steps[kSeqCount];
+  for (uint8_t i = 0; i < kSeqCount; i++) steps[i] = { (uint8_t)kSeq[i].act, 1, kSeq[i].gap_ms };
+  seqStage(steps, kSeqCount, false);
+}
+
+bool ecoflowTxSeqLoad() {
+  static TxSeqStep steps[TXSEQ_MAX_STEPS];
+  String err;
+  uint8_t n = txSeqLoadFile(kActionNames, kActionCount, steps, TXSEQ_MAX_STEPS, err);
+  if (n) {
+    seqLoadError = "";
+    seqStage(steps, n, true);
+    return true;
+  }
+  if (err.length()) Serial.printf("Sequencer: %s invalid (%s), using built-in table\n", TXSEQ_PATH, err.c_str());
+  seqLoadError = err;
+  seqStageBuiltin();
+  return err.length() == 0;
+}
+
+bool ecoflowTxSeqUpload(const char* text, size_t len, String& err) {
+  static TxSeqStep steps[TXSEQ_MAX_STEPS];
+  uint8_t n = txSeqParse(text, len, kActionNames, kActionCount, steps, TXSEQ_MAX_STEPS, err);
+  if (!n) return false;       // rejected: neither the file nor the running table changes
+  if (!txSeqSaveFile(text, len)) { err = "SPIFFS write failed"; return false; }
+  seqLoadError = "";
+  seqStage(steps, n, true);
+  return true;
+}
+
+void ecoflowTxSeqUseBuiltin() {
+  txSeqRemoveFile();
+  seqLoadError = "";
+  seqStageBuiltin();
+}
+
+void ecoflowTxSeqJson(String& out) {
+  uint8_t cur = seqActive;
+  int8_t  pend = seqPending;
+  out = "{\"source\":\"";
+  out += seqTabFromFile[cur] ? "spiffs" : "builtin";
+  out += "\",\"pending\":";
+  out += (pend >= 0) ? "true" : "false";
+  out += ",\"error\":\"";
+  out += seqLoadError;
+  out += "\",\"actions\":[";
+  for (uint8_t a = 0; a < kActionCount; a++) {
+    if (a) out += ",";
+    out += "\"";
+    out += kActionNames[a];
+    out += "\"";
+  }
+  out += "],\"steps\":";
+  txSeqToJson(seqTab[cur], seqTabCount[cur], kActionNames, out);
+  out += "}";
+}
+
+static void seqStatsResetNow() {
+  seqAll.reset();
+  for (auto& t : seqPerStep)   t.reset();
+  for (auto& t : seqPerAction) t.reset();
+  seqResyncs = 0;
+}
+
+void ecoflowSeqStatsReset() {
+  seqStatsResetReq = true;    // applied by canSeqTask before its next step
+}
+
+void ecoflowSeqStatsJson(String& out) {
+  out.reserve(6144);
+  char buf[112];
+  out = "{";
+  snprintf(buf, sizeof(buf), "\"running\":%s,\"resyncs\":%lu,\"all\":{\"frames\":%lu,\"late\":",
+           g_seqRunning ? "true" : "false", (unsigned long)seqResyncs, (unsigned long)seqAll.frames);
+  out += buf;
+  seqAll.late.appendJson(out);
+  out += ",\"dur\":";
+  seqAll.dur.appendJson(out);
+  out += "},\"steps\":[";
+  const uint8_t    cur = seqActive;
+  const TxSeqStep* tab = seqTab[cur];
+  for (uint8_t i = 0; i < seqTabCount[cur]; i++) {
+    if (i) out += ",";
+    snprintf(buf, sizeof(buf), "{\"i\":%u,\"act\":\"%s\",\"gap_ms\":%u,\"en\":%s,\"frames\":%lu,\"late\":",
+             i, kActionNames[tab[i].act], tab[i].gap_ms, tab[i].enabled ? "true" : "false",
+             (unsigned long)seqPerStep[i].frames);
+    out += buf;
+    seqPerStep[i].late.appendJson(out);
+    out += ",\"dur\":";
+    seqPerStep[i].dur.appendJson(out);
+    out += "}";
   }
+  out += "],\"actions\":[";
+  for (uint8_t a = 0; a < kActionCount; a++) {
+    if (a) out += ",";
+    snprintf(buf, sizeof(buf), "{\"act\":\"%s\",\"frames\":%lu,\"late\":",
+             kActionNames[a], (unsigned long)seqPerAction[a].frames);
+    out += buf;
+    seqPerAction[a].late.appendJson(out);
+    out += ",\"dur\":";
+    seqPerAction[a].dur.appendJson(out);
+    out += "}";
+  }
+  out += "]}";
 }
 
-void canTxSequencerTick() {
+// Runs due steps; returns µs until the next one, or -1 when idle (canSeqTask, host simulator)
+int64_t ecoflowSequencerService() {
   // stop if heartbeat lost
   if (g_seqRunning && (millis() - g_lastC4ms > C4_LOSS_TIMEOUT_MS)) {
     g_seqRunning = false;
     canHealth = false;
   }
-  if (!g_seqRunning || !config.canTxEnabled) return;
+  if (!g_seqRunning) seqAdoptPending();
+  if (!g_seqRunning && g_seqStartReq) {
+    g_seqStartReq = false;
+    g_seqRunning  = true;
+    g_seqIndex    = 0;
+    g_nextDueUs   = esp_timer_get_time();   // start immediately
+    canHealth = true;
+  }
+  if (!g_seqRunning || !config.canTxEnabled) return -1;
+  if (seqTabCount[seqActive] == 0) return -1;     // no table loaded yet
 
-  uint32_t now = millis();
-  if (now < g_nextDueMs) return;
+  int64_t now = esp_timer_get_time();
+  if (now < g_nextDueUs) return g_nextDueUs - now;
+
+  if (seqStatsResetReq) { seqStatsResetReq = false; seqStatsResetNow(); }
+
+  if (g_seqIndex == 0) seqAdoptPending();
+
+  int64_t late = now - g_nextDueUs;
+
+  // send current step; a disabled step still holds its gap so the rest of the cycle keeps its timing
+  const TxSeqStep& step = seqTab[seqActive][g_seqIndex];
+  if (step.enabled) {
+    uint8_t frames = sendAction((TxAction)step.act);
+    uint32_t dur = (uint32_t)(esp_timer_get_time() - now);
+
+    SeqTiming* rec[3] = { &seqAll, &seqPerStep[g_seqIndex], &seqPerAction[step.act] };
+    for (SeqTiming* t : rec) {
+      t->late.record((uint32_t)late);
+      t->dur.record(dur);
+      t->frames += frames;
+    }
+  }
 
-  // send current step
-  const Step& step = kSeq[g_seqIndex];
-  sendAction(step.act);
+  // schedule next against the plan, not against when we happened to run
+  g_nextDueUs += (int64_t)step.gap_ms * 1000;
+  if (late > SEQ_RESYNC_US) {
+    g_nextDueUs = now + (int64_t)step.gap_ms * 1000;
+    seqResyncs++;
+  }
+  g_seqIndex = (uint8_t)((g_seqIndex + 1) % seqTabCount[seqActive]);
+
+  now = esp_timer_get_time();
+  return (g_nextDueUs > now) ? (g_nextDueUs - now) : 0;
+}
 
-  // schedule next
-  g_nextDueMs = now + step.gap_ms;
-  g_seqIndex = (uint8_t)((g_seqIndex + 1) % kSeqCount);
+static void seqTimerCb(void*) {
+  xTaskNotifyGive(seqTaskHandle);
+}
+
+// One-shot esp_timer wakes the task at the next step (µs resolution); the
+// 100 ms fallback wait keeps heartbeat-loss detection running while idle.
+static void canSeqTask(void*) {
+  for (;;) {
+    int64_t waitUs = ecoflowSequencerService();
+    if (waitUs == 0) continue;
+
+    esp_timer_stop(seqTimer);
+    if (waitUs > 0) esp_timer_start_once(seqTimer, (uint64_t)waitUs);
+    ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(100));
+  }
+}
+
+void ecoflowSequencerStart() {
+  if (seqTaskHandle) return;
+
+  esp_timer_create_args_t args = {};
+  args.callback = seqTimerCb;
+  args.name     = "canSeq";
+  if (esp_timer_create(&args, &seqTimer) != ESP_OK) {
+    Serial.println("Sequencer: esp_timer_create failed");
+    return;
+  }
+  xTaskCreatePinnedToCore(canSeqTask, "canSeq", 4096, nullptr, 5, &seqTaskHandle, 1);
 }
 
 // ================= Send action dispatcher =================
 
-static void sendAction(TxAction a) {
-  if (!config.canTxEnabled) return;
+// Returns CAN frames queued for the action (0 = disabled or queue full)
+static uint8_t sendAction(TxAction a) {
+  if (!config.canTxEnabled) return 0;
 
   switch (a) {
     case A_70:
       if (config.message70) {
-        prepareMessage70(payload_70);
-        sendCANMessage(header_70, payload_70, sizeof(header_70), sizeof(payload_70));
+        return sendTemplate(tpl70);
       }
       break;
 
     case A_0B_04:
       if (config.message0B) {
-        prepareMessage0B(payload_0B);
-        sendCANMessage(header_0B_04, payload_0B, sizeof(header_0B_04), sizeof(payload_0B));
+        return sendTemplate(tpl0B_04);
       }
       break;
     case A_0B_02:
       if (config.message0B) {
-        prepareMessage0B(payload_0B);
-        sendCANMessage(header_0B_02, payload_0B, sizeof(header_0B_02), sizeof(payload_0B));
+        return sendTemplate(tpl0B_02);
       }
       break;
     case A_0B_05:
       if (config.message0B) {
-        prepareMessage0B(payload_0B);
-        sendCANMessage(header_0B_05, payload_0B, sizeof(header_0B_05), sizeof(payload_0B));
+        return sendTemplate(tpl0B_05);
       }
       break;
     case A_0B_50:
       if (config.message0B) {
-        prepareMessage0B(payload_0B);
-        sendCANMessage(header_0B_50, payload_0B, sizeof(header_0B_50), sizeof(payload_0B));
+        return sendTemplate(tpl0B_50);
       }
       break;
     case A_0B_08:
       if (config.message0B) {
-        prepareMessage0B(payload_0B);
-        sendCANMessage(header_0B_08, payload_0B, sizeof(header_0B_08), sizeof(payload_0B));
+        return sendTemplate(tpl0B_08);
       }
       break;
 
     case A_4F:
       if (config.message4F) {
         prepareMessage4F(payload_4F);
-        sendCANMessage(header_4F, payload_4F, sizeof(header_4F), sizeof(payload_4F));
+        return sendCANMessage(header_4F, payload_4F, sizeof(header_4F), sizeof(payload_4F));
       }
       break;
 
     case A_68:
       if (config.message68) {
         prepareMessage68(payload_68);
-        sendCANMessage(header_68, payload_68, sizeof(header_68), sizeof(payload_68));
+        return sendCANMessage(header_68, payload_68, sizeof(header_68), sizeof(payload_68));
       }
       break;
 
     case A_13:
       if (config.message13) {
         prepareMessage13(payload_13);
-        sendCANMessage(header_13, payload_13, sizeof(header_13), sizeof(payload_13));
+        return sendCANMessage(header_13, payload_13, sizeof(header_13), sizeof(payload_13));
       }
       break;
 
     case A_CB_321:
       if (config.messageCB) {
-        prepareMessageCB(payload_CB);
-        sendCANMessage(header_CB_321, payload_CB, sizeof(header_CB_321), sizeof(payload_CB));
+        return sendTemplate(tplCB_321);
       }
       break;
 
     case A_CB_141:
       if (config.messageCB) {
-        prepareMessageCB(payload_CB);
-        sendCANMessage(header_CB_141, payload_CB, sizeof(header_CB_141), sizeof(payload_CB));
+        return sendTemplate(tplCB_141);
       }
       break;
 
     case A_5C:
       if (config.message5C) {
-        prepareMessage5C(payload_5C);
-        sendCANMessage(header_5C, payload_5C, sizeof(header_5C), sizeof(payload_5C));
+        return sendTemplate(tpl5C);
       }
       break;
 
     case A_CB_150:
       if (config.messageCB) {
-        prepareMessageCB(payload_CB);
-        sendCANMessage(header_CB_150, payload_CB, sizeof(header_CB_150), sizeof(payload_CB));
+        return sendTemplate(tplCB_150);
       }
       break;
   }
+  return 0;
 }
 
 // ================= Xor Counter Initialiser =================
@@ -964,247 +1313,282 @@ void ecoflowMessagesInit() {
 
 // ================= EcoFlow CAN Rx Processor =================
 
-void processEcoFlowCAN(const twai_message_t &rx) {
-  uint32_t id = rx.identifier;
-  uint32_t fullID = id & 0x1FFFFFFF;
+// Every ID processEcoFlowCAN acts on; canInitDriver() filters to these
+const uint32_t ecoflowRxIds[] = { MSG14001_START_ID, MSG14001_MID_ID, MSG14001_END_ID };
+const size_t   ecoflowRxIdCount = sizeof(ecoflowRxIds) / sizeof(ecoflowRxIds[0]);
 
-  // 14001 IDs
-  #define MSG14001_START_ID   0x10014001UL
-  #define MSG14001_MID_ID     0x10114001UL
-  #define MSG14001_END_ID     0x10214001UL
+// Per-type CRC verdicts for reassembled 14001 messages (other families are diagnostics only)
+static uint32_t rxCrcOk[256];
+static uint32_t rxCrcFail[256];
 
-  // Fixed parts
-  #define MSG14001_HDR_LEN    18
-  #define MSG14001_TIMEOUT_MS 300
+uint32_t ecoflowRxCrcOk(uint8_t type)   { return rxCrcOk[type]; }
+uint32_t ecoflowRxCrcFail(uint8_t type) { return rxCrcFail[type]; }
 
-  // Header indices
-  #define IDX_TYPE   4   // msg_type
-  #define IDX_XOR    6   // XOR key (unencoded)
-  #define IDX_LEN_LO 2   // payload length (lo)
-  #define IDX_LEN_HI 3   // payload length (hi)
-  #define IDX_TRK0   16  // tracker = last 4 header bytes
-  #define IDX_TRK1   17
+// ================= Multi-frame reassembly =================
+#define MSG14001_FAMILY     (MSG14001_START_ID & ~REASM_POS_MASK)
+#define MSG14001_TIMEOUT_MS 300
 
-  #ifndef MSG14001_MAX_PAYLOAD
-  #define MSG14001_MAX_PAYLOAD 2048
-  #endif
-  #define MSG14001_BUF_CAP (MSG14001_HDR_LEN + MSG14001_MAX_PAYLOAD + 2)
-
-  static uint8_t  buf[MSG14001_BUF_CAP];
-  static size_t   have = 0;
-  static bool     active = false;
-  static uint32_t lastTime = 0;
-
-  // dynamic fields for the in-progress message
-  static bool     lenKnown = false;
-  static uint16_t payloadLen = 0;
-  static size_t   targetTotal = 0; // = 18 + payloadLen + 2 once known
-
-  // monitoring
-  static uint16_t typeCount[256] = {0};
-  static uint8_t  curType = 0xFF;       static bool curTypeValid = false;
-  static uint16_t curTrackerBE = 0;     static bool curTrackerValid = false;
-  static uint8_t  lastType = 0;
-  static uint16_t lastTrackerBE = 0;
-
-  auto reset_state = [&](){
-    have = 0; active = false; lastTime = 0;
-    lenKnown = false; payloadLen = 0; targetTotal = 0;
-    curTypeValid = false; curTrackerValid = false; curType = 0xFF; curTrackerBE = 0;
-  };
+// Slot pool keyed by ID family; the 14001 stream is never stolen by diagnostics
+static Reassembler reasm(MSG14001_TIMEOUT_MS, MSG14001_FAMILY);
 
-  auto append_bytes = [&](const uint8_t* data, uint8_t dlc){
-    if (!active || dlc == 0) return;
-    if (have + dlc > MSG14001_BUF_CAP) dlc = (uint8_t)(MSG14001_BUF_CAP - have); // clamp
-    memcpy(&buf[have], data, dlc);
-    have += dlc;
-    lastTime = millis();
-
-    // Capture type early
-    if (!curTypeValid && have >= (IDX_TYPE + 1)) {
-      curType = buf[IDX_TYPE];
-      curTypeValid = true;
-    }
-    // Determine payload length when we have first 4 header bytes
-    if (!lenKnown && have >= (IDX_LEN_HI + 1)) {
-      payloadLen = (uint16_t)buf[IDX_LEN_LO] | ((uint16_t)buf[IDX_LEN_HI] << 8); // little-endian
-      // Guard against oversize messages
-      if (payloadLen > MSG14001_MAX_PAYLOAD) {
-        char m[96];
-        snprintf(m, sizeof(m), "14001 oversize payload %u > cap %u — dropping",
-                 payloadLen, (unsigned)MSG14001_MAX_PAYLOAD);
-        streamDebug(m);
-        reset_state();
-        return;
-      }
-      targetTotal = (size_t)MSG14001_HDR_LEN + (size_t)payloadLen + 2U;
-      lenKnown = true;
-    }
-    // Tracker available once full header is buffered
-    if (!curTrackerValid && have >= MSG14001_HDR_LEN) {
-      curTrackerBE = ((uint16_t)buf[IDX_TRK0] << 8)  |  (uint16_t)buf[IDX_TRK1];
-      curTrackerValid = true;
-    }
-  };
+// monitoring
+static uint16_t typeCount[256] = {0};
+static uint8_t  lastType = 0;
+static uint16_t lastTrackerBE = 0;
 
-  auto is_printable = [](uint8_t c){ return (c >= 32 && c <= 126); };
+uint32_t ecoflowRxMsUntilDeadline() {
+  return reasm.msUntilDeadline(millis());
+}
 
-  auto try_finish = [&](){
-    if (!active || !lenKnown) return false;
-    if (have < targetTotal)   return false;
+void ecoflowRxCheckTimeout() {
+  uint8_t n = reasm.expire(millis());
+  if (n && webDebugActive()) {
+    char dbg[80];
+    snprintf(dbg, sizeof(dbg), "multi-frame timeout — evicted %u stream(s) late=%lums",
+             (unsigned)n, (unsigned long)reasm.evictLatLastMs());
+    streamDebug(dbg);
+  }
+}
 
-    uint8_t msg_type = buf[IDX_TYPE];
-    uint8_t xor_key  = buf[IDX_XOR];
+uint32_t ecoflowRxTimeouts()         { return reasm.timeouts(); }
+uint32_t ecoflowRxEvictLatLastMs()   { return reasm.evictLatLastMs(); }
+uint32_t ecoflowRxEvictLatMaxMs()    { return reasm.evictLatMaxMs(); }
+uint8_t  ecoflowRxActiveStreams()    { return reasm.activeStreams(); }
+uint32_t ecoflowRxSlotSteals()       { return reasm.slotSteals(); }
+
+static bool is_printable(uint8_t c) { return (c >= 32 && c <= 126); }
+
+// micros() at reception of the frame being processed
+static uint32_t curFrameUs = 0;
+
+// ================= 14001 handler dispatch =================
+// handlerHead[type] is 1 + index of the first handler for that type (0 = none);
+// entries for the same type are chained through .next the same way.
+struct HandlerEntry {
+  uint8_t        type;
+  int32_t        tracker;     // ECOFLOW_ANY_TRACKER or 0x0000..0xFFFF
+  EcoflowHandler fn;
+  const char*    name;
+  uint8_t        next;
+  uint32_t       calls;
+  uint32_t       totalUs;
+  uint32_t       maxUs;
+};
 
-    uint8_t  t0 = buf[IDX_TRK0], t1 = buf[IDX_TRK1];
-    uint16_t trackerBE = ((uint32_t)t0 << 8) | (uint32_t)t1;
+static HandlerEntry handlers[ECOFLOW_MAX_HANDLERS];
+static uint8_t      handlerCount = 0;
+static uint8_t      handlerHead[256];
+static uint32_t     unhandledCount = 0;
 
-    // CRC16 at end (hi before lo)
-    uint8_t  crc_hi = buf[targetTotal - 2];
-    uint8_t  crc_lo = buf[targetTotal - 1];
-    uint16_t crc    = ((uint16_t)crc_hi << 8) | crc_lo;
+bool ecoflowOnMessage(uint8_t type, int32_t tracker, EcoflowHandler fn, const char* name) {
+  if (!fn || handlerCount >= ECOFLOW_MAX_HANDLERS) {
+    Serial.printf("ecoflowOnMessage: cannot register %s (type=0x%02X)\n", name ? name : "?", type);
+    return false;
+  }
+  HandlerEntry& h = handlers[handlerCount];
+  h.type = type; h.tracker = tracker; h.fn = fn; h.name = name ? name : "?";
+  h.calls = 0; h.totalUs = 0; h.maxUs = 0;
+
+  // Append to the end of this type's chain so registration order is kept
+  h.next = 0;
+  uint8_t* link = &handlerHead[type];
+  while (*link) link = &handlers[*link - 1].next;
+  *link = ++handlerCount;
+  return true;
+}
 
-    static uint8_t decoded[MSG14001_MAX_PAYLOAD];
-    for (uint16_t i = 0; i < payloadLen; ++i)
-      decoded[i] = buf[MSG14001_HDR_LEN + i] ^ xor_key;
+static HandlerEntry* findHandler(uint8_t type, uint16_t trackerBE) {
+  HandlerEntry* any = nullptr;
+  for (uint8_t i = handlerHead[type]; i; i = handlers[i - 1].next) {
+    HandlerEntry& h = handlers[i - 1];
+    if (h.tracker == (int32_t)trackerBE) return &h;
+    if (h.tracker == ECOFLOW_ANY_TRACKER && !any) any = &h;
+  }
+  return any;
+}
 
-    typeCount[msg_type]++; lastType = msg_type; lastTrackerBE = trackerBE;
+size_t ecoflowHandlerCount() { return handlerCount; }
 
-    if (msg_type == 0xC4) {
-      // Serial is expected at [3..18] for C4
-      char serial[17] = {0};
-      bool printable = (payloadLen >= 19);
-      for (int i = 0; i < 16 && i + 3 < payloadLen; ++i) {
-        uint8_t c = decoded[3 + i];
-        serial[i] = is_printable(c) ? (char)c : '?';
-        if (!is_printable(c)) printable = false;
-      }
+bool ecoflowHandlerInfo(size_t idx, EcoflowHandlerInfo& out) {
+  if (idx >= handlerCount) return false;
+  const HandlerEntry& h = handlers[idx];
+  out.name = h.name; out.type = h.type; out.tracker = h.tracker;
+  out.calls = h.calls; out.totalUs = h.totalUs; out.maxUs = h.maxUs;
+  return true;
+}
 
-      if (printable) {
-        strncpy(SerialPS, serial, sizeof(SerialPS) - 1);
-        SerialPS[sizeof(SerialPS) - 1] = '\0';
-      } else {
-        SerialPS[0] = '\0'; // invalid / missing → clear
-      }
+uint32_t ecoflowUnhandledCount() { return unhandledCount; }
 
-      char dbg[256];
-      snprintf(dbg, sizeof(dbg),
-               "14001 OK type=C4 len=%u cnt=%u XOR=0x%02X CRC=%04X tracker=%02X%02X (BE=0x%04XX) serial=%s%s",
-               payloadLen, (unsigned)typeCount[msg_type], xor_key, crc,
-               t0, t1, (uint16_t)trackerBE,
-               serial, printable ? "" : " (non-printable/missing)");
-      streamDebug(dbg);
+// ---- Completed, CRC-valid 14001 message ----
+static void on14001Message(const ReasmMessage& m) {
+  static uint8_t decoded[REASM_MAX_PAYLOAD];
+  for (uint16_t i = 0; i < m.payloadLen; ++i)
+    decoded[i] = m.payload[i] ^ m.xorKey;
 
-      // Save XOR for 3C reply
-      xor3C = xor_key;
+  typeCount[m.type]++; lastType = m.type; lastTrackerBE = m.trackerBE;
 
-      // Reply to heartbeat only
-      if (config.canTxEnabled && config.message3C) {
-        ecoflowSend3C();
-      }
+  EcoflowMsg msg;
+  msg.type = m.type; msg.xorKey = m.xorKey; msg.trackerBE = m.trackerBE;
+  msg.crc = m.crc; msg.len = m.payloadLen; msg.data = decoded;
 
-      // Begin sequencer
-      canSequencer_onHeartbeatC4();
+  HandlerEntry* h = findHandler(m.type, m.trackerBE);
 
-    } else if (msg_type == 0xDE) {
-      char dbg[128];
-      snprintf(dbg, sizeof(dbg),
-               "14001 OK type=DE len=%u cnt=%u XOR=0x%02X CRC=%04X tracker=%02X%02X (BE=0x%04X)",
-               payloadLen, (unsigned)typeCount[msg_type], xor_key, crc,
-               t0, t1, (uint16_t)trackerBE);
-      streamDebug(dbg);
+  if (webDebugActive()) {
+    char preview[3*8+1] = {0};
+    int p = 0;
+    int show = (m.payloadLen < 8) ? m.payloadLen : 8;
+    for (int i = 0; i < show; ++i)
+      p += snprintf(preview + p, sizeof(preview) - p, "%02X", decoded[i]);
 
-      if (trackerBE == 0x0105) {
-        xor8C = xor_key;
-        if (config.canTxEnabled && config.message8C) {
-          ecoflowSend8C();
-        }
-      }
-      if (trackerBE == 0x0141) {
-        xor24 = xor_key;
-        if (config.canTxEnabled && config.message24) {
-          ecoflowSend24();
-        }
-      }
+    char dbg[192];
+    snprintf(dbg, sizeof(dbg),
+             "14001 OK type=0x%02X len=%u cnt=%u XOR=0x%02X CRC=%04X tracker=%04X payload[0..%d]=%s -> %s",
+             m.type, m.payloadLen, (unsigned)typeCount[m.type], m.xorKey, m.crc,
+             m.trackerBE, show-1, preview, h ? h->name : "(none)");
+    streamDebug(dbg);
+  }
 
-    } else if (msg_type == 0xCB) {
+  if (!h) { unhandledCount++; return; }
 
-      if (trackerBE == 0x2031) {
-        char dbg[128];
-        snprintf(dbg, sizeof(dbg),
-                 "14001 OK type=CB len=%u cnt=%u XOR=0x%02X CRC=%04X BE=0x%04X Upper Limit=%u",
-                 payloadLen, (unsigned)typeCount[msg_type], xor_key, crc,
-                 (uint16_t)trackerBE, (payloadLen ? decoded[0] : 0));
-        streamDebug(dbg);
+  uint32_t t0 = micros();
+  h->fn(msg);
+  uint32_t dt = micros() - t0;
+  h->calls++;
+  h->totalUs += dt;
+  if (dt > h->maxUs) h->maxUs = dt;
+}
 
-        xorCB = xor_key;
-        if (payloadLen >= 1) config.bmsChgUp = decoded[0];
+// ---- Built-in handlers ----
+static void onHeartbeatC4(const EcoflowMsg& m) {
+  // Serial is expected at [3..18] for C4
+  char serial[17] = {0};
+  bool printable = (m.len >= 19);
+  for (int i = 0; i < 16 && i + 3 < m.len; ++i) {
+    uint8_t c = m.data[3 + i];
+    serial[i] = is_printable(c) ? (char)c : '?';
+    if (!is_printable(c)) printable = false;
+  }
 
-        if (config.canTxEnabled && config.messageCB) {
-          ecoflowSendCB2031();
-        }
-      }
+  if (printable) {
+    strncpy(SerialPS, serial, sizeof(SerialPS) - 1);
+    SerialPS[sizeof(SerialPS) - 1] = '\0';
+  } else {
+    SerialPS[0] = '\0'; // invalid / missing → clear
+  }
 
-      if (trackerBE == 0x2033) {
-        char dbg[128];
-        snprintf(dbg, sizeof(dbg),
-                 "14001 OK type=CB len=%u cnt=%u XOR=0x%02X CRC=%04X BE=0x%04X Lower Limit=%u",
-                 payloadLen, (unsigned)typeCount[msg_type], xor_key, crc,
-                 (uint16_t)trackerBE, (payloadLen ? decoded[0] : 0));
-        streamDebug(dbg);
+  // Save XOR for 3C reply
+  xor3C = m.xorKey;
 
-        xorCB = xor_key;
-        if (payloadLen >= 1) config.bmsChgDn = decoded[0];
+  // Reply to heartbeat only
+  if (config.canTxEnabled && config.message3C) {
+    send3CFast(curFrameUs);
+  }
 
-        if (config.canTxEnabled && config.messageCB) {
-          ecoflowSendCB2033();
-        }
-      }
+  // Begin sequencer
+  canSequencer_onHeartbeatC4();
 
-    } else {
-      char preview[3*8+1] = {0};
-      int p = 0;
-      int show = (payloadLen < 8) ? payloadLen : 8;
-      for (int i = 0; i < show; ++i)
-        p += snprintf(preview + p, sizeof(preview) - p, "%02X", decoded[i]);
+  if (webDebugActive()) {
+    char dbg[64];
+    snprintf(dbg, sizeof(dbg), "C4 serial=%s%s", serial, printable ? "" : " (non-printable/missing)");
+    streamDebug(dbg);
+  }
+}
 
-      char dbg[256];
-      snprintf(dbg, sizeof(dbg),
-               "14001 OK type=0x%02X len=%u cnt=%u XOR=0x%02X CRC=%04X tracker=%02X%02X (BE=0x%04X) payload[0..%d]=%s",
-               msg_type, payloadLen, (unsigned)typeCount[msg_type], xor_key, crc,
-               t0, t1, (uint16_t)trackerBE, show-1, preview);
-      streamDebug(dbg);
-    }
+static void onDE0105(const EcoflowMsg& m) {
+  xor8C = m.xorKey;
+  if (config.canTxEnabled && config.message8C) {
+    ecoflowSend8C();
+  }
+}
 
-    reset_state();
-    return true;
-  };
+static void onDE0141(const EcoflowMsg& m) {
+  xor24 = m.xorKey;
+  if (config.canTxEnabled && config.message24) {
+    ecoflowSend24();
+  }
+}
 
-  // ----- route incoming frame -----
-  if (fullID == MSG14001_START_ID) {
-    reset_state(); active = true; lastTime = millis();
-    append_bytes(rx.data, rx.data_length_code);
-    streamDebug("14001 start");
-  } else if (fullID == MSG14001_MID_ID) {
-    append_bytes(rx.data, rx.data_length_code);
-  } else if (fullID == MSG14001_END_ID) {
-    append_bytes(rx.data, rx.data_length_code);
-    (void)try_finish();
+static void onCB2031(const EcoflowMsg& m) {
+  xorCB = m.xorKey;
+  if (m.len >= 1) config.bmsChgUp = m.data[0];
+
+  if (config.canTxEnabled && config.messageCB) {
+    ecoflowSendCB2031();
   }
+}
+
+static void onCB2033(const EcoflowMsg& m) {
+  xorCB = m.xorKey;
+  if (m.len >= 1) config.bmsChgDn = m.data[0];
 
-  // ----- timeout -----
-  if (active && (millis() - lastTime > MSG14001_TIMEOUT_MS)) {
-    streamDebug("14001 timeout — reset");
-    reset_state();
+  if (config.canTxEnabled && config.messageCB) {
+    ecoflowSendCB2033();
   }
+}
+
+void ecoflowHandlersInit() {
+  // 3C image must exist before the first heartbeat can arrive
+  build3CKeyTerms();
+  refresh3CImage();
+
+  ecoflowOnMessage(0xC4, ECOFLOW_ANY_TRACKER, onHeartbeatC4, "C4_heartbeat");
+  ecoflowOnMessage(0xDE, 0x0105,             onDE0105,      "DE_0105_8C");
+  ecoflowOnMessage(0xDE, 0x0141,             onDE0141,      "DE_0141_24");
+  ecoflowOnMessage(0xCB, 0x2031,             onCB2031,      "CB_2031_upper");
+  ecoflowOnMessage(0xCB, 0x2033,             onCB2033,      "CB_2033_lower");
+}
 
-  // optional raw logging
-  if (config.rxlogging) {
-    char logBuffer[96];
-    double ts = now_seconds();
-    int len = snprintf(logBuffer, sizeof(logBuffer), "(%012.6f) vcanRx %08lX#", ts, id);
-    for (uint8_t i = 0; i < rx.data_length_code; i++)
-      len += snprintf(logBuffer + len, sizeof(logBuffer) - len, "%02X", rx.data[i]);
-    streamCanLog(logBuffer);
+// ---- Other families: diagnostics only ----
+static void onOtherMessage(const ReasmMessage& m) {
+  if (!webDebugActive()) return;
+  char dbg[128];
+  snprintf(dbg, sizeof(dbg),
+           "stream %08lX OK type=0x%02X len=%u XOR=0x%02X CRC=%04X tracker=%04X",
+           (unsigned long)m.family, m.type, m.payloadLen, m.xorKey, m.crc, m.trackerBE);
+  streamDebug(dbg);
+}
+
+void processEcoFlowCAN(const twai_message_t &rx, uint32_t rxUs) {
+  curFrameUs = rxUs ? rxUs : micros();
+  uint32_t id = rx.identifier;
+  uint32_t fullID = id & 0x1FFFFFFF;
+
+  // A stalled stream must not absorb bytes from the next one
+  ecoflowRxCheckTimeout();
+
+
+  ReasmMessage m;
+  switch (reasm.feed(fullID, rx.data, rx.data_length_code, millis(), m)) {
+    case REASM_COMPLETE:
+      if (m.family == MSG14001_FAMILY) {
+        rxCrcOk[m.type]++;
+        on14001Message(m);
+      } else {
+        onOtherMessage(m);
+      }
+      break;
+
+    case REASM_CRC_FAIL: {
+      if (m.family == MSG14001_FAMILY) rxCrcFail[m.type]++;
+      if (!webDebugActive()) break;
+      char dbg[128];
+      snprintf(dbg, sizeof(dbg),
+               "%08lX CRC FAIL type=0x%02X len=%u tracker=%04X got=%04X calc=%04X — dropped",
+               (unsigned long)m.family, m.type, m.payloadLen, m.trackerBE, m.crc, m.crcCalc);
+      streamDebug(dbg);
+      break;
+    }
+
+    case REASM_OVERSIZE: {
+      if (!webDebugActive()) break;
+      char m2[96];
+      snprintf(m2, sizeof(m2), "%08lX oversize payload > cap %u — dropping",
+               (unsigned long)reasmFamily(fullID), (unsigned)REASM_MAX_PAYLOAD);
+      streamDebug(m2);
+      break;
+    }
+
+    default:
+      break;
   }
 }
@@ -8,16 +8,18 @@
 #include "wi-fi.h"
 #include "mqtt.h"
 #include "bms.h"
+#include "bms_params.h"
 #include "can.h"
+#include "can_twai.h"
 #include "ecoflow.h"
 #include "web.h"
 #include "ota.h"
+#include "can_rec.h"
 
 // -----------------------------------------------------------------------------
 // Configuration
 // -----------------------------------------------------------------------------
 #define SERIALDEBUG 0
-#define CANDUMP 1
 #define VERBOSE_BMS_PRINTS 0
 
 // -----------------------------------------------------------------------------
@@ -28,7 +30,6 @@ Preferences prefs;
 
 // Used by web/API state reporting
 bool canHealth = false;
-String canLog;
 
 // -----------------------------------------------------------------------------
 // Setup
@@ -54,6 +55,9 @@ void setup() {
     Serial.println("SPIFFS Mount Failed");
   }
 
+  // --- CAN recorder (SD, or SPIFFS fallback) ---
+  canRecInit();
+
   // --- WiFi (persistent + AP fallback) ---
   loadWiFiConfig();
 
@@ -64,6 +68,8 @@ void setup() {
   }
 
   // --- CAN ---
+  ecoflowHandlersInit();
+  canSetTransport(&canTwaiTransport());
   canInitDriver();
   if (twai_ok) {
     canStartTasks();
@@ -80,6 +86,7 @@ void setup() {
   webInit(server);
   setupServerRoutes(server);
   otaInit(server);
+  canRecRoutes(server);
   webSetupStaticRoutes(server);
 
   // --- Start server ---
@@ -87,6 +94,8 @@ void setup() {
 
   // --- EcoFlow TX sequencer/messages ---
   ecoflowMessagesInit();
+  ecoflowTxSeqLoad();
+  ecoflowSequencerStart();
 }
 
 // -----------------------------------------------------------------------------
@@ -98,8 +107,8 @@ void loop() {
   mqttLoopTick();
 
   applyBatteryMasterIfChanged();
-  bmsLoopTick();
 
   webTick();
-  canTxSequencerTick();
+  canFilterTick();
+  ecoflow3CImageTick();
 }
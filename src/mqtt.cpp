@@ -2,11 +2,11 @@
 #include "config.h"
 #include "can.h"
 #include "ecoflow.h"          // for getPeerSerial()
+#include "bms_snapshot.h"
 
 #include <WiFi.h>
 #include <PubSubClient.h>
 #include <Preferences.h>
-#include <bms2.h>
 
 // Persistent config
 extern Preferences prefs;
@@ -148,12 +148,15 @@ static void mqttPublishStates() {
   if (!mqttCfg.enabled) return;
   if (!mqttClient.connected()) return;
 
-  const int   soc     = (int)bms.get_state_of_charge();
-  const float voltage = bms.get_voltage();
-  const float current = bms.get_current();
-  const int   temp    = (int)bms.get_ntc_temperature(0);
-  const int   chg     = (int)config.chgruntime;
-  const int   dis     = (int)config.disruntime;
+  BmsSnapshot b;
+  bmsSnapshotGet(b);
+
+  const int   soc     = (int)b.bmsSoc;
+  const float voltage = b.bmsPackMv / 1000.0f;
+  const float current = b.packMa / 1000.0f;
+  const int   temp    = b.ntcDeciC[0] / 10;
+  const int   chg     = (int)b.chgRuntimeMin;
+  const int   dis     = (int)b.disRuntimeMin;
 
   String json = "{";
   json += "\"soc\":"          + String(soc)          + ",";
@@ -162,6 +165,8 @@ static void mqttPublishStates() {
   json += "\"temperature\":"  + String(temp)         + ",";
   json += "\"chgruntime\":"   + String(chg)          + ",";
   json += "\"disruntime\":"   + String(dis)          + ",";
+  const uint32_t age = bmsSnapshotDataAgeMs(b);
+  if (age != UINT32_MAX) json += "\"dataAgeMs\":" + String((unsigned long)age) + ",";
   json += "\"batteryMaster\":" + String(config.batteryMaster ? "true" : "false") + ",";
   json += "\"chgMOSFET\":"    + String(config.moschg ? "true" : "false") + ",";
   json += "\"disMOSFET\":"    + String(config.mosdis ? "true" : "false") + ",";
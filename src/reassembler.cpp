@@ -0,0 +1,158 @@
+#include "reassembler.h"
+#include "crc16.h"
+#include <string.h>
+
+// Header indices
+#define IDX_LEN_LO 2   // payload length (lo)
+#define IDX_LEN_HI 3   // payload length (hi)
+#define IDX_TYPE   4   // msg_type
+#define IDX_XOR    6   // XOR key (unencoded)
+#define IDX_TRK0   16  // tracker = last 2 header bytes
+#define IDX_TRK1   17
+
+// ---------------- Slot management ----------------
+void Reassembler::clear(Slot& s) {
+  s.active = false; s.lenKnown = false;
+  s.family = 0; s.lastMs = 0;
+  s.have = 0; s.targetTotal = 0; s.payloadLen = 0;
+  s.crcState = crc16_init(); s.crcCovered = 0;
+}
+
+void Reassembler::reset() {
+  for (auto& s : slots_) clear(s);
+}
+
+Reassembler::Slot* Reassembler::find(uint32_t family) {
+  for (auto& s : slots_)
+    if (s.active && s.family == family) return &s;
+  return nullptr;
+}
+
+// Slot for a new START: same family restarts, else a free slot, else the
+// stalest unpinned stream is stolen.
+Reassembler::Slot* Reassembler::claim(uint32_t family, uint32_t nowMs) {
+  Slot* s = find(family);
+  if (s) { clear(*s); return s; }
+
+  for (auto& f : slots_)
+    if (!f.active) { clear(f); return &f; }
+
+  Slot* victim = nullptr;
+  for (auto& f : slots_) {
+    if (f.family == pinned_ && family != pinned_) continue;
+    if (!victim || (nowMs - f.lastMs) > (nowMs - victim->lastMs)) victim = &f;
+  }
+  if (!victim) return nullptr;
+  steals_++;
+  clear(*victim);
+  return victim;
+}
+
+uint8_t Reassembler::activeStreams() const {
+  uint8_t n = 0;
+  for (auto& s : slots_) if (s.active) n++;
+  return n;
+}
+
+// ---------------- Frame input ----------------
+ReasmResult Reassembler::append(Slot& s, const uint8_t* data, uint8_t dlc, uint32_t nowMs) {
+  if (dlc == 0) return REASM_NONE;
+  if (s.have + dlc > REASM_BUF_CAP) dlc = (uint8_t)(REASM_BUF_CAP - s.have); // clamp
+  memcpy(&s.buf[s.have], data, dlc);
+  s.have += dlc;
+  s.lastMs = nowMs;
+
+  // Determine payload length when we have first 4 header bytes
+  if (!s.lenKnown && s.have >= (IDX_LEN_HI + 1)) {
+    s.payloadLen = (uint16_t)s.buf[IDX_LEN_LO] | ((uint16_t)s.buf[IDX_LEN_HI] << 8); // little-endian
+    if (s.payloadLen > REASM_MAX_PAYLOAD) {
+      clear(s);
+      return REASM_OVERSIZE;
+    }
+    s.targetTotal = (size_t)REASM_HDR_LEN + (size_t)s.payloadLen + 2U;
+    s.lenKnown = true;
+  }
+
+  // Fold new bytes into the CRC, stopping short of the 2-byte trailer
+  size_t crcEnd = s.lenKnown ? (s.targetTotal - 2U) : s.have;
+  if (crcEnd > s.have) crcEnd = s.have;
+  if (crcEnd > s.crcCovered) {
+    s.crcState = crc16_update(s.crcState, &s.buf[s.crcCovered], crcEnd - s.crcCovered);
+    s.crcCovered = crcEnd;
+  }
+  return REASM_NONE;
+}
+
+ReasmResult Reassembler::finish(Slot& s, ReasmMessage& out) {
+  if (!s.lenKnown || s.have < s.targetTotal) return REASM_NONE;
+
+  out.family     = s.family;
+  out.type       = s.buf[IDX_TYPE];
+  out.xorKey     = s.buf[IDX_XOR];
+  out.payloadLen = s.payloadLen;
+  out.trackerBE  = ((uint16_t)s.buf[IDX_TRK0] << 8) | (uint16_t)s.buf[IDX_TRK1];
+  out.crc        = (uint16_t)s.buf[s.targetTotal - 2] | ((uint16_t)s.buf[s.targetTotal - 1] << 8);
+  out.crcCalc    = s.crcState;
+  out.header     = s.buf;
+  out.payload    = &s.buf[REASM_HDR_LEN];
+
+  // Slot is free again, but its bytes are untouched until the next START claims it
+  s.active = false;
+  return (out.crc == out.crcCalc) ? REASM_COMPLETE : REASM_CRC_FAIL;
+}
+
+ReasmResult Reassembler::feed(uint32_t id, const uint8_t* data, uint8_t dlc, uint32_t nowMs, ReasmMessage& out) {
+  if (!reasmIsMultiFrameId(id)) return REASM_NONE;
+
+  const uint32_t family = reasmFamily(id);
+  const uint8_t  pos    = (uint8_t)(((id & 0x1FFFFFFF) & REASM_POS_MASK) >> REASM_POS_SHIFT);
+
+  Slot* s;
+  if (pos == 0) {
+    s = claim(family, nowMs);
+    if (!s) return REASM_NONE;
+    s->active = true;
+    s->family = family;
+  } else {
+    s = find(family);
+    if (!s) { orphans_++; return REASM_NONE; }
+  }
+
+  ReasmResult r = append(*s, data, dlc, nowMs);
+  if (r != REASM_NONE) return r;
+
+  if (pos == 2) {
+    r = finish(*s, out);
+    if (r == REASM_NONE) clear(*s);   // END before the declared length: drop it
+  }
+  return r;
+}
+
+// ---------------- Deadlines ----------------
+uint8_t Reassembler::expire(uint32_t nowMs) {
+  uint8_t n = 0;
+  for (auto& s : slots_) {
+    if (!s.active) continue;
+    uint32_t age = nowMs - s.lastMs;
+    if (age <= timeoutMs_) continue;
+
+    uint32_t late = age - timeoutMs_;
+    timeouts_++;
+    latLast_ = late;
+    if (late > latMax_) latMax_ = late;
+    clear(s);
+    n++;
+  }
+  return n;
+}
+
+uint32_t Reassembler::msUntilDeadline(uint32_t nowMs) const {
+  uint32_t best = UINT32_MAX;
+  for (auto& s : slots_) {
+    if (!s.active) continue;
+    uint32_t age = nowMs - s.lastMs;
+    uint32_t left = (age >= timeoutMs_) ? 0 : (timeoutMs_ - age);
+    if (left < best) best = left;
+  }
+  return best;
+}
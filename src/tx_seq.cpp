@@ -0,0 +1,194 @@
+#include "tx_seq.h"
+
+#include <FS.h>
+#include <SPIFFS.h>
+#include <ctype.h>
+#include <string.h>
+
+// ---------------- Minimal JSON scanner ----------------
+// Only what the step format needs: arrays of flat objects with string,
+// unsigned integer and boolean values. No escapes, no nesting.
+struct Cursor {
+  const char* p;
+  const char* end;
+};
+
+static void skipWs(Cursor& c) {
+  while (c.p < c.end && isspace((unsigned char)*c.p)) c.p++;
+}
+
+static bool eat(Cursor& c, char ch) {
+  skipWs(c);
+  if (c.p < c.end && *c.p == ch) { c.p++; return true; }
+  return false;
+}
+
+static bool readString(Cursor& c, char* out, size_t cap) {
+  if (!eat(c, '"')) return false;
+  size_t n = 0;
+  while (c.p < c.end && *c.p != '"') {
+    if (*c.p == '\\' || n + 1 >= cap) return false;
+    out[n++] = *c.p++;
+  }
+  if (c.p >= c.end) return false;
+  c.p++;
+  out[n] = 0;
+  return true;
+}
+
+static bool readUint(Cursor& c, uint32_t& v) {
+  skipWs(c);
+  bool any = false;
+  v = 0;
+  while (c.p < c.end && isdigit((unsigned char)*c.p)) {
+    v = v * 10 + (uint32_t)(*c.p++ - '0');
+    if (v > 1000000UL) return false;
+    any = true;
+  }
+  return any;
+}
+
+static bool readWord(Cursor& c, const char* w) {
+  size_t n = strlen(w);
+  if ((size_t)(c.end - c.p) < n || strncmp(c.p, w, n) != 0) return false;
+  c.p += n;
+  return true;
+}
+
+static bool readBool(Cursor& c, bool& v) {
+  skipWs(c);
+  if (readWord(c, "true"))  { v = true;  return true; }
+  if (readWord(c, "false")) { v = false; return true; }
+  uint32_t n;
+  if (readUint(c, n) && n <= 1) { v = (n == 1); return true; }
+  return false;
+}
+
+static uint8_t fail(String& err, uint8_t step, const char* what) {
+  char buf[96];
+  snprintf(buf, sizeof(buf), "step %u: %s", (unsigned)step, what);
+  err = buf;
+  return 0;
+}
+
+// ---------------- Parse / validate ----------------
+uint8_t txSeqParse(const char* text, size_t len,
+                   const char* const* actNames, uint8_t actCount,
+                   TxSeqStep* out, uint8_t maxSteps, String& err) {
+  Cursor c{text, text + len};
+  err = "";
+
+  if (!eat(c, '[')) { err = "expected '['"; return 0; }
+  if (eat(c, ']'))  { err = "empty sequence"; return 0; }
+
+  uint8_t  n = 0;
+  uint32_t cycleMs = 0;
+  bool     anyEnabled = false;
+
+  for (;;) {
+    if (n >= maxSteps) return fail(err, n, "too many steps");
+    if (!eat(c, '{'))  return fail(err, n, "expected '{'");
+
+    TxSeqStep s{0, 1, 0};
+    bool haveAct = false, haveGap = false;
+
+    if (!eat(c, '}')) {
+      for (;;) {
+        char key[12];
+        if (!readString(c, key, sizeof(key)) || !eat(c, ':')) return fail(err, n, "bad key");
+
+        if (strcmp(key, "act") == 0) {
+          char name[16];
+          if (!readString(c, name, sizeof(name))) return fail(err, n, "bad act");
+          uint8_t a = 0;
+          while (a < actCount && strcmp(actNames[a], name) != 0) a++;
+          if (a == actCount) return fail(err, n, "unknown act");
+          s.act = a;
+          haveAct = true;
+        } else if (strcmp(key, "gap_ms") == 0) {
+          uint32_t g;
+          if (!readUint(c, g) || g > TXSEQ_MAX_GAP_MS) return fail(err, n, "bad gap_ms");
+          s.gap_ms = (uint16_t)g;
+          haveGap = true;
+        } else if (strcmp(key, "en") == 0) {
+          bool en;
+          if (!readBool(c, en)) return fail(err, n, "bad en");
+          s.enabled = en ? 1 : 0;
+        } else {
+          return fail(err, n, "unknown key");
+        }
+
+        if (eat(c, ',')) continue;
+        if (eat(c, '}')) break;
+        return fail(err, n, "expected ',' or '}'");
+      }
+    }
+    if (!haveAct || !haveGap) return fail(err, n, "act and gap_ms are required");
+
+    out[n++] = s;
+    cycleMs += s.gap_ms;
+    if (s.enabled) anyEnabled = true;
+
+    if (eat(c, ',')) continue;
+    if (eat(c, ']')) break;
+    return fail(err, n - 1, "expected ',' or ']'");
+  }
+
+  skipWs(c);
+  if (c.p != c.end)               { err = "trailing data"; return 0; }
+  if (!anyEnabled)                { err = "no enabled step"; return 0; }
+  if (cycleMs < TXSEQ_MIN_CYCLE_MS) {
+    char buf[64];
+    snprintf(buf, sizeof(buf), "cycle %lu ms < %u ms", (unsigned long)cycleMs, (unsigned)TXSEQ_MIN_CYCLE_MS);
+    err = buf;
+    return 0;
+  }
+  return n;
+}
+
+void txSeqToJson(const TxSeqStep* steps, uint8_t n, const char* const* actNames, String& out) {
+  char buf[64];
+  out += "[";
+  for (uint8_t i = 0; i < n; i++) {
+    snprintf(buf, sizeof(buf), "%s{\"act\":\"%s\",\"gap_ms\":%u,\"en\":%s}",
+             i ? "," : "", actNames[steps[i].act], (unsigned)steps[i].gap_ms,
+             steps[i].enabled ? "true" : "false");
+    out += buf;
+  }
+  out += "]";
+}
+
+// ---------------- SPIFFS ----------------
+uint8_t txSeqLoadFile(const char* const* actNames, uint8_t actCount,
+                      TxSeqStep* out, uint8_t maxSteps, String& err) {
+  err = "";
+  if (!SPIFFS.exists(TXSEQ_PATH)) return 0;
+
+  File f = SPIFFS.open(TXSEQ_PATH, "r");
+  if (!f) { err = "open failed"; return 0; }
+  size_t size = f.size();
+  if (size == 0 || size > TXSEQ_MAX_FILE) {
+    f.close();
+    err = "bad file size";
+    return 0;
+  }
+
+  static char text[TXSEQ_MAX_FILE];
+  size_t got = f.read((uint8_t*)text, size);
+  f.close();
+  if (got != size) { err = "short read"; return 0; }
+
+  return txSeqParse(text, size, actNames, actCount, out, maxSteps, err);
+}
+
+bool txSeqSaveFile(const char* text, size_t len) {
+  File f = SPIFFS.open(TXSEQ_PATH, "w");
+  if (!f) return false;
+  size_t put = f.write((const uint8_t*)text, len);
+  f.close();
+  return put == len;
+}
+
+bool txSeqRemoveFile() {
+  return !SPIFFS.exists(TXSEQ_PATH) || SPIFFS.remove(TXSEQ_PATH);
+}
@@ -6,10 +6,16 @@
 
 #include "config.h"
 #include "can.h"
+#include "can_transport.h"
 #include "wi-fi.h"
 #include "mqtt.h"
 #include "bms.h"
+#include "bms_params.h"
+#include "bms_snapshot.h"
+#include "can_trace.h"
+#include "can_rec.h"
 #include "ecoflow.h"
+#include "tx_seq.h"
 
 // ----------------------------------------------------------------------------
 // WebSockets
@@ -33,6 +39,10 @@ static String jsonEscape(const String &s) {
   return out;
 }
 
+// Body of POST /api/can/txseq (AsyncWebServer delivers it in chunks)
+static char   txseqBody[TXSEQ_MAX_FILE];
+static size_t txseqBodyLen = 0;
+
 void setupServerRoutes(AsyncWebServer &server) {
 
   server.on("/api/wifi", HTTP_POST, [](AsyncWebServerRequest* r){
@@ -142,33 +152,146 @@ void setupServerRoutes(AsyncWebServer &server) {
 
   server.on("/api/bms", HTTP_GET, [](AsyncWebServerRequest *request) {
 
-    int soc = (int)  bms.get_state_of_charge();
-    float v = bms.get_voltage();
-    float c = bms.get_current();
-    float t = bms.get_ntc_temperature(0);
+    BmsSnapshot b;
+    bmsSnapshotGet(b);
 
-    uint16_t minMv = 0, maxMv = 0;
-    int n = (int) bms.get_num_cells();
+    String json = "{";
+    json += "\"soc\":" + String((int)b.bmsSoc) + ",";
+    json += "\"voltage\":" + String(b.bmsPackMv / 1000.0f, 3) + ",";
+    json += "\"current\":" + String(b.packMa / 1000.0f, 3) + ",";
+    json += "\"temperature\":" + String(b.ntcDeciC[0] / 10.0f, 1) + ",";
+    json += "\"min_cell_mv\":" + String(b.minCellMv) + ",";
+    json += "\"max_cell_mv\":" + String(b.maxCellMv) + ",";
+    json += "\"age_ms\":" + String(b.seq ? (unsigned long)(millis() - b.takenMs) : 0UL) + ",";
+
+    // Adaptive poll schedule; data_age_ms is the older of the two registers (-1 = not read yet)
+    BmsPollInfo p;
+    bmsPollInfoGet(p);
+    const uint32_t dataAge = bmsSnapshotDataAgeMs(b);
+    json += "\"data_age_ms\":" + (dataAge == UINT32_MAX ? String("-1") : String((unsigned long)dataAge)) + ",";
+    json += "\"basic_age_ms\":" + (b.basicMs ? String((unsigned long)(millis() - b.basicMs)) : String("-1")) + ",";
+    json += "\"cells_age_ms\":" + (b.cellsMs ? String((unsigned long)(millis() - b.cellsMs)) : String("-1")) + ",";
+    json += "\"basic_interval_ms\":" + String((unsigned long)p.basicIntervalMs) + ",";
+    json += "\"cells_interval_ms\":" + String((unsigned long)p.cellsIntervalMs) + ",";
+    json += "\"basic_polls\":" + String((unsigned long)p.basicPolls) + ",";
+    json += "\"cells_polls\":" + String((unsigned long)p.cellsPolls) + ",";
+    json += "\"basic_fails\":" + String((unsigned long)p.basicFails) + ",";
+    json += "\"cells_fails\":" + String((unsigned long)p.cellsFails) + ",";
+    json += "\"near_limit\":" + String(p.nearLimit ? "true" : "false") + ",";
+    json += "\"basic_rtt_us\":{\"last\":" + String((unsigned long)p.basicRttLastUs) +
+            ",\"avg\":" + String((unsigned long)p.basicRttAvgUs) +
+            ",\"max\":" + String((unsigned long)p.basicRttMaxUs) + "},";
+    json += "\"cells_rtt_us\":{\"last\":" + String((unsigned long)p.cellsRttLastUs) +
+            ",\"avg\":" + String((unsigned long)p.cellsRttAvgUs) +
+            ",\"max\":" + String((unsigned long)p.cellsRttMaxUs) + "},";
+    json += "\"round_us\":{\"last\":" + String((unsigned long)p.roundLastUs) +
+            ",\"max\":" + String((unsigned long)p.roundMaxUs) + "}";
+    json += "}";
 
-    for (int i = 1; i <= n; i++) {
-      float cv = bms.get_cell_voltage(i); // volts
-      uint16_t mv = (uint16_t) lround(cv * 1000.0f);
-      if (i == 1 || mv < minMv) minMv = mv;
-      if (mv > maxMv) maxMv = mv;
-    }
+    request->send(200, "application/json", json);
+  });
+
+  server.on("/api/bms_params", HTTP_GET, [](AsyncWebServerRequest *request) {
 
     String json = "{";
-    json += "\"soc\":" + String(soc) + ",";
-    json += "\"voltage\":" + String(v, 3) + ",";
-    json += "\"current\":" + String(c, 3) + ",";
-    json += "\"temperature\":" + String(t, 1) + ",";
-    json += "\"min_cell_mv\":" + String(minMv) + ",";
-    json += "\"max_cell_mv\":" + String(maxMv);
+    json += "\"valid\":" + String(bmsParamsValid ? "true" : "false") + ",";
+    // Values loaded from NVS have no known age: -1 with source "nvs"
+    const char* src = !bmsParamsValid ? "none" : (bmsParamsLoadedMs ? "bms" : "nvs");
+    json += "\"source\":\"" + String(src) + "\",";
+    json += "\"age_ms\":" + (bmsParamsLoadedMs ? String((unsigned long)(millis() - bmsParamsLoadedMs)) : String("-1")) + ",";
+    json += "\"refresh_pending\":" + String(bmsParamsRefreshPending() ? "true" : "false") + ",";
+    json += "\"full_charge_mv\":" + String((unsigned)bmsParams.fullChargeMv) + ",";
+    json += "\"empty_mv\":" + String((unsigned)bmsParams.emptyMv) + ",";
+    json += "\"design_cap_mah\":" + String((unsigned long)bmsParams.designCapMah) + ",";
+    json += "\"cycle_cap_mah\":" + String((unsigned long)bmsParams.cycleCapMah) + ",";
+    json += "\"cell_ov_mv\":" + String((unsigned)bmsParams.cellOvTrigMv) + ",";
+    json += "\"cell_uv_mv\":" + String((unsigned)bmsParams.cellUvTrigMv);
     json += "}";
 
     request->send(200, "application/json", json);
   });
 
+  // Refresh runs on the BMS task once the CAN bus is quiet; the factory-mode
+  // read must not block the web task or stall the BMS poll under load
+  server.on("/api/bms_params/refresh", HTTP_POST, [](AsyncWebServerRequest *request) {
+    bmsParamsRequestRefresh();
+    request->send(200, "application/json",
+                  String("{\"ok\":true,\"deferred\":") + (canHealth ? "true" : "false") + "}");
+  });
+
+  // Heartbeat reply latency: C4 END frame received -> first 3C frame handed to
+  // the driver (stamped in the canSubmit callback). last/avg/max_us and the
+  // bucket counts all measure up to that driver handoff.
+  server.on("/api/can/c4_latency", HTTP_GET, [](AsyncWebServerRequest *request) {
+    EcoflowLatency l;
+    ecoflowC4LatencyGet(l);
+
+    String json = "{";
+    json += "\"count\":" + String((unsigned long)l.count) + ",";
+    json += "\"last_us\":" + String((unsigned long)l.lastUs) + ",";
+    json += "\"avg_us\":" + String((unsigned long)l.avgUs) + ",";
+    json += "\"max_us\":" + String((unsigned long)l.maxUs) + ",";
+    json += "\"buckets\":[";
+    for (int i = 0; i < ECOFLOW_LAT_BUCKETS; i++) {
+      if (i) json += ",";
+      json += "{\"lt_us\":";
+      json += (i < ECOFLOW_LAT_BUCKETS - 1) ? String((unsigned long)ecoflowLatEdgesUs[i]) : String("null");
+      json += ",\"n\":" + String((unsigned long)l.hist[i]) + "}";
+    }
+    json += "]}";
+
+    request->send(200, "application/json", json);
+  });
+
+  // Sequencer step timing (µs): lateness vs. plan, send duration, frames queued
+  server.on("/api/can/seq_stats", HTTP_GET, [](AsyncWebServerRequest *request) {
+    String json;
+    ecoflowSeqStatsJson(json);
+    request->send(200, "application/json", json);
+  });
+
+  server.on("/api/can/seq_stats/reset", HTTP_POST, [](AsyncWebServerRequest *request) {
+    ecoflowSeqStatsReset();
+    request->send(200, "application/json", "{\"ok\":true}");
+  });
+
+  // TX sequence table: GET shows the active table, POST (raw JSON body, see
+  // tx_seq.h) validates + saves /txseq.json; the swap happens at the next cycle boundary
+  server.on("/api/can/txseq", HTTP_GET, [](AsyncWebServerRequest *request) {
+    String json;
+    ecoflowTxSeqJson(json);
+    request->send(200, "application/json", json);
+  });
+
+  server.on("/api/can/txseq", HTTP_POST,
+    [](AsyncWebServerRequest *request) {
+      String err;
+      bool ok = false;
+      if (txseqBodyLen == 0)                 err = "empty body";
+      else if (txseqBodyLen > TXSEQ_MAX_FILE) err = "file too large";
+      else ok = ecoflowTxSeqUpload(txseqBody, txseqBodyLen, err);
+      txseqBodyLen = 0;
+      if (ok) request->send(200, "application/json", "{\"ok\":true}");
+      else    request->send(400, "application/json", "{\"ok\":false,\"error\":\"" + jsonEscape(err) + "\"}");
+    },
+    nullptr,
+    [](AsyncWebServerRequest *request, uint8_t *data, size_t len, size_t index, size_t total) {
+      if (index == 0) txseqBodyLen = 0;
+      if (total > TXSEQ_MAX_FILE) { txseqBodyLen = total; return; }
+      memcpy(txseqBody + index, data, len);
+      txseqBodyLen = index + len;
+    });
+
+  server.on("/api/can/txseq/reload", HTTP_POST, [](AsyncWebServerRequest *request) {
+    bool ok = ecoflowTxSeqLoad();
+    request->send(ok ? 200 : 400, "application/json", ok ? "{\"ok\":true}" : "{\"ok\":false,\"builtin\":true}");
+  });
+
+  server.on("/api/can/txseq/builtin", HTTP_POST, [](AsyncWebServerRequest *request) {
+    ecoflowTxSeqUseBuiltin();
+    request->send(200, "application/json", "{\"ok\":true}");
+  });
+
   server.on("/api/net", HTTP_GET, [](AsyncWebServerRequest *request) {
 
     const bool staConnected = WiFi.isConnected();
@@ -336,7 +459,7 @@ static void wsAttachHandlers(const char* name, AsyncWebSocket& ws) {
 }
 
 // ----------------------------------------------------------------------------
-// Ring buffers (CAN + DEBUG)
+// Ring buffer (DEBUG text); CAN frames come from the binary trace (can_trace.h)
 // ----------------------------------------------------------------------------
 static constexpr size_t WSBUF_SZ       = 8192;     // per channel
 static constexpr size_t WSFLUSH_SLICE  = 1024;     // bytes per burst (tune)
@@ -360,10 +483,9 @@ struct WsRing {
   }
 };
 
-static WsRing ringCan, ringDbg;
+static WsRing ringDbg;
 
 static void wsbuf_init(){
-  ringCan.mtx = xSemaphoreCreateMutex();
   ringDbg.mtx = xSemaphoreCreateMutex();
 }
 
@@ -423,12 +545,46 @@ static void ws_flush_ring(AsyncWebSocket &ws, WsRing &rb){
   }
 }
 
+// Trace pump: the only consumer of the /log trace rings. candump text is built
+// here, off the CAN tasks; the recorder has its own rings (can_rec.h).
+static constexpr size_t TRACE_FLUSH_SLICE = 4096;   // bytes of candump text per flush
+
+static void ws_flush_trace(AsyncWebSocket &ws){
+  if (ws.count() == 0) { canTraceClear(); return; }
+
+  static uint32_t lastCleanup = 0;
+  uint32_t now = millis();
+  if (now - lastCleanup > 500) { ws.cleanupClients(); lastCleanup = now; }
+
+  static char out[TRACE_FLUSH_SLICE];
+  size_t used = 0;
+  CanTraceRec r;
+  while (used + 64 <= sizeof(out)) {       // leave the rest for the next flush
+    if (!canTracePop(r)) break;
+    size_t n = canTraceFormat(r, out + used, sizeof(out) - used - 1);
+    if (!n) continue;
+    used += n;
+    out[used++] = '\n';
+  }
+  if (used == 0) return;
+
+  if (auto *mb = ws.makeBuffer(used)) {
+    memcpy(mb->get(), out, used);
+    ws.textAll(mb);
+  } else {
+    ws.textAll(out, used);
+  }
+}
+
 // ----------------------------------------------------------------------------
 // Public logging APIs
 // ----------------------------------------------------------------------------
-void streamCanLog(const char* message) {
-  if (wsLog.count())
-    rb_enqueue_line(ringCan, message);
+bool webCanLogActive() {
+  return wsLog.count() > 0;
+}
+
+bool webDebugActive() {
+  return wsDebug.count() > 0;
 }
 
 void streamDebug(const char* message) {
@@ -446,12 +602,15 @@ static void sendBMSReadings() {
   if (!wsBms.availableForWriteAll()) return;
   #endif
 
-  const float voltage = bms.get_voltage();
-  const float current = bms.get_current();
-  const int   soc     = bms.get_state_of_charge();
-  const int   temp    = bms.get_ntc_temperature(0);
-  const int   chg     = (int)config.chgruntime;
-  const int   dis     = (int)config.disruntime;
+  BmsSnapshot b;
+  bmsSnapshotGet(b);
+
+  const float voltage = b.bmsPackMv / 1000.0f;
+  const float current = b.packMa / 1000.0f;
+  const int   soc     = b.bmsSoc;
+  const int   temp    = b.ntcDeciC[0] / 10;
+  const int   chg     = (int)b.chgRuntimeMin;
+  const int   dis     = (int)b.disRuntimeMin;
 
   char json[160];
   snprintf(json, sizeof(json),
@@ -498,7 +657,7 @@ void webTick() {
 
   if (now - lastFlush >= 50) {
     lastFlush = now;
-    ws_flush_ring(wsLog,   ringCan);
+    ws_flush_trace(wsLog);
     ws_flush_ring(wsDebug, ringDbg);
   }
 
@@ -535,21 +694,92 @@ void webSetupStaticRoutes(AsyncWebServer& server) {
 
   // CAN stats
   server.on("/can_stats", HTTP_GET, [](AsyncWebServerRequest* r){
-    twai_status_info_t st; 
-    twai_get_status_info(&st);
+    CanTransportStatus st = {};
+    CanTransport* bus = canGetTransport();
+    if (bus && twai_ok) bus->status(st);
 
     char buf[256];
     snprintf(buf, sizeof(buf),
-      "rx_cnt=%lu\nrx_sw_drop=%lu\ndecoded=%lu\nrx_missed=%u\nrx_overrun=%u\nstate=%d\n",
+      "transport=%s\nrx_cnt=%lu\nrx_sw_drop=%lu\ndecoded=%lu\nrx_missed=%lu\nrx_overrun=%lu\nstate=%d\n",
+      bus ? bus->name() : "none",
       (unsigned long)can_rx_count, 
       (unsigned long)can_rx_dropped, 
       (unsigned long)can_decoded,
-      st.rx_missed_count, 
-      st.rx_overrun_count, 
+      (unsigned long)st.rxMissed, 
+      (unsigned long)st.rxOverrun, 
       st.state
     );
 
-    r->send(200, "text/plain", buf);
+    String out = buf;
+
+    snprintf(buf, sizeof(buf), "filter=%s\n", canFilterPromiscuous() ? "promiscuous" : "consumed_ids");
+    out += buf;
+
+    snprintf(buf, sizeof(buf), "rx_ring_depth=%lu\nrx_ring_hiwat=%lu/%u\n",
+      (unsigned long)canRxRingDepth(), (unsigned long)canRxRingHighWater(), (unsigned)CAN_RX_RING);
+    out += buf;
+
+    snprintf(buf, sizeof(buf), "trace_depth=%lu\ntrace_drops=%lu\n",
+      (unsigned long)canTraceDepth(), (unsigned long)canTraceDrops());
+    out += buf;
+
+    snprintf(buf, sizeof(buf),
+      "alert_wakeups=%lu\nalert_overrun=%lu\nbus_err=%lu\nerr_passive=%lu\nbus_off=%lu\nbus_recovered=%lu\ntx_failed=%lu\n",
+      (unsigned long)can_alert_wakeups,
+      (unsigned long)can_rx_overruns,
+      (unsigned long)can_bus_errors,
+      (unsigned long)can_err_passive,
+      (unsigned long)can_bus_off,
+      (unsigned long)can_bus_recovered,
+      (unsigned long)can_tx_failed
+    );
+    out += buf;
+
+    snprintf(buf, sizeof(buf), "rx_streams=%u\nrx_slot_steals=%lu\nrx_timeouts=%lu\nevict_late_ms=last:%lu,max:%lu\n",
+      (unsigned)ecoflowRxActiveStreams(),
+      (unsigned long)ecoflowRxSlotSteals(),
+      (unsigned long)ecoflowRxTimeouts(),
+      (unsigned long)ecoflowRxEvictLatLastMs(),
+      (unsigned long)ecoflowRxEvictLatMaxMs());
+    out += buf;
+
+    CanTxStats tx;
+    canTxGetStats(tx);
+    for (int p = 0; p < 2; p++) {
+      snprintf(buf, sizeof(buf), "tx_%s=depth:%lu,submitted:%lu,rejected:%lu,wait_us:last:%lu,avg:%lu,max:%lu\n",
+        p == CAN_TX_HIGH ? "high" : "normal",
+        (unsigned long)tx.depth[p], (unsigned long)tx.submitted[p], (unsigned long)tx.rejected[p],
+        (unsigned long)tx.waitLastUs[p], (unsigned long)tx.waitAvgUs[p], (unsigned long)tx.waitMaxUs[p]);
+      out += buf;
+    }
+    snprintf(buf, sizeof(buf), "tx_sent=%lu\ntx_msg_failed=%lu\n", (unsigned long)tx.sent, (unsigned long)tx.failed);
+    out += buf;
+
+    // 14001 handler dispatch
+    snprintf(buf, sizeof(buf), "unhandled=%lu\n", (unsigned long)ecoflowUnhandledCount());
+    out += buf;
+    for (size_t i = 0; i < ecoflowHandlerCount(); i++) {
+      EcoflowHandlerInfo h;
+      if (!ecoflowHandlerInfo(i, h)) break;
+      char trk[8];
+      if (h.tracker == ECOFLOW_ANY_TRACKER) strcpy(trk, "any");
+      else snprintf(trk, sizeof(trk), "%04X", (unsigned)h.tracker);
+      snprintf(buf, sizeof(buf), "h_%s=type:%02X,trk:%s,calls:%lu,avg_us:%lu,max_us:%lu\n",
+        h.name, h.type, trk, (unsigned long)h.calls,
+        (unsigned long)(h.calls ? h.totalUs / h.calls : 0), (unsigned long)h.maxUs);
+      out += buf;
+    }
+
+    // 14001 CRC verdicts, only for types seen
+    for (int t = 0; t < 256; t++) {
+      uint32_t ok = ecoflowRxCrcOk((uint8_t)t);
+      uint32_t bad = ecoflowRxCrcFail((uint8_t)t);
+      if (!ok && !bad) continue;
+      snprintf(buf, sizeof(buf), "crc_%02X=ok:%lu,fail:%lu\n", t, (unsigned long)ok, (unsigned long)bad);
+      out += buf;
+    }
+
+    r->send(200, "text/plain", out);
   });
 
   // Try late CAN init
@@ -656,6 +886,7 @@ void webSetupStaticRoutes(AsyncWebServer& server) {
     if (touchedSerial || touchedChgVolt) {
       saveCoreConfig();
     }
+    bmsSnapshotRequestRebuild();   // manual values reach the CAN payloads via the snapshot
 
     Serial.printf(
       "Updated via POST → volt=%u mV, chgvolt=%u mV, temp=%d C, soc=%u%%, chg=%u min, dis=%u min\n",
@@ -0,0 +1,288 @@
+// Host test of the bms2 request engine against a simulated JBD BMS on RS485.
+//
+//   pio run -e native_bmsasync && .pio/build/native_bmsasync/program [options]
+//
+//   -d S            virtual seconds per mode (default 60)
+//   --drop N        the BMS ignores every Nth request (timeouts / resends)
+//   --corrupt N     every Nth reply has a broken checksum (NAK path)
+//   --turnaround US BMS think time between request stop byte and reply (default 3000)
+//   -v              print every completed poll
+//
+// Runs the same 1 s poll twice on a virtual clock, with loop() modelled as a
+// 1 ms spin:
+//   blocking   query_0x03_basic_info() + query_0x04_cell_voltages(), as the
+//              sketch did before the engine (delay(10) loops inside loop())
+//   async      queue_read() 0x03/0x04 + async_task() every pass
+// Bytes move at 9600 8N1 (1042 µs each) and the bus is half-duplex: a request
+// written while a reply is on the wire counts as a collision. Loop time is
+// virtual time spent inside the call plus the host CPU time of the call.
+// Exit status 1 unless the async worst case stays under 1 ms with every poll
+// decoded and no collisions.
+#include "Arduino.h"
+#include "bms2.h"
+
+#include <chrono>
+#include <deque>
+#include <vector>
+
+HostSerial Serial;
+
+static uint64_t clockUs = 0;
+static bool     verbose = false;
+
+uint32_t millis() { return (uint32_t)(clockUs / 1000); }
+uint32_t micros() { return (uint32_t)clockUs; }
+void     delay(uint32_t ms) { clockUs += (uint64_t)ms * 1000; }
+
+void HostSerial::printf(const char* fmt, ...) {
+  if (!verbose) return;
+  va_list ap;
+  va_start(ap, fmt);
+  vprintf(fmt, ap);
+  va_end(ap);
+}
+
+#define BYTE_US 1042
+
+// ---------------- Simulated BMS on the other end of the wire ----------------
+static const uint8_t  SIM_CELLS = 8;
+static const uint8_t  SIM_NTCS  = 2;
+static const uint16_t SIM_CELL_MV[SIM_CELLS] = { 3301, 3305, 3299, 3310, 3302, 3298, 3307, 3303 };
+static const uint16_t SIM_PACK_10MV = 2642;     // 26.42 V
+static const int16_t  SIM_CURRENT_10MA = -1250; // -12.50 A
+
+class SimBms : public Stream {
+public:
+  uint32_t turnaroundUs = 3000;
+  uint32_t dropEvery = 0, corruptEvery = 0;
+  uint32_t requests = 0, replies = 0, collisions = 0;
+
+  int available() override {
+    int n = 0;
+    for (const auto& b : rx) { if (b.atUs > clockUs) break; n++; }
+    return n;
+  }
+  int read() override {
+    if (rx.empty() || rx.front().atUs > clockUs) return -1;
+    int c = rx.front().c;
+    rx.pop_front();
+    return c;
+  }
+  int peek() override {
+    if (rx.empty() || rx.front().atUs > clockUs) return -1;
+    return rx.front().c;
+  }
+  // The library flushes before reading: bytes already handed over keep
+  // their wire times, so there is nothing to wait for here
+  void flush() override {}
+
+  size_t write(const uint8_t* buf, size_t n) override {
+    for (size_t i = 0; i < n; i++) write(buf[i]);
+    return n;
+  }
+  size_t write(uint8_t c) override {
+    // Half-duplex: talking over a reply that is still arriving
+    if (!rx.empty() && rx.back().atUs > clockUs) collisions++;
+    uint64_t start = txFreeUs > clockUs ? txFreeUs : clockUs;
+    txFreeUs = start + BYTE_US;
+    req.push_back(c);
+    if (c == BMS_STOPBYTE && req.size() >= 7 && req[0] == BMS_STARTBYTE && req.size() == (size_t)(7 + req[3])) {
+      onRequest();
+      req.clear();
+    }
+    else if (req.size() > 16) {
+      req.clear();
+    }
+    return 1;
+  }
+
+private:
+  struct RxByte { uint8_t c; uint64_t atUs; };
+  std::deque<RxByte>   rx;
+  std::vector<uint8_t> req;
+  uint64_t             txFreeUs = 0;
+
+  void onRequest() {
+    requests++;
+    if (dropEvery && requests % dropEvery == 0) return;
+
+    const uint8_t cmd = req[2];
+    std::vector<uint8_t> data;
+    uint8_t status = 0x00;
+    if (cmd == BMS_REG_BASIC_SYSTEM_INFO) {
+      data.assign(23 + 2 * SIM_NTCS, 0);
+      data[0] = SIM_PACK_10MV >> 8;   data[1] = SIM_PACK_10MV & 0xFF;
+      data[2] = (uint16_t)SIM_CURRENT_10MA >> 8; data[3] = (uint16_t)SIM_CURRENT_10MA & 0xFF;
+      data[4] = 0x27; data[5] = 0x10;   // 100.00 Ah
+      data[6] = 0x27; data[7] = 0x10;
+      data[19] = 80;                    // SOC
+      data[20] = 0x03;                  // both FETs on
+      data[21] = SIM_CELLS;
+      data[22] = SIM_NTCS;
+      for (uint8_t i = 0; i < SIM_NTCS; i++) { data[23 + 2 * i] = 0x0B; data[24 + 2 * i] = 0xB9; }  // 27.0 C
+    }
+    else if (cmd == BMS_REG_CELL_VOLTAGES) {
+      for (uint8_t i = 0; i < SIM_CELLS; i++) { data.push_back(SIM_CELL_MV[i] >> 8); data.push_back(SIM_CELL_MV[i] & 0xFF); }
+    }
+    else {
+      status = 0x80;
+    }
+
+    uint16_t sum = status + (uint8_t)data.size();
+    for (uint8_t b : data) sum += b;
+    uint16_t csum = (uint16_t)(0x10000UL - sum);
+    replies++;
+    if (corruptEvery && replies % corruptEvery == 0) csum ^= 0x0101;
+
+    std::vector<uint8_t> frame = { BMS_STARTBYTE, cmd, status, (uint8_t)data.size() };
+    frame.insert(frame.end(), data.begin(), data.end());
+    frame.push_back(csum >> 8);
+    frame.push_back(csum & 0xFF);
+    frame.push_back(BMS_STOPBYTE);
+
+    uint64_t t = txFreeUs + turnaroundUs;
+    for (uint8_t b : frame) { t += BYTE_US; rx.push_back({ b, t }); }
+  }
+};
+
+// ---------------- One run ----------------
+struct RunStats {
+  uint32_t polls = 0, okPolls = 0, badValues = 0;
+  uint64_t loops = 0;
+  uint64_t worstVirtUs = 0, worstCpuNs = 0, worstLoopUs = 0;
+  uint64_t totalVirtUs = 0;
+  uint32_t rttMaxUs[2] = {0, 0};
+  uint64_t rttSumUs[2] = {0, 0};
+  uint32_t rttCount[2] = {0, 0};
+};
+
+static OverkillSolarBms2* cur = nullptr;
+static RunStats*          st  = nullptr;
+static bool               pollOk03 = false;
+
+static bool valuesMatch(OverkillSolarBms2& b) {
+  if (b.get_num_cells() != SIM_CELLS) return false;
+  if (lroundf(b.get_voltage() * 100) != SIM_PACK_10MV) return false;
+  if (lroundf(b.get_current() * 100) != SIM_CURRENT_10MA) return false;
+  for (uint8_t i = 0; i < SIM_CELLS; i++)
+    if (lroundf(b.get_cell_voltage(i) * 1000) != SIM_CELL_MV[i]) return false;
+  return true;
+}
+
+static void noteRtt(int idx) {
+  uint32_t rtt = cur->async_rtt_us();
+  if (rtt > st->rttMaxUs[idx]) st->rttMaxUs[idx] = rtt;
+  st->rttSumUs[idx] += rtt;
+  st->rttCount[idx]++;
+}
+
+static void on03(uint8_t, bool ok) {
+  pollOk03 = ok;
+  if (ok) noteRtt(0);
+}
+
+static void on04(uint8_t, bool ok) {
+  st->polls++;
+  if (ok) noteRtt(1);
+  if (ok && pollOk03) {
+    st->okPolls++;
+    if (!valuesMatch(*cur)) st->badValues++;
+  }
+  if (verbose) ::printf("  %8.3f s  poll %s\n", clockUs / 1e6, ok && pollOk03 ? "ok" : "FAILED");
+}
+
+static void run(bool async, double seconds, SimBms& sim, RunStats& s) {
+  OverkillSolarBms2 bms;
+  bms.begin(&sim);
+  cur = &bms;
+  st  = &s;
+
+  const uint64_t endUs = clockUs + (uint64_t)(seconds * 1e6);
+  uint32_t lastPoll = millis() - 1000;
+
+  while (clockUs < endUs) {
+    const uint64_t v0 = clockUs;
+    const auto     c0 = std::chrono::steady_clock::now();
+
+    if (async) {
+      bms.async_task();
+      if (millis() - lastPoll >= 1000 && !bms.async_busy()) {
+        lastPoll = millis();
+        bms.queue_read(BMS_REG_BASIC_SYSTEM_INFO, on03);
+        bms.queue_read(BMS_REG_CELL_VOLTAGES, on04);
+      }
+    }
+    else if (millis() - lastPoll >= 1000) {
+      lastPoll = millis();
+      bms.query_0x03_basic_info();
+      const bool ok03 = bms.get_state_of_charge() != 0;
+      bms.query_0x04_cell_voltages();
+      s.polls++;
+      if (ok03 && bms.get_cell_voltage(0) > 0) {
+        s.okPolls++;
+        if (!valuesMatch(bms)) s.badValues++;
+      }
+    }
+
+    const uint64_t cpuNs = (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - c0).count();
+    const uint64_t virtUs = clockUs - v0;
+    const uint64_t loopUs = virtUs + cpuNs / 1000;
+    if (virtUs > s.worstVirtUs) s.worstVirtUs = virtUs;
+    if (cpuNs  > s.worstCpuNs)  s.worstCpuNs  = cpuNs;
+    if (loopUs > s.worstLoopUs) s.worstLoopUs = loopUs;
+    s.totalVirtUs += virtUs;
+    s.loops++;
+
+    clockUs += 1000;    // rest of loop(): web, MQTT, ...
+  }
+}
+
+static void report(const char* name, const RunStats& s, const SimBms& sim) {
+  ::printf("%-9s polls %u ok %u bad-values %u | loop worst %llu us (virtual %llu us + cpu %.1f us), blocked %.2f%% | requests %u collisions %u\n",
+           name, s.polls, s.okPolls, s.badValues,
+           (unsigned long long)s.worstLoopUs, (unsigned long long)s.worstVirtUs, s.worstCpuNs / 1000.0,
+           s.loops ? 100.0 * s.totalVirtUs / (s.totalVirtUs + s.loops * 1000.0) : 0.0,
+           sim.requests, sim.collisions);
+}
+
+int main(int argc, char** argv) {
+  double   seconds = 60;
+  uint32_t drop = 0, corrupt = 0, turnaround = 3000;
+  for (int i = 1; i < argc; i++) {
+    const char* a = argv[i];
+    const char* v = (i + 1 < argc) ? argv[i + 1] : nullptr;
+    if      (!strcmp(a, "-v"))                    verbose = true;
+    else if (!strcmp(a, "-d") && v)               { seconds = atof(v); i++; }
+    else if (!strcmp(a, "--drop") && v)           { drop = strtoul(v, nullptr, 0); i++; }
+    else if (!strcmp(a, "--corrupt") && v)        { corrupt = strtoul(v, nullptr, 0); i++; }
+    else if (!strcmp(a, "--turnaround") && v)     { turnaround = strtoul(v, nullptr, 0); i++; }
+    else {
+      ::printf("usage: %s [-d S] [--drop N] [--corrupt N] [--turnaround US] [-v]\n", argv[0]);
+      return !strcmp(a, "-h") || !strcmp(a, "--help") ? 0 : 2;
+    }
+  }
+
+  SimBms   simBlocking, simAsync;
+  RunStats blocking, async;
+  for (SimBms* s : { &simBlocking, &simAsync }) {
+    s->turnaroundUs = turnaround;
+    s->dropEvery    = drop;
+    s->corruptEvery = corrupt;
+  }
+
+  clockUs = 1000000;
+  run(false, seconds, simBlocking, blocking);
+  run(true,  seconds, simAsync,    async);
+
+  report("blocking", blocking, simBlocking);
+  report("async",    async,    simAsync);
+  ::printf("async rtt us    : 0x03 avg %llu max %u | 0x04 avg %llu max %u\n",
+           (unsigned long long)(async.rttCount[0] ? async.rttSumUs[0] / async.rttCount[0] : 0), async.rttMaxUs[0],
+           (unsigned long long)(async.rttCount[1] ? async.rttSumUs[1] / async.rttCount[1] : 0), async.rttMaxUs[1]);
+
+  bool pass = async.worstLoopUs < 1000 && async.badValues == 0 && simAsync.collisions == 0 && async.okPolls > 0;
+  if (!drop && !corrupt) pass = pass && async.okPolls == async.polls;
+  ::printf("%s\n", pass ? "PASS" : "FAIL");
+  return pass ? 0 : 1;
+}
@@ -0,0 +1,288 @@
+// Host benchmark / fuzzer for the whole CAN stack through CanTransport.
+//
+//   pio run -e native_canbench && .pio/build/native_canbench/program [options]
+//
+//   (default)              loopback: a generator port feeds can.cpp, which runs
+//                          canRxPoll -> canDecodePoll -> processEcoFlowCAN ->
+//                          canSubmit -> canTxPoll back onto the bus
+//   --fuzz SEED            random frames (14001 IDs, other families, bad DLCs,
+//                          absurd lengths, broken CRCs) instead of valid traffic
+//   --udp-bridge L:P       run only the bridge side on UDP port L, peer on P
+//   --udp-peer L:P         run only the generator side over UDP
+//   -n FRAMES / -d S       stop after this many generated frames / seconds
+//
+// Single-threaded: the task bodies are called in turn, so numbers are the
+// stack's own cost per frame with no scheduler in between. Build with
+// -fsanitize=address,undefined added to build_flags for fuzzing runs.
+#include <Arduino.h>
+#include <chrono>
+#include <random>
+#include <vector>
+
+#include "can.h"
+#include "can_transport.h"
+#include "can_loopback.h"
+#include "can_udp.h"
+#include "ecoflow.h"
+#include "bms_params.h"
+#include "crc16.h"
+#include "reassembler.h"
+#include "can_trace.h"
+#include "can_rec.h"
+#include "web.h"
+#include <SPIFFS.h>
+
+// ---------------- Host stubs for the firmware globals ----------------
+Config    config;
+bool      canHealth = false;
+BmsParams bmsParams;
+bool      bmsParamsValid    = false;
+uint32_t  bmsParamsLoadedMs = 0;
+HostSerial Serial;
+fs::FS     SPIFFS;
+
+static bool verbose = false;
+static const auto clock0 = std::chrono::steady_clock::now();
+
+static uint64_t hostUs() {
+  return (uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(
+      std::chrono::steady_clock::now() - clock0).count();
+}
+uint32_t millis()             { return (uint32_t)(hostUs() / 1000); }
+uint32_t micros()             { return (uint32_t)hostUs(); }
+int64_t  esp_timer_get_time() { return (int64_t)hostUs(); }
+
+void HostSerial::printf(const char* fmt, ...) {
+  if (!verbose) return;
+  va_list ap;
+  va_start(ap, fmt);
+  vprintf(fmt, ap);
+  va_end(ap);
+}
+
+bool webCanLogActive() { return false; }
+bool webDebugActive()  { return false; }
+void streamDebug(const char*) {}
+bool canTraceOn(CanTraceDir) { return false; }
+void canTraceRecord(CanTraceDir, uint32_t, uint32_t, const uint8_t*, uint8_t) {}
+bool canRecActive() { return false; }
+
+// ---------------- Traffic ----------------
+// A PowerStream-style message split into 14001 frames
+static void buildMessage(uint8_t type, uint16_t tracker, const uint8_t* pl, uint16_t len,
+                         uint8_t key, bool badCrc, std::vector<CanFrame>& out) {
+  std::vector<uint8_t> wire(REASM_HDR_LEN + len + 2);
+  memcpy(wire.data(), header_C4, REASM_HDR_LEN);
+  wire[2]  = (uint8_t)(len & 0xFF);
+  wire[3]  = (uint8_t)(len >> 8);
+  wire[4]  = type;
+  wire[6]  = key;
+  wire[16] = (uint8_t)(tracker >> 8);
+  wire[17] = (uint8_t)(tracker & 0xFF);
+  for (uint16_t i = 0; i < len; i++) wire[REASM_HDR_LEN + i] = pl[i] ^ key;
+  uint16_t crc = crc16_update_xor(crc16_update(crc16_init(), wire.data(), REASM_HDR_LEN), pl, len, key);
+  if (badCrc) crc ^= 0x8000;
+  wire[REASM_HDR_LEN + len]     = (uint8_t)(crc & 0xFF);
+  wire[REASM_HDR_LEN + len + 1] = (uint8_t)(crc >> 8);
+
+  for (size_t pos = 0, idx = 0; pos < wire.size(); idx++) {
+    size_t remain = wire.size() - pos;
+    CanFrame f = {};
+    f.dlc   = remain > 8 ? 8 : (uint8_t)remain;
+    f.id    = (idx == 0) ? MSG14001_START_ID : (remain <= 8 ? MSG14001_END_ID : MSG14001_MID_ID);
+    f.flags = CAN_FRAME_EXTD;
+    memcpy(f.data, &wire[pos], f.dlc);
+    out.push_back(f);
+    pos += f.dlc;
+  }
+}
+
+// One round of valid traffic: heartbeat, both DE requests, both CB writes
+static void buildValidRound(uint8_t key, std::vector<CanFrame>& out) {
+  uint8_t c4[69] = {0};
+  memcpy(&c4[3], "HW51ZEH4SF123456", 16);
+  uint8_t de[4] = {0};
+  uint8_t cb[1] = { (uint8_t)(50 + key % 50) };
+  buildMessage(0xC4, 0x0302, c4, sizeof(c4), key, false, out);
+  buildMessage(0xDE, 0x0105, de, sizeof(de), key + 1, false, out);
+  buildMessage(0xDE, 0x0141, de, sizeof(de), key + 2, false, out);
+  buildMessage(0xCB, 0x2031, cb, sizeof(cb), key + 3, false, out);
+  buildMessage(0xCB, 0x2033, cb, sizeof(cb), key + 4, false, out);
+}
+
+static void buildFuzzRound(std::mt19937& rng, std::vector<CanFrame>& out) {
+  static const uint32_t ids[] = {
+    MSG14001_START_ID, MSG14001_MID_ID, MSG14001_END_ID,
+    0x10004001, 0x10104001, 0x10204001, 0x10304001, 0x10003001, 0x00000123, 0x1FFFFFFF
+  };
+  auto r = [&](uint32_t n) { return (uint32_t)(rng() % n); };
+
+  switch (r(4)) {
+    case 0: {   // valid or CRC-broken message of random type/length
+      std::vector<uint8_t> pl(r(300));
+      for (auto& b : pl) b = (uint8_t)rng();
+      buildMessage((uint8_t)rng(), (uint16_t)rng(), pl.data(), (uint16_t)pl.size(), (uint8_t)rng(), r(2), out);
+      break;
+    }
+    case 1: {   // valid message cut short or with frames dropped
+      std::vector<CanFrame> m;
+      uint8_t pl[69] = {0};
+      buildMessage(0xC4, 0x0302, pl, sizeof(pl), (uint8_t)rng(), false, m);
+      for (auto& f : m) if (r(4)) out.push_back(f);
+      break;
+    }
+    default: {  // raw frames
+      for (uint32_t i = 0, n = 1 + r(16); i < n; i++) {
+        CanFrame f = {};
+        f.id    = ids[r(sizeof(ids) / sizeof(ids[0]))];
+        f.dlc   = (uint8_t)r(9);
+        f.flags = CAN_FRAME_EXTD | (r(32) ? 0 : CAN_FRAME_RTR);
+        for (auto& b : f.data) b = (uint8_t)rng();
+        if (f.id == MSG14001_START_ID && f.dlc >= 4 && r(2)) {
+          f.data[0] = 0xAA;                     // plausible header with a wild length
+          f.data[2] = (uint8_t)rng();
+          f.data[3] = (uint8_t)r(16);
+        }
+        out.push_back(f);
+      }
+    }
+  }
+}
+
+// ---------------- Bridge side ----------------
+static void bridgeInit(CanTransport& t) {
+  ecoflowHandlersInit();
+  ecoflowMessagesInit();
+  ecoflowTxSeqLoad();
+  canSetTransport(&t);
+  if (!canTryInitAndStart()) {
+    fprintf(stderr, "transport %s failed to start\n", t.name());
+    exit(2);
+  }
+}
+
+// One pass of every CAN task plus the sequencer
+static void bridgeStep(uint32_t waitMs) {
+  canRxPoll(waitMs);
+  canDecodePoll();
+  ecoflowSequencerService();
+  canTxPoll();
+}
+
+static void printBridgeStats(double wallS, uint64_t genFrames, uint64_t replyFrames) {
+  CanTxStats tx;
+  canTxGetStats(tx);
+  ::printf("frames in       : %llu generated, %u received, %u decoded, %u ring drops\n",
+           (unsigned long long)genFrames, can_rx_count, can_decoded, can_rx_dropped);
+  ::printf("throughput      : %.3f s -> %.0f frames/s (%.0f ns/frame)\n", wallS,
+           wallS > 0 ? can_decoded / wallS : 0.0, can_decoded ? wallS * 1e9 / can_decoded : 0.0);
+  ::printf("tx              : %u msgs sent, %u failed, rejected high=%u normal=%u, %llu frames seen by peer\n",
+           tx.sent, tx.failed, tx.rejected[CAN_TX_HIGH], tx.rejected[CAN_TX_NORMAL],
+           (unsigned long long)replyFrames);
+  uint32_t ok = 0, bad = 0;
+  for (int t = 0; t < 256; t++) { ok += ecoflowRxCrcOk((uint8_t)t); bad += ecoflowRxCrcFail((uint8_t)t); }
+  ::printf("decoder         : crc ok=%u fail=%u, timeouts=%u, steals=%u, unhandled=%u\n",
+           ok, bad, ecoflowRxTimeouts(), ecoflowRxSlotSteals(), ecoflowUnhandledCount());
+  EcoflowHandlerInfo h;
+  for (size_t i = 0; ecoflowHandlerInfo(i, h); i++)
+    ::printf("  %-16s %u\n", h.name, h.calls);
+}
+
+// ---------------- Main ----------------
+static bool parsePorts(const char* s, uint16_t& l, uint16_t& p) {
+  unsigned a, b;
+  if (sscanf(s, "%u:%u", &a, &b) != 2 || !a || !b || a > 65535 || b > 65535) return false;
+  l = (uint16_t)a; p = (uint16_t)b;
+  return true;
+}
+
+int main(int argc, char** argv) {
+  uint64_t maxFrames = 2000000;
+  double   maxSec    = 0;
+  bool     fuzz = false, udpBridge = false, udpPeer = false;
+  uint32_t seed = 1;
+  uint16_t lport = 0, pport = 0;
+
+  for (int i = 1; i < argc; i++) {
+    const char* a = argv[i];
+    const char* v = (i + 1 < argc) ? argv[i + 1] : nullptr;
+    if      (!strcmp(a, "-v"))                      verbose = true;
+    else if (!strcmp(a, "-n") && v)                 { maxFrames = strtoull(v, nullptr, 10); i++; }
+    else if (!strcmp(a, "-d") && v)                 { maxSec = atof(v); i++; }
+    else if (!strcmp(a, "--fuzz") && v)             { fuzz = true; seed = strtoul(v, nullptr, 0); i++; }
+    else if (!strcmp(a, "--udp-bridge") && v && parsePorts(v, lport, pport)) { udpBridge = true; i++; }
+    else if (!strcmp(a, "--udp-peer") && v && parsePorts(v, lport, pport))   { udpPeer = true; i++; }
+    else {
+      ::printf("usage: %s [-n FRAMES] [-d S] [--fuzz SEED] [--udp-bridge L:P | --udp-peer L:P] [-v]\n", argv[0]);
+      return !strcmp(a, "-h") || !strcmp(a, "--help") ? 0 : 2;
+    }
+  }
+  if (maxSec <= 0 && (udpBridge || udpPeer)) maxSec = 10;
+
+  std::mt19937 rng(seed);
+  std::vector<CanFrame> round;
+  uint8_t key = 0;
+  auto nextRound = [&]() {
+    round.clear();
+    if (fuzz) buildFuzzRound(rng, round);
+    else      buildValidRound(key += 5, round);
+  };
+  auto timeUp = [&](uint64_t frames, std::chrono::steady_clock::time_point t0) {
+    if (maxSec > 0) return std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count() >= maxSec;
+    return frames >= maxFrames;
+  };
+
+  // ---- Bridge alone on UDP: serve until the time is up ----
+  if (udpBridge) {
+    static CanUdpTransport udp(lport, pport);
+    bridgeInit(udp);
+    auto t0 = std::chrono::steady_clock::now();
+    while (!timeUp(0, t0)) bridgeStep(10);
+    printBridgeStats(std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count(), 0, 0);
+    return 0;
+  }
+
+  // ---- Generator alone on UDP ----
+  if (udpPeer) {
+    CanUdpTransport udp(lport, pport);
+    if (!udp.start(canFilterAll())) { fprintf(stderr, "udp start failed\n"); return 2; }
+    uint64_t sent = 0, replies = 0;
+    CanFrame f;
+    auto t0 = std::chrono::steady_clock::now();
+    while (!timeUp(sent, t0)) {
+      nextRound();
+      for (const CanFrame& g : round) if (udp.send(g, 100)) sent++;
+      while (udp.wait(0) && udp.receive(f)) replies++;
+    }
+    while (udp.wait(200)) while (udp.receive(f)) replies++;
+    double s = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+    ::printf("udp peer        : %llu frames sent (%.0f/s), %llu frames back\n",
+             (unsigned long long)sent, s > 0 ? sent / s : 0.0, (unsigned long long)replies);
+    return 0;
+  }
+
+  // ---- Both sides in one process over the loopback bus ----
+  static CanLoopbackBus bus;
+  CanLoopbackPort& peer = bus.b();
+  peer.start(canFilterAll());
+  bridgeInit(bus.a());
+
+  uint64_t gen = 0, replies = 0;
+  CanFrame f;
+  auto t0 = std::chrono::steady_clock::now();
+  while (!timeUp(gen, t0)) {
+    // Batches stay well inside the bridge's RX ring, so the numbers are not about drops
+    for (uint32_t batch = 0; batch < 96; ) {
+      nextRound();
+      for (const CanFrame& g : round) { peer.send(g, 0); batch++; }
+      gen += round.size();
+    }
+    bridgeStep(0);
+    while (peer.receive(f)) replies++;
+  }
+  double wallS = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+
+  printBridgeStats(wallS, gen, replies);
+  if (fuzz) ::printf("fuzz seed       : %u (no crash)\n", seed);
+  return 0;
+}
@@ -0,0 +1,149 @@
+// Host benchmark of the CRC16 in crc16.cpp against the byte-wise routine it replaced.
+//
+//   pio run -e native_crcbench && .pio/build/native_crcbench/program [-n MSGS] [-l LEN]
+//   (add -DCRC16_SLICE=1 / 8 to build_flags to measure the other table variants)
+//
+// Per message (default 150 bytes, the size of a 0x13 reply): an 18-byte
+// header plus an XOR-encoded payload, CRC'd the way the TX path does it.
+//   old        encode payload into a buffer, copy header + payload into
+//              crc_buf, byte-wise table CRC (sendCANMessage before crc16.cpp)
+//   new        crc16_update(header) + crc16_update_xor(payload, key), no copies
+//   raw old/new  the bare CRC over a contiguous buffer, no encode/copy
+// Every variant is checked against a bitwise reference first. Host numbers
+// are relative: the ESP32 pays more per table lookup from flash.
+#include <Arduino.h>
+#include <chrono>
+#include <random>
+#include <vector>
+
+#include "crc16.h"
+
+HostSerial Serial;
+uint32_t millis() { return 0; }
+uint32_t micros() { return 0; }
+void     delay(uint32_t) {}
+
+// ---------------- References ----------------
+static uint16_t crcBitwise(const uint8_t* d, size_t len) {
+  uint16_t crc = 0;
+  while (len--) {
+    crc ^= *d++;
+    for (int i = 0; i < 8; i++) crc = (crc & 1) ? (crc >> 1) ^ 0xA001 : crc >> 1;
+  }
+  return crc;
+}
+
+// The pre-crc16.cpp routine, table built from the same polynomial
+static uint16_t oldTable[256];
+static void oldTableInit() {
+  for (int b = 0; b < 256; b++) {
+    uint16_t c = (uint16_t)b;
+    for (int i = 0; i < 8; i++) c = (c & 1) ? (c >> 1) ^ 0xA001 : c >> 1;
+    oldTable[b] = c;
+  }
+}
+static uint16_t crcOld(const uint8_t* data, uint16_t len) {
+  uint16_t crc = 0;
+  for (uint16_t i = 0; i < len; i++) crc = oldTable[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+  return crc;
+}
+
+// Old send path: encode, copy into crc_buf, CRC
+static uint16_t oldMessageCrc(const uint8_t* header, const uint8_t* payload, size_t payloadLen, uint8_t key) {
+  uint8_t encoded[512];
+  uint8_t crcBuf[512 + 18];
+  for (size_t i = 0; i < payloadLen; i++) encoded[i] = payload[i] ^ key;
+  memcpy(crcBuf, header, 18);
+  memcpy(crcBuf + 18, encoded, payloadLen);
+  return crcOld(crcBuf, (uint16_t)(18 + payloadLen));
+}
+
+static uint16_t newMessageCrc(const uint8_t* header, const uint8_t* payload, size_t payloadLen, uint8_t key) {
+  return crc16_update_xor(crc16_update(crc16_init(), header, 18), payload, payloadLen, key);
+}
+
+// ---------------- Checks ----------------
+static bool selfCheck(std::mt19937& rng) {
+  std::vector<uint8_t> buf(600);
+  for (auto& b : buf) b = (uint8_t)rng();
+  for (size_t len = 0; len <= buf.size(); len += (len < 40 ? 1 : 37)) {
+    const uint16_t ref = crcBitwise(buf.data(), len);
+    if (crcOld(buf.data(), (uint16_t)len) != ref || crc16(buf.data(), len) != ref) {
+      ::printf("mismatch at len %zu\n", len);
+      return false;
+    }
+    // Split updates at every alignment
+    for (size_t cut = 0; cut <= len && cut < 12; cut++) {
+      uint16_t c = crc16_update(crc16_update(crc16_init(), buf.data(), cut), buf.data() + cut, len - cut);
+      if (c != ref) { ::printf("split mismatch len %zu cut %zu\n", len, cut); return false; }
+    }
+  }
+  for (int k = 0; k < 256; k += 17) {
+    std::vector<uint8_t> enc(buf.size());
+    for (size_t i = 0; i < buf.size(); i++) enc[i] = buf[i] ^ (uint8_t)k;
+    if (crc16_update_xor(crc16_init(), buf.data(), buf.size(), (uint8_t)k) != crcBitwise(enc.data(), enc.size())) {
+      ::printf("xor mismatch key %d\n", k);
+      return false;
+    }
+  }
+  return true;
+}
+
+// ---------------- Timing ----------------
+template <class F>
+static double nsPerCall(uint32_t n, F&& f) {
+  volatile uint16_t sink = 0;
+  for (uint32_t i = 0; i < n / 16; i++) sink = sink ^ f(i);     // warm-up
+  auto t0 = std::chrono::steady_clock::now();
+  for (uint32_t i = 0; i < n; i++) sink = sink ^ f(i);
+  auto t1 = std::chrono::steady_clock::now();
+  (void)sink;
+  return std::chrono::duration<double, std::nano>(t1 - t0).count() / n;
+}
+
+int main(int argc, char** argv) {
+  uint32_t n   = 2000000;
+  size_t   len = 150;
+  for (int i = 1; i < argc; i++) {
+    const char* v = (i + 1 < argc) ? argv[i + 1] : nullptr;
+    if      (!strcmp(argv[i], "-n") && v) { n = strtoul(v, nullptr, 0); i++; }
+    else if (!strcmp(argv[i], "-l") && v) { len = strtoul(v, nullptr, 0); i++; }
+    else {
+      ::printf("usage: %s [-n MSGS] [-l LEN (18..530)]\n", argv[0]);
+      return !strcmp(argv[i], "-h") || !strcmp(argv[i], "--help") ? 0 : 2;
+    }
+  }
+  if (len < 18 || len > 530) len = 150;
+  const size_t payloadLen = len - 18;
+
+  oldTableInit();
+  std::mt19937 rng(1);
+  if (!selfCheck(rng)) { ::printf("FAIL\n"); return 1; }
+
+  // A few messages in rotation so the loop cannot be folded away
+  const int kMsgs = 8;
+  std::vector<std::vector<uint8_t>> hdr(kMsgs, std::vector<uint8_t>(18)), pl(kMsgs, std::vector<uint8_t>(payloadLen));
+  std::vector<std::vector<uint8_t>> flat(kMsgs, std::vector<uint8_t>(len));
+  for (int m = 0; m < kMsgs; m++) {
+    for (auto& b : hdr[m]) b = (uint8_t)rng();
+    for (auto& b : pl[m])  b = (uint8_t)rng();
+    for (auto& b : flat[m]) b = (uint8_t)rng();
+    if (oldMessageCrc(hdr[m].data(), pl[m].data(), payloadLen, (uint8_t)m) !=
+        newMessageCrc(hdr[m].data(), pl[m].data(), payloadLen, (uint8_t)m)) {
+      ::printf("message path mismatch\nFAIL\n");
+      return 1;
+    }
+  }
+
+  const double oldMsg = nsPerCall(n, [&](uint32_t i) { int m = i & 7; return oldMessageCrc(hdr[m].data(), pl[m].data(), payloadLen, (uint8_t)i); });
+  const double newMsg = nsPerCall(n, [&](uint32_t i) { int m = i & 7; return newMessageCrc(hdr[m].data(), pl[m].data(), payloadLen, (uint8_t)i); });
+  const double oldRaw = nsPerCall(n, [&](uint32_t i) { return crcOld(flat[i & 7].data(), (uint16_t)len); });
+  const double newRaw = nsPerCall(n, [&](uint32_t i) { return crc16(flat[i & 7].data(), len); });
+
+  ::printf("CRC16_SLICE=%d, %zu-byte messages, %u iterations (self-check vs bitwise: ok)\n", CRC16_SLICE, len, n);
+  ::printf("message old     : %7.1f ns  (%6.1f MB/s)\n", oldMsg, len * 1e3 / oldMsg);
+  ::printf("message new     : %7.1f ns  (%6.1f MB/s)  x%.2f\n", newMsg, len * 1e3 / newMsg, oldMsg / newMsg);
+  ::printf("raw crc old     : %7.1f ns  (%6.1f MB/s)\n", oldRaw, len * 1e3 / oldRaw);
+  ::printf("raw crc new     : %7.1f ns  (%6.1f MB/s)  x%.2f\n", newRaw, len * 1e3 / newRaw, oldRaw / newRaw);
+  return 0;
+}
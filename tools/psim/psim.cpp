@@ -0,0 +1,612 @@
+// PowerStream simulator: runs the bridge's EcoFlow stack end to end on the host.
+//
+//   pio run -e native_psim && .pio/build/native_psim/program [options]
+//
+// A simulated PowerStream sends C4 heartbeats, DE 0x0105/0x0141 requests and
+// CB 0x2031/0x2033 limit writes, built with the bridge's own header template
+// and CRC code. They travel over an in-process 1 Mbit/s bus model (frame
+// times, ID arbitration, one TX mailbox per node) into processEcoFlowCAN().
+// What the bridge submits goes through a canTxTask stand-in (HIGH before
+// NORMAL, whole messages, same queue depths) back onto the bus, where the
+// PowerStream side reassembles it and checks every reply: CRC, type,
+// tracker, echoed XOR key, payload, and time from request to complete reply.
+// The sequencer runs from ecoflowSequencerService() on the virtual clock.
+// Replies submitted while decoding reach the TX stand-in only after the
+// modelled decode cost (--decode-us), so the bridge's own C4->3C latency
+// histogram sees decode time plus any wait behind a message already on the bus.
+#include <Arduino.h>
+#include <algorithm>
+#include <chrono>
+#include <deque>
+#include <vector>
+
+#include "ecoflow.h"
+#include "bms_params.h"
+#include "bms_snapshot.h"
+#include "reassembler.h"
+#include "crc16.h"
+#include "lat_hist.h"
+#include "web.h"
+#include <SPIFFS.h>
+
+// ---------------- Host stubs for the firmware globals ----------------
+Config    config;
+bool      canHealth = false;
+BmsParams bmsParams;
+bool      bmsParamsValid    = false;
+uint32_t  bmsParamsLoadedMs = 0;
+HostSerial Serial;
+fs::FS     SPIFFS;
+
+volatile uint32_t can_rx_count   = 0;
+volatile uint32_t can_rx_dropped = 0;
+volatile uint32_t can_decoded    = 0;
+
+static uint64_t nowUs   = 1;     // virtual time
+static bool     verbose = false;
+
+uint32_t millis()              { return (uint32_t)(nowUs / 1000); }
+uint32_t micros()              { return (uint32_t)nowUs; }
+int64_t  esp_timer_get_time()  { return (int64_t)nowUs; }
+
+void HostSerial::printf(const char* fmt, ...) {
+  if (!verbose) return;
+  va_list ap;
+  va_start(ap, fmt);
+  vprintf(fmt, ap);
+  va_end(ap);
+}
+
+bool webCanLogActive() { return false; }
+bool webDebugActive()  { return verbose; }
+void streamDebug(const char* message) { if (verbose) printf("  dbg: %s\n", message); }
+
+// ---------------- Options ----------------
+struct SimOpts {
+  uint32_t durationMs = 60000;
+  uint32_t c4Ms       = 500;      // heartbeat period
+  uint32_t deMs       = 2000;     // DE 0x0105 / 0x0141 period
+  uint32_t cbMs       = 10000;    // CB 0x2031 / 0x2033 period
+  uint32_t floodHz    = 0;        // extra DE 0x0105 requests per second
+  uint32_t corruptN   = 0;        // corrupt the CRC of every Nth request
+  uint32_t pauseAtMs  = 0;        // heartbeat outage
+  uint32_t pauseLenMs = 0;
+  uint32_t deadlineUs = 20000;    // request END frame -> reply END frame
+  uint32_t decodeUs   = 150;      // decode task: RX frame -> canSubmit of its reply
+};
+static SimOpts opt;
+
+#define SIM_MISS_MS       1000    // unanswered this long: missed
+#define SIM_LOSS_GRACE_MS 1200    // C4 loss timeout + longest built-in step gap
+
+// ---------------- Bus model ----------------
+struct BusFrame {
+  uint32_t id;
+  uint8_t  dlc;
+  uint8_t  data[8];
+  int32_t  expect;     // PowerStream: index into expects[] on a message's last frame
+};
+
+// 29-bit data frame at 1 Mbit/s: 67 bits of overhead plus data, ~10% stuffing, 3-bit IFS
+static uint32_t frameUs(uint8_t dlc) {
+  return (67 + 8u * dlc) * 11 / 10 + 3;
+}
+
+enum SimNode : uint8_t { NODE_PS = 0, NODE_BRIDGE = 1 };
+
+static bool     mailboxFull[2] = {false, false};
+static BusFrame mailbox[2];
+static bool     busBusy  = false;
+static uint8_t  busOwner = 0;
+static uint64_t busEndUs = 0;
+static uint64_t busBusyUs = 0;
+static uint32_t busFrames[2] = {0, 0};
+
+// ---------------- Bridge TX (canTxTask stand-in) ----------------
+struct SimTxMsg {
+  uint32_t          ids[3];
+  uint64_t          submitUs;
+  uint64_t          readyUs;      // visible to canTxTask from here (decode cost)
+  CanTxFirstFrameCb onFirst;
+  uint32_t          tagUs;
+  uint8_t           flags;
+  std::vector<uint8_t> bytes;
+};
+
+static std::deque<SimTxMsg> bridgeQ[2];
+static SimTxMsg  txCur;
+static bool      txActive = false;
+static size_t    txPos = 0, txFrameIdx = 0;
+static uint32_t  txSubmitted[2], txRejected[2];
+static LatHist   txWait[2];
+static uint32_t  submitCostUs = 0;    // set while processEcoFlowCAN runs
+
+bool canSubmit(CanTxPrio prio, uint32_t idFirst, uint32_t idMiddle, uint32_t idLast,
+               const uint8_t* bytes, size_t len, uint8_t flags,
+               CanTxFirstFrameCb onFirst, uint32_t tagUs) {
+  if (prio > CAN_TX_NORMAL) prio = CAN_TX_NORMAL;
+  const size_t cap = (prio == CAN_TX_HIGH) ? CAN_TX_Q_HIGH : CAN_TX_Q_NORM;
+  if (!bytes || len == 0 || len > CAN_TX_MSG_MAX || bridgeQ[prio].size() >= cap) {
+    txRejected[prio]++;
+    return false;
+  }
+  SimTxMsg m;
+  m.ids[0] = idFirst; m.ids[1] = idMiddle; m.ids[2] = idLast;
+  m.submitUs = nowUs;
+  m.readyUs  = nowUs + submitCostUs;
+  m.onFirst  = onFirst;
+  m.tagUs    = tagUs;
+  m.flags    = flags;
+  m.bytes.assign(bytes, bytes + len);
+  bridgeQ[prio].push_back(std::move(m));
+  txSubmitted[prio]++;
+  return true;
+}
+
+// Hand the bridge's next frame to its mailbox; messages are never interleaved
+static void bridgeTxPump() {
+  if (mailboxFull[NODE_BRIDGE]) return;
+  if (!txActive) {
+    auto ready = [](uint8_t q) { return !bridgeQ[q].empty() && bridgeQ[q].front().readyUs <= nowUs; };
+    uint8_t p;
+    if      (ready(CAN_TX_HIGH))   p = CAN_TX_HIGH;
+    else if (ready(CAN_TX_NORMAL)) p = CAN_TX_NORMAL;
+    else return;
+    txCur = std::move(bridgeQ[p].front());
+    bridgeQ[p].pop_front();
+    txWait[p].record((uint32_t)(nowUs - txCur.submitUs));
+    txActive = true;
+    txPos = txFrameIdx = 0;
+  }
+
+  const bool    lenPrefix = (txCur.flags & CAN_TX_LEN_PREFIX) != 0;
+  const uint8_t per       = lenPrefix ? 7 : 8;
+  const size_t  remain    = txCur.bytes.size() - txPos;
+  const uint8_t chunk     = (remain > per) ? per : (uint8_t)remain;
+  const bool    last      = (remain <= per);
+
+  BusFrame& f = mailbox[NODE_BRIDGE];
+  f.id     = (txFrameIdx == 0) ? txCur.ids[0] : (last ? txCur.ids[2] : txCur.ids[1]);
+  f.expect = -1;
+  if (lenPrefix) {
+    f.data[0] = chunk;
+    memcpy(&f.data[1], &txCur.bytes[txPos], chunk);
+    f.dlc = (uint8_t)(chunk + 1);
+  } else {
+    memcpy(f.data, &txCur.bytes[txPos], chunk);
+    f.dlc = chunk;
+  }
+  mailboxFull[NODE_BRIDGE] = true;
+
+  if (txFrameIdx == 0 && txCur.onFirst) txCur.onFirst(txCur.tagUs);
+  txPos += chunk;
+  txFrameIdx++;
+  if (last) txActive = false;
+}
+
+// ---------------- PowerStream side: requests ----------------
+struct Expect {
+  const char* name;
+  uint8_t     type;        // reply type
+  int32_t     tracker;     // reply tracker, -1 = any
+  uint8_t     key;         // request key, echoed by the reply
+  uint8_t     value;       // CB limit written
+  bool        armed;       // request's last frame is on the bus
+  bool        done;
+  uint64_t    reqEndUs;
+};
+
+static std::vector<Expect> expects;
+static size_t   expectHead = 0;          // everything before is done
+static std::deque<BusFrame> psTxQ;
+static uint8_t  psKey = 0x29;
+static uint32_t psRequests = 0, psCorrupted = 0;
+
+static const char kPsSerial[] = "HW51ZEH4SF123456";
+
+// header_C4 is what a PowerStream puts on the wire; every request reuses its layout
+static void psSend(uint8_t type, uint16_t tracker, const uint8_t* pl, uint16_t len,
+                   const char* name, uint8_t replyType, int32_t replyTracker, uint8_t value = 0) {
+  const uint8_t key = psKey;
+  psKey = (uint8_t)(psKey * 13 + 7);
+
+  std::vector<uint8_t> wire(REASM_HDR_LEN + len + 2);
+  memcpy(wire.data(), header_C4, REASM_HDR_LEN);
+  wire[2]  = (uint8_t)(len & 0xFF);
+  wire[3]  = (uint8_t)(len >> 8);
+  wire[4]  = type;
+  wire[6]  = key;
+  wire[16] = (uint8_t)(tracker >> 8);
+  wire[17] = (uint8_t)(tracker & 0xFF);
+  for (uint16_t i = 0; i < len; i++) wire[REASM_HDR_LEN + i] = pl[i] ^ key;
+  uint16_t crc = crc16_update(crc16_init(), wire.data(), REASM_HDR_LEN);
+  crc = crc16_update_xor(crc, pl, len, key);
+
+  psRequests++;
+  const bool corrupt = opt.corruptN && (psRequests % opt.corruptN) == 0;
+  if (corrupt) { crc ^= 0x0001; psCorrupted++; }
+  wire[REASM_HDR_LEN + len]     = (uint8_t)(crc & 0xFF);
+  wire[REASM_HDR_LEN + len + 1] = (uint8_t)(crc >> 8);
+
+  // A corrupted request must not be answered, so nothing is expected for it
+  int32_t ex = -1;
+  if (!corrupt) {
+    expects.push_back({ name, replyType, replyTracker, key, value, false, false, 0 });
+    ex = (int32_t)expects.size() - 1;
+  }
+
+  for (size_t pos = 0, idx = 0; pos < wire.size(); idx++) {
+    size_t   remain = wire.size() - pos;
+    uint8_t  chunk  = remain > 8 ? 8 : (uint8_t)remain;
+    bool     last   = remain <= 8;
+    BusFrame f;
+    f.id     = (idx == 0) ? MSG14001_START_ID : (last ? MSG14001_END_ID : MSG14001_MID_ID);
+    f.dlc    = chunk;
+    memcpy(f.data, &wire[pos], chunk);
+    f.expect = last ? ex : -1;
+    psTxQ.push_back(f);
+    pos += chunk;
+  }
+}
+
+static void psSendC4() {
+  uint8_t pl[69] = {0};
+  memcpy(&pl[3], kPsSerial, 16);
+  psSend(0xC4, 0x0302, pl, sizeof(pl), "C4->3C", 0x3C, -1);
+}
+
+static void psSendDE(uint16_t tracker) {
+  uint8_t pl[4] = {0};
+  if (tracker == 0x0105) psSend(0xDE, tracker, pl, sizeof(pl), "DE0105->8C", 0x8C, 0x0105);
+  else                   psSend(0xDE, tracker, pl, sizeof(pl), "DE0141->24", 0x24, 0x0141);
+}
+
+static void psSendCB(uint16_t tracker, uint8_t pct) {
+  uint8_t pl[1] = { pct };
+  psSend(0xCB, tracker, pl, sizeof(pl),
+         tracker == 0x2031 ? "CB2031 ack" : "CB2033 ack", 0xCB, tracker, pct);
+}
+
+// ---------------- PowerStream side: checking what the bridge sends ----------------
+struct ReplyKind {
+  const char* name;
+  LatHist     lat;
+  uint32_t    ok;
+  uint32_t    late;
+  uint32_t    badKey;
+  uint32_t    badPayload;
+  uint32_t    missed;
+};
+static ReplyKind kinds[5] = {
+  {"C4->3C",     {}, 0, 0, 0, 0, 0},
+  {"DE0105->8C", {}, 0, 0, 0, 0, 0},
+  {"DE0141->24", {}, 0, 0, 0, 0, 0},
+  {"CB2031 ack", {}, 0, 0, 0, 0, 0},
+  {"CB2033 ack", {}, 0, 0, 0, 0, 0},
+};
+static ReplyKind* kindFor(const char* name) {
+  for (auto& k : kinds) if (!strcmp(k.name, name)) return &k;
+  return nullptr;
+}
+
+static Reassembler psReasm(300, MSG3001_FIRST_ID & ~REASM_POS_MASK);
+static uint32_t rxCrcFail = 0, rxUnexpected = 0, seqAfterLoss = 0;
+
+// Sequencer traffic: per type/tracker counts and the cycle period (0x70 to 0x70)
+struct SeqKey { uint8_t type; uint16_t tracker; uint32_t count; };
+static std::vector<SeqKey> seqSeen;
+static LatHist  seqCycle;
+static uint64_t seq70LastUs = 0;
+static uint64_t lastC4EndUs = 0;
+static bool     c4Paused = false;
+
+static bool isReplyType(uint8_t type, uint16_t tracker) {
+  return type == 0x3C || type == 0x8C || type == 0x24 ||
+         (type == 0xCB && (tracker == 0x2031 || tracker == 0x2033));
+}
+
+static void psOnBridgeMessage(const ReasmMessage& m) {
+  uint8_t pl[REASM_MAX_PAYLOAD];
+  for (uint16_t i = 0; i < m.payloadLen; i++) pl[i] = m.payload[i] ^ m.xorKey;
+
+  if (!isReplyType(m.type, m.trackerBE)) {
+    if (c4Paused && nowUs - lastC4EndUs > (uint64_t)SIM_LOSS_GRACE_MS * 1000) seqAfterLoss++;
+    bool found = false;
+    for (auto& s : seqSeen)
+      if (s.type == m.type && s.tracker == m.trackerBE) { s.count++; found = true; break; }
+    if (!found) seqSeen.push_back({ m.type, m.trackerBE, 1 });
+    if (m.type == 0x70) {
+      if (seq70LastUs) seqCycle.record((uint32_t)(nowUs - seq70LastUs));
+      seq70LastUs = nowUs;
+    }
+    return;
+  }
+
+  // Oldest outstanding request this reply answers
+  Expect* e = nullptr;
+  for (size_t i = expectHead; i < expects.size(); i++) {
+    Expect& x = expects[i];
+    if (x.armed && !x.done && x.type == m.type && (x.tracker < 0 || x.tracker == m.trackerBE)) { e = &x; break; }
+  }
+  if (!e) { rxUnexpected++; return; }
+  e->done = true;
+
+  ReplyKind& k = *kindFor(e->name);
+  const uint32_t lat = (uint32_t)(nowUs - e->reqEndUs);
+  k.lat.record(lat);
+
+  bool good = true;
+  if (m.xorKey != e->key) { k.badKey++; good = false; }
+  if (m.type == 0x24 && (m.payloadLen < 24 || memcmp(&pl[8], config.serialStr, 16) != 0)) {
+    k.badPayload++; good = false;
+  }
+  if (m.type == 0xCB) {
+    const uint8_t applied = (m.trackerBE == 0x2031) ? config.bmsChgUp : config.bmsChgDn;
+    if (applied != e->value) { k.badPayload++; good = false; }
+  }
+  if (lat > opt.deadlineUs) { k.late++; good = false; }
+  if (good) k.ok++;
+}
+
+static void psExpireExpects() {
+  while (expectHead < expects.size()) {
+    Expect& x = expects[expectHead];
+    if (!x.done) {
+      if (!x.armed || nowUs - x.reqEndUs < (uint64_t)SIM_MISS_MS * 1000) break;
+      kindFor(x.name)->missed++;
+      x.done = true;
+    }
+    expectHead++;
+  }
+}
+
+// ---------------- Bus delivery ----------------
+static LatHist  costRx, costSeq;      // host ns per call
+static bool     seqNotify = false;    // decoder woke the sequencer task
+
+static uint64_t hostNs(std::chrono::steady_clock::time_point t0) {
+  return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now() - t0).count();
+}
+
+static void deliver(const BusFrame& f, uint8_t from) {
+  busFrames[from]++;
+  if (from == NODE_PS) {
+    if (f.expect >= 0) {
+      expects[f.expect].armed    = true;
+      expects[f.expect].reqEndUs = nowUs;
+      if (expects[f.expect].type == 0x3C) lastC4EndUs = nowUs;
+    }
+
+    twai_message_t msg = {};
+    msg.identifier       = f.id;
+    msg.extd             = 1;
+    msg.data_length_code = f.dlc;
+    memcpy(msg.data, f.data, f.dlc);
+    auto t0 = std::chrono::steady_clock::now();
+    submitCostUs = opt.decodeUs;
+    processEcoFlowCAN(msg, micros());
+    submitCostUs = 0;
+    costRx.record((uint32_t)hostNs(t0));
+    can_rx_count++;
+    can_decoded++;
+    seqNotify = true;
+  } else {
+    ReasmMessage m;
+    switch (psReasm.feed(f.id, f.data, f.dlc, millis(), m)) {
+      case REASM_COMPLETE: psOnBridgeMessage(m); break;
+      case REASM_CRC_FAIL: rxCrcFail++; break;
+      default: break;
+    }
+  }
+}
+
+// Finish the frame on the wire, then arbitrate: lowest ID of the two mailboxes wins
+static void busStep() {
+  if (busBusy && nowUs >= busEndUs) {
+    busBusy = false;
+    const BusFrame f = mailbox[busOwner];
+    mailboxFull[busOwner] = false;
+    deliver(f, busOwner);
+  }
+  if (!mailboxFull[NODE_PS] && !psTxQ.empty()) {
+    mailbox[NODE_PS] = psTxQ.front();
+    psTxQ.pop_front();
+    mailboxFull[NODE_PS] = true;
+  }
+  bridgeTxPump();
+  if (busBusy) return;
+
+  int8_t win = -1;
+  if (mailboxFull[NODE_PS]) win = NODE_PS;
+  if (mailboxFull[NODE_BRIDGE] && (win < 0 || mailbox[NODE_BRIDGE].id < mailbox[NODE_PS].id)) win = NODE_BRIDGE;
+  if (win < 0) return;
+
+  const uint32_t t = frameUs(mailbox[win].dlc);
+  busBusy   = true;
+  busOwner  = (uint8_t)win;
+  busEndUs  = nowUs + t;
+  busBusyUs += t;
+}
+
+// ---------------- Main loop ----------------
+static uint32_t parseMs(const char* s) { return (uint32_t)(atof(s) * 1000.0); }
+
+static void usage(const char* argv0) {
+  ::printf("usage: %s [-d S] [--c4 MS] [--de MS] [--cb MS] [--flood HZ] [--corrupt N]\n"
+           "          [--pause AT_S:LEN_S] [--deadline MS] [--decode-us US] [-v]\n", argv0);
+}
+
+static void printHist(const char* name, const LatHist& h, const char* unit) {
+  ::printf("%-14s n=%-7u min=%-7u avg=%-7u p99<=%-7u max=%u %s\n", name, h.count,
+           h.count ? h.minUs : 0, h.avgUs(), h.percentileUs(99), h.maxUs, unit);
+}
+
+int main(int argc, char** argv) {
+  for (int i = 1; i < argc; i++) {
+    const char* a = argv[i];
+    const char* v = (i + 1 < argc) ? argv[i + 1] : nullptr;
+    if      (!strcmp(a, "-v"))                verbose = true;
+    else if (!strcmp(a, "-d") && v)           { opt.durationMs = parseMs(v); i++; }
+    else if (!strcmp(a, "--c4") && v)         { opt.c4Ms = atoi(v); i++; }
+    else if (!strcmp(a, "--de") && v)         { opt.deMs = atoi(v); i++; }
+    else if (!strcmp(a, "--cb") && v)         { opt.cbMs = atoi(v); i++; }
+    else if (!strcmp(a, "--flood") && v)      { opt.floodHz = atoi(v); i++; }
+    else if (!strcmp(a, "--corrupt") && v)    { opt.corruptN = atoi(v); i++; }
+    else if (!strcmp(a, "--deadline") && v)   { opt.deadlineUs = atoi(v) * 1000; i++; }
+    else if (!strcmp(a, "--decode-us") && v)  { opt.decodeUs = atoi(v); i++; }
+    else if (!strcmp(a, "--pause") && v && strchr(v, ':')) {
+      opt.pauseAtMs  = parseMs(v);
+      opt.pauseLenMs = parseMs(strchr(v, ':') + 1);
+      i++;
+    }
+    else { usage(argv[0]); return !strcmp(a, "-h") || !strcmp(a, "--help") ? 0 : 2; }
+  }
+  if (!opt.c4Ms || !opt.deMs || !opt.cbMs) { usage(argv[0]); return 2; }
+
+  // Bridge bring-up, in setup() order
+  BmsSnapshot s = {};
+  s.numCells = 16;
+  for (uint8_t c = 0; c < 16; c++) s.cellMv[c] = 3300 + c;
+  s.minCellMv = 3300; s.maxCellMv = 3315;
+  s.bmsPackMv = s.packMv = 52920;
+  s.packMa = -8000; s.outputW = -423;
+  s.bmsSoc = s.soc = 55;
+  s.temp = 25;
+  s.mosdis = s.moschg = true;
+  bmsSnapshotPublish(s);
+  ecoflowHandlersInit();
+  ecoflowMessagesInit();
+  ecoflowTxSeqLoad();
+
+  uint64_t nextC4 = 100000, nextDE = 300000, nextCB = 700000, nextFlood = UINT64_MAX;
+  uint64_t nextSeq = 0, nextLoop = 0;
+  if (opt.floodHz) nextFlood = 150000;
+  bool deToggle = false, cbToggle = false;
+  uint8_t cbPct = 70;
+  const uint64_t endUs    = (uint64_t)opt.durationMs * 1000;
+  const uint64_t pauseAt  = (uint64_t)opt.pauseAtMs * 1000;
+  const uint64_t pauseEnd = pauseAt + (uint64_t)opt.pauseLenMs * 1000;
+
+  for (auto* h : { &txWait[0], &txWait[1], &seqCycle, &costRx, &costSeq }) h->reset();
+  for (auto& k : kinds) k.lat.reset();
+
+  auto wall0 = std::chrono::steady_clock::now();
+  while (nowUs < endUs) {
+    // PowerStream timers
+    if (nowUs >= nextC4) {
+      c4Paused = opt.pauseLenMs && nowUs >= pauseAt && nowUs < pauseEnd;
+      if (!c4Paused) psSendC4();
+      nextC4 += (uint64_t)opt.c4Ms * 1000;
+    }
+    if (nowUs >= nextDE) {
+      psSendDE(deToggle ? 0x0141 : 0x0105);
+      deToggle = !deToggle;
+      nextDE += (uint64_t)opt.deMs * 1000 / 2;
+    }
+    if (nowUs >= nextCB) {
+      cbPct = (uint8_t)(cbPct >= 100 ? 50 : cbPct + 5);
+      psSendCB(cbToggle ? 0x2033 : 0x2031, cbToggle ? (uint8_t)(100 - cbPct) : cbPct);
+      cbToggle = !cbToggle;
+      nextCB += (uint64_t)opt.cbMs * 1000 / 2;
+    }
+    if (nowUs >= nextFlood) {
+      psSendDE(0x0105);
+      nextFlood += 1000000 / opt.floodHz;
+    }
+
+    busStep();
+
+    // Sequencer task: woken by its timer or by the decoder after a heartbeat
+    if (nowUs >= nextSeq || seqNotify) {
+      seqNotify = false;
+      auto t0 = std::chrono::steady_clock::now();
+      int64_t wait = ecoflowSequencerService();
+      costSeq.record((uint32_t)hostNs(t0));
+      nextSeq = nowUs + (wait < 0 ? 100000 : (wait ? (uint64_t)wait : 1));
+      busStep();
+    }
+
+    // loop(): 3C image refresh and the decode task's stream deadline
+    if (nowUs >= nextLoop) {
+      ecoflow3CImageTick();
+      ecoflowRxCheckTimeout();
+      psReasm.expire(millis());
+      psExpireExpects();
+      nextLoop = nowUs + 10000;
+    }
+
+    uint64_t next = std::min({ nextC4, nextDE, nextCB, nextFlood, nextSeq, nextLoop, endUs });
+    if (busBusy) next = std::min(next, busEndUs);
+    for (auto& q : bridgeQ)
+      if (!q.empty() && q.front().readyUs > nowUs) next = std::min(next, q.front().readyUs);
+    if (next <= nowUs) next = nowUs + 1;
+    nowUs = next;
+  }
+  const double wallS = std::chrono::duration<double>(std::chrono::steady_clock::now() - wall0).count();
+
+  // ---- Report ----
+  uint32_t errors = 0;
+  ::printf("simulated       : %.1f s in %.3f s wall (%.0fx real time)\n",
+           opt.durationMs / 1000.0, wallS, wallS > 0 ? opt.durationMs / 1000.0 / wallS : 0.0);
+  ::printf("bus             : %u PS frames, %u bridge frames, %.1f%% load\n",
+           busFrames[NODE_PS], busFrames[NODE_BRIDGE], 100.0 * busBusyUs / (double)endUs);
+  ::printf("requests        : %u sent, %u with corrupted CRC\n", psRequests, psCorrupted);
+  ::printf("bridge tx       : high %u (rejected %u)  normal %u (rejected %u)\n",
+           txSubmitted[CAN_TX_HIGH], txRejected[CAN_TX_HIGH], txSubmitted[CAN_TX_NORMAL], txRejected[CAN_TX_NORMAL]);
+  printHist("  queue wait hi", txWait[CAN_TX_HIGH], "us");
+  printHist("  queue wait no", txWait[CAN_TX_NORMAL], "us");
+
+  uint32_t bridgeCrcFail = 0;
+  for (int t = 0; t < 256; t++) bridgeCrcFail += ecoflowRxCrcFail((uint8_t)t);
+  ::printf("bridge rx       : crc_fail %u (expected %u), timeouts %u, unhandled %u\n",
+           bridgeCrcFail, psCorrupted, ecoflowRxTimeouts(), ecoflowUnhandledCount());
+  if (bridgeCrcFail != psCorrupted) errors++;
+
+  ::printf("\nreply (request END -> reply END, deadline %u us)\n", opt.deadlineUs);
+  for (auto& k : kinds) {
+    printHist(k.name, k.lat, "us");
+    ::printf("%-14s ok=%u late=%u bad_key=%u bad_payload=%u missed=%u\n", "",
+             k.ok, k.late, k.badKey, k.badPayload, k.missed);
+    errors += k.late + k.badKey + k.badPayload + k.missed;
+  }
+  ::printf("reply crc fail  : %u\nunexpected reply: %u\n", rxCrcFail, rxUnexpected);
+  errors += rxCrcFail + rxUnexpected;
+
+  EcoflowLatency c4;
+  ecoflowC4LatencyGet(c4);
+  ::printf("bridge C4->3C   : n=%u avg=%u max=%u us (END frame in -> first 3C frame at the driver)\n",
+           c4.count, c4.avgUs, c4.maxUs);
+  ::printf("                 ");
+  for (int i = 0; i < ECOFLOW_LAT_BUCKETS; i++) {
+    if (i < ECOFLOW_LAT_BUCKETS - 1) ::printf(" <%u:%u", ecoflowLatEdgesUs[i], c4.hist[i]);
+    else                             ::printf(" more:%u", c4.hist[i]);
+  }
+  ::printf("\n");
+  // Every answered heartbeat is one sample, and none can beat the decode cost
+  if (c4.count != kindFor("C4->3C")->lat.count || (c4.count && c4.avgUs < opt.decodeUs)) {
+    ::printf("  C4 latency histogram disagrees with the replies seen\n");
+    errors++;
+  }
+
+  ::printf("\nsequencer traffic\n");
+  for (auto& s : seqSeen) ::printf("  type 0x%02X tracker %04X  %u\n", s.type, s.tracker, s.count);
+  // Longer than LatHist resolves, so no percentile here
+  ::printf("  cycle (0x70)   n=%-7u min=%.1f avg=%.1f max=%.1f ms\n", seqCycle.count,
+           seqCycle.count ? seqCycle.minUs / 1000.0 : 0.0, seqCycle.avgUs() / 1000.0, seqCycle.maxUs / 1000.0);
+  if (seqSeen.empty() && opt.durationMs > 2 * opt.c4Ms) { ::printf("  sequencer never ran\n"); errors++; }
+  if (opt.pauseLenMs) {
+    const bool restarted = seq70LastUs >= pauseEnd;
+    ::printf("  heartbeat pause: %u msgs past the loss timeout, restarted=%s\n",
+             seqAfterLoss, restarted ? "yes" : "no");
+    errors += seqAfterLoss;
+    if (!restarted && pauseEnd + 2000000 < endUs) errors++;
+  }
+
+  ::printf("\nhost cost       (ns per call)\n");
+  printHist("  rx frame", costRx, "ns");
+  printHist("  sequencer", costSeq, "ns");
+
+  ::printf("\n%s (%u errors)\n", errors ? "FAIL" : "PASS", errors);
+  return errors ? 1 : 0;
+}
@@ -0,0 +1,365 @@
+// Host tests and throughput benchmark for the multi-stream Reassembler.
+//
+//   pio run -e native_reasmtest && .pio/build/native_reasmtest/program [-n MSGS] [-v]
+//
+// Synthetic 18-byte-header messages are split into START/MID/END frames for
+// the 14001 family (pinned, as in processEcoFlowCAN) and for 300x diagnostic
+// families, then fed on a virtual millisecond clock. Checked:
+//   - single and interleaved streams complete with the right fields and CRC
+//   - a corrupted trailer reports REASM_CRC_FAIL
+//   - a START for a busy family restarts its slot without a steal
+//   - a full pool steals the stalest unpinned stream, never the pinned one
+//   - MID/END frames without an open stream are counted as orphans
+//   - a declared payload over REASM_MAX_PAYLOAD is dropped at START, the
+//     largest allowed one completes
+//   - an END before the declared length drops the stream
+//   - expire() drops a stream only once it is idle for more than the timeout
+//     (strict >), and msUntilDeadline() counts down to it
+// Then the frame throughput for one stream and for REASM_SLOTS interleaved
+// streams. Exit status 1 on any failed check.
+#include <Arduino.h>
+#include <chrono>
+#include <random>
+#include <vector>
+
+#include "reassembler.h"
+#include "crc16.h"
+
+HostSerial Serial;
+uint32_t millis() { return 0; }
+uint32_t micros() { return 0; }
+void     delay(uint32_t) {}
+
+static bool verbose = false;
+
+#define FAM_14001   0x10014001UL
+#define FAM_3001    0x10003001UL
+#define FAM_3002    0x10003002UL
+#define FAM_3003    0x10003003UL
+#define FAM_3004    0x10003004UL
+#define TIMEOUT_MS  300
+
+static_assert(REASM_SLOTS == 4, "the steal checks fill a 4-slot pool");
+
+// ---------------- Traffic ----------------
+struct Frame {
+  uint32_t id;
+  uint8_t  dlc;
+  uint8_t  data[8];
+};
+
+// Header + XOR-encoded payload + CRC (LE), as a PowerStream sends it
+static std::vector<uint8_t> buildWire(uint8_t type, uint16_t tracker, uint16_t len, uint8_t key,
+                                      uint32_t seed, bool badCrc = false) {
+  std::vector<uint8_t> w(REASM_HDR_LEN + len + 2, 0);
+  w[0]  = 0xAA;
+  w[2]  = (uint8_t)(len & 0xFF);
+  w[3]  = (uint8_t)(len >> 8);
+  w[4]  = type;
+  w[6]  = key;
+  w[16] = (uint8_t)(tracker >> 8);
+  w[17] = (uint8_t)(tracker & 0xFF);
+  std::mt19937 rng(seed);
+  for (uint16_t i = 0; i < len; i++) w[REASM_HDR_LEN + i] = (uint8_t)rng() ^ key;
+  uint16_t crc = crc16_update(crc16_init(), w.data(), REASM_HDR_LEN + len);
+  if (badCrc) crc ^= 0x8000;
+  w[REASM_HDR_LEN + len]     = (uint8_t)(crc & 0xFF);
+  w[REASM_HDR_LEN + len + 1] = (uint8_t)(crc >> 8);
+  return w;
+}
+
+static std::vector<Frame> split(uint32_t family, const std::vector<uint8_t>& w) {
+  std::vector<Frame> out;
+  for (size_t pos = 0, idx = 0; pos < w.size(); idx++) {
+    const size_t remain = w.size() - pos;
+    Frame f = {};
+    f.dlc = remain > 8 ? 8 : (uint8_t)remain;
+    const uint32_t p = (idx == 0) ? 0 : (remain <= 8 ? 2 : 1);
+    f.id = family | (p << REASM_POS_SHIFT);
+    memcpy(f.data, &w[pos], f.dlc);
+    out.push_back(f);
+    pos += f.dlc;
+  }
+  return out;
+}
+
+static ReasmResult feed(Reassembler& r, const Frame& f, uint32_t nowMs, ReasmMessage& m) {
+  return r.feed(f.id, f.data, f.dlc, nowMs, m);
+}
+
+// Feeds all frames; returns the result of the last one
+static ReasmResult feedAll(Reassembler& r, const std::vector<Frame>& fs, uint32_t nowMs, ReasmMessage& m) {
+  ReasmResult res = REASM_NONE;
+  for (auto& f : fs) res = feed(r, f, nowMs, m);
+  return res;
+}
+
+// ---------------- Checks ----------------
+static uint32_t failures = 0;
+
+static void check(bool ok, const char* what) {
+  if (!ok) failures++;
+  if (verbose || !ok) ::printf("  %-58s %s\n", what, ok ? "ok" : "FAILED");
+}
+
+static bool sameMessage(const ReasmMessage& m, uint32_t family, const std::vector<uint8_t>& w) {
+  const uint16_t len = (uint16_t)(w[2] | (w[3] << 8));
+  return m.family == family && m.type == w[4] && m.xorKey == w[6] && m.payloadLen == len &&
+         m.trackerBE == (uint16_t)((w[16] << 8) | w[17]) &&
+         memcmp(m.header, w.data(), REASM_HDR_LEN) == 0 &&
+         memcmp(m.payload, w.data() + REASM_HDR_LEN, len) == 0;
+}
+
+static void testSingle() {
+  Reassembler r(TIMEOUT_MS, FAM_14001);
+  ReasmMessage m;
+  auto w = buildWire(0xC4, 0x0302, 69, 0x3A, 1);
+  auto fs = split(FAM_14001, w);
+
+  bool noneBeforeEnd = true;
+  for (size_t i = 0; i + 1 < fs.size(); i++) noneBeforeEnd &= feed(r, fs[i], 0, m) == REASM_NONE;
+  check(noneBeforeEnd && r.activeStreams() == 1, "single: frames before END are absorbed");
+  check(feed(r, fs.back(), 0, m) == REASM_COMPLETE, "single: END completes");
+  check(sameMessage(m, FAM_14001, w) && m.crc == m.crcCalc, "single: fields, payload and CRC");
+  check(r.activeStreams() == 0, "single: slot released");
+
+  auto bad = split(FAM_14001, buildWire(0xC4, 0x0302, 69, 0x3A, 1, true));
+  check(feedAll(r, bad, 0, m) == REASM_CRC_FAIL && m.crc != m.crcCalc, "crc: corrupted trailer reports CRC_FAIL");
+  check(r.activeStreams() == 0, "crc: failed stream dropped");
+}
+
+static void testInterleaved() {
+  Reassembler r(TIMEOUT_MS, FAM_14001);
+  ReasmMessage m;
+  const uint32_t fams[4] = { FAM_14001, FAM_3001, FAM_3002, FAM_3003 };
+  std::vector<std::vector<uint8_t>> w;
+  std::vector<std::vector<Frame>> fs;
+  for (int i = 0; i < 4; i++) {
+    w.push_back(buildWire((uint8_t)(0x10 + i), (uint16_t)(0x100 + i), (uint16_t)(40 + 37 * i), (uint8_t)(i * 7), 10 + i));
+    fs.push_back(split(fams[i], w.back()));
+  }
+
+  // Round-robin, one frame per stream per turn
+  int  done = 0;
+  bool good = true;
+  for (size_t k = 0; done < 4; k++) {
+    for (int i = 0; i < 4; i++) {
+      if (k >= fs[i].size()) continue;
+      ReasmResult res = feed(r, fs[i][k], (uint32_t)k, m);
+      if (k + 1 == fs[i].size()) {
+        done++;
+        good &= res == REASM_COMPLETE && sameMessage(m, fams[i], w[i]);
+      } else {
+        good &= res == REASM_NONE;
+      }
+    }
+  }
+  check(good, "interleaved: 4 families complete intact");
+  check(r.slotSteals() == 0 && r.orphanFrames() == 0 && r.activeStreams() == 0, "interleaved: no steals, no orphans");
+}
+
+static void testRestart() {
+  Reassembler r(TIMEOUT_MS, FAM_14001);
+  ReasmMessage m;
+  auto a = split(FAM_3001, buildWire(0x01, 1, 64, 0, 20));
+  auto b = buildWire(0x02, 2, 30, 0, 21);
+  feed(r, a[0], 0, m);
+  feed(r, a[1], 0, m);
+  check(feedAll(r, split(FAM_3001, b), 5, m) == REASM_COMPLETE && sameMessage(m, FAM_3001, b),
+        "restart: new START for a busy family wins");
+  check(r.slotSteals() == 0 && r.activeStreams() == 0, "restart: no steal, no stale stream left");
+}
+
+static void testSteal() {
+  Reassembler r(TIMEOUT_MS, FAM_14001);
+  ReasmMessage m;
+  // Pool full: 14001 is the stalest, then 3001, 3002, 3003
+  auto p  = buildWire(0xC4, 0x0302, 69, 5, 30);
+  auto pf = split(FAM_14001, p);
+  auto s1 = split(FAM_3001, buildWire(0x01, 1, 50, 0, 31));
+  auto s2 = split(FAM_3002, buildWire(0x02, 2, 50, 0, 32));
+  auto s3 = split(FAM_3003, buildWire(0x03, 3, 50, 0, 33));
+  feed(r, pf[0], 0, m);
+  feed(r, s1[0], 10, m);
+  feed(r, s2[0], 20, m);
+  feed(r, s3[0], 30, m);
+  check(r.activeStreams() == REASM_SLOTS, "steal: pool full");
+
+  auto n4 = buildWire(0x04, 4, 50, 0, 34);
+  auto nf = split(FAM_3004, n4);
+  feed(r, nf[0], 40, m);
+  check(r.slotSteals() == 1 && r.activeStreams() == REASM_SLOTS, "steal: a new family steals one slot");
+
+  // 3001 was the stalest unpinned stream: its next frame is an orphan
+  const uint32_t orph = r.orphanFrames();
+  check(feed(r, s1[1], 41, m) == REASM_NONE && r.orphanFrames() == orph + 1, "steal: stalest unpinned (3001) was evicted");
+
+  bool pinnedOk = true;
+  for (size_t i = 1; i < pf.size(); i++) {
+    ReasmResult res = feed(r, pf[i], 42, m);
+    if (i + 1 == pf.size()) pinnedOk &= res == REASM_COMPLETE && sameMessage(m, FAM_14001, p);
+  }
+  check(pinnedOk, "steal: pinned 14001 stream survives and completes");
+  for (size_t i = 1; i < nf.size(); i++) feed(r, nf[i], 43, m);
+  check(sameMessage(m, FAM_3004, n4), "steal: the new stream completes in the stolen slot");
+
+  // Pool full of diagnostics: the pinned family may steal the stalest of them
+  Reassembler q(TIMEOUT_MS, FAM_14001);
+  const uint32_t diag[4] = { FAM_3001, FAM_3002, FAM_3003, FAM_3004 };
+  for (int i = 0; i < 4; i++) feed(q, split(diag[i], buildWire(0x01, 1, 50, 0, 40 + i))[0], (uint32_t)(i * 10), m);
+  check(feedAll(q, split(FAM_14001, p), 50, m) == REASM_COMPLETE && q.slotSteals() == 1,
+        "steal: pinned START takes a diagnostic slot");
+  check(feed(q, split(FAM_3001, buildWire(0x01, 1, 50, 0, 40))[1], 51, m) == REASM_NONE && q.orphanFrames() == 1,
+        "steal: ...the stalest one (3001)");
+}
+
+static void testOrphans() {
+  Reassembler r(TIMEOUT_MS, FAM_14001);
+  ReasmMessage m;
+  auto fs = split(FAM_14001, buildWire(0xC4, 0x0302, 69, 0, 50));
+  check(feed(r, fs[1], 0, m) == REASM_NONE && feed(r, fs.back(), 0, m) == REASM_NONE, "orphans: MID/END alone yield nothing");
+  check(r.orphanFrames() == 2 && r.activeStreams() == 0, "orphans: counted, no stream opened");
+
+  // After completion the slot is closed: a repeated END is an orphan too
+  feedAll(r, fs, 1, m);
+  check(feed(r, fs.back(), 1, m) == REASM_NONE && r.orphanFrames() == 3, "orphans: END after completion");
+
+  // Not a multi-frame ID at all: ignored, not an orphan
+  uint8_t d[8] = {0};
+  check(r.feed(0x10314001UL, d, 8, 1, m) == REASM_NONE && r.feed(0x00014001UL, d, 8, 1, m) == REASM_NONE &&
+        r.orphanFrames() == 3, "orphans: non multi-frame IDs are ignored");
+}
+
+static void testOversize() {
+  Reassembler r(TIMEOUT_MS, FAM_14001);
+  ReasmMessage m;
+  // Header claims REASM_MAX_PAYLOAD + 1: dropped on the START frame
+  auto big = split(FAM_14001, buildWire(0x13, 1, REASM_MAX_PAYLOAD + 1, 0, 60));
+  check(feed(r, big[0], 0, m) == REASM_OVERSIZE && r.activeStreams() == 0, "oversize: declared > max dropped at START");
+  bool rest = true;
+  for (size_t i = 1; i < big.size(); i++) rest &= feed(r, big[i], 0, m) == REASM_NONE;
+  check(rest && r.orphanFrames() == big.size() - 1, "oversize: remaining frames are orphans");
+
+  // Exactly the cap: REASM_BUF_CAP bytes on the wire
+  auto w = buildWire(0x13, 1, REASM_MAX_PAYLOAD, 0x77, 61);
+  check(w.size() == REASM_BUF_CAP && feedAll(r, split(FAM_14001, w), 1, m) == REASM_COMPLETE &&
+        sameMessage(m, FAM_14001, w), "oversize: max payload completes");
+
+  // Frames past the declared length are clamped to the buffer
+  auto fs = split(FAM_3001, buildWire(0x01, 1, 20, 0, 62));
+  feed(r, fs[0], 2, m);
+  Frame extra = fs[1];
+  for (int i = 0; i < 400; i++) feed(r, extra, 2, m);
+  check(feed(r, fs.back(), 2, m) == REASM_CRC_FAIL, "oversize: runaway MID frames stay in bounds");
+}
+
+static void testEarlyEnd() {
+  Reassembler r(TIMEOUT_MS, FAM_14001);
+  ReasmMessage m;
+  auto fs = split(FAM_14001, buildWire(0xC4, 0x0302, 69, 0, 70));
+  feed(r, fs[0], 0, m);
+  feed(r, fs[1], 0, m);
+  check(feed(r, fs.back(), 0, m) == REASM_NONE && r.activeStreams() == 0, "early END: short stream dropped");
+  check(feed(r, fs[2], 0, m) == REASM_NONE && r.orphanFrames() == 1, "early END: later frames are orphans");
+}
+
+static void testExpire() {
+  Reassembler r(TIMEOUT_MS, FAM_14001);
+  ReasmMessage m;
+  auto fs = split(FAM_14001, buildWire(0xC4, 0x0302, 69, 0, 80));
+  const uint32_t t0 = 1000;
+  check(r.msUntilDeadline(t0) == UINT32_MAX, "expire: no deadline without a stream");
+  feed(r, fs[0], t0, m);
+  feed(r, fs[1], t0 + 100, m);                 // a MID frame restarts the clock
+  const uint32_t last = t0 + 100;
+
+  check(r.msUntilDeadline(last) == TIMEOUT_MS, "expire: full timeout right after a frame");
+  check(r.expire(last + TIMEOUT_MS - 1) == 0 && r.msUntilDeadline(last + TIMEOUT_MS - 1) == 1,
+        "expire: kept at timeout - 1, 1 ms left");
+  check(r.expire(last + TIMEOUT_MS) == 0 && r.activeStreams() == 1 && r.msUntilDeadline(last + TIMEOUT_MS) == 0,
+        "expire: kept at exactly the timeout (strict >), 0 ms left");
+  check(r.expire(last + TIMEOUT_MS + 1) == 1 && r.activeStreams() == 0, "expire: dropped at timeout + 1");
+  check(r.timeouts() == 1 && r.evictLatLastMs() == 1 && r.evictLatMaxMs() == 1, "expire: timeout and lateness counted");
+
+  // A late check reports how far past the deadline it ran
+  feed(r, fs[0], 5000, m);
+  check(r.expire(5000 + TIMEOUT_MS + 40) == 1 && r.evictLatLastMs() == 40 && r.evictLatMaxMs() == 40,
+        "expire: lateness of a late check");
+
+  // millis() wrap
+  feed(r, fs[0], UINT32_MAX - 50, m);
+  check(r.expire(100) == 0 && r.expire(UINT32_MAX - 50 + TIMEOUT_MS + 1) == 1, "expire: across the millis() wrap");
+}
+
+// ---------------- Throughput ----------------
+static double nsPerFrame(Reassembler& r, const std::vector<Frame>& stream, uint32_t reps, uint32_t& completed) {
+  ReasmMessage m;
+  completed = 0;
+  auto t0 = std::chrono::steady_clock::now();
+  for (uint32_t k = 0; k < reps; k++)
+    for (auto& f : stream)
+      if (feed(r, f, k, m) == REASM_COMPLETE) completed++;
+  const double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - t0).count();
+  return ns / ((double)reps * stream.size());
+}
+
+static void bench(uint32_t msgs) {
+  const uint16_t lens[] = { 69, 132, 512 };
+  ::printf("throughput (%u messages per run)\n", msgs);
+  for (uint16_t len : lens) {
+    // One 14001 stream, back to back
+    Reassembler r1(TIMEOUT_MS, FAM_14001);
+    auto one = split(FAM_14001, buildWire(0x13, 1, len, 0x21, len));
+    uint32_t done1;
+    nsPerFrame(r1, one, msgs / 16 + 1, done1);           // warm-up
+    const double ns1 = nsPerFrame(r1, one, msgs, done1);
+
+    // REASM_SLOTS families, frame-interleaved
+    std::vector<std::vector<Frame>> per;
+    for (uint32_t i = 0; i < REASM_SLOTS; i++)
+      per.push_back(split(i == 0 ? FAM_14001 : FAM_3001 + i, buildWire(0x13, 1, len, (uint8_t)i, len + i)));
+    std::vector<Frame> mixed;
+    for (size_t k = 0; k < per[0].size(); k++)
+      for (auto& p : per) mixed.push_back(p[k]);
+    Reassembler rN(TIMEOUT_MS, FAM_14001);
+    uint32_t doneN;
+    const uint32_t repsN = msgs / REASM_SLOTS + 1;
+    nsPerFrame(rN, mixed, repsN / 16 + 1, doneN);
+    const double nsN = nsPerFrame(rN, mixed, repsN, doneN);
+
+    const bool ok = done1 == msgs && doneN == repsN * REASM_SLOTS;
+    if (!ok) failures++;
+    const double frameBytes = (double)(REASM_HDR_LEN + len + 2) / one.size();
+    ::printf("  %4u-byte payload  1 stream %6.1f ns/frame (%6.1f MB/s)   %u streams %6.1f ns/frame (%6.1f MB/s)%s\n",
+             len, ns1, frameBytes * 1e3 / ns1, REASM_SLOTS, nsN, frameBytes * 1e3 / nsN, ok ? "" : "  INCOMPLETE");
+  }
+}
+
+int main(int argc, char** argv) {
+  uint32_t msgs = 200000;
+  for (int i = 1; i < argc; i++) {
+    const char* v = (i + 1 < argc) ? argv[i + 1] : nullptr;
+    if      (!strcmp(argv[i], "-v"))       verbose = true;
+    else if (!strcmp(argv[i], "-n") && v)  { msgs = strtoul(v, nullptr, 0); i++; }
+    else {
+      ::printf("usage: %s [-n MSGS] [-v]\n", argv[0]);
+      return !strcmp(argv[i], "-h") || !strcmp(argv[i], "--help") ? 0 : 2;
+    }
+  }
+  if (!msgs) msgs = 1;
+
+  ::printf("REASM_SLOTS=%u, REASM_MAX_PAYLOAD=%u, timeout %u ms\n", REASM_SLOTS, REASM_MAX_PAYLOAD, TIMEOUT_MS);
+  testSingle();
+  testInterleaved();
+  testRestart();
+  testSteal();
+  testOrphans();
+  testOversize();
+  testEarlyEnd();
+  testExpire();
+  ::printf("checks: %s\n", failures ? "FAILED" : "ok");
+
+  bench(msgs);
+  ::printf("%s\n", failures ? "FAIL" : "PASS");
+  return failures ? 1 : 0;
+}
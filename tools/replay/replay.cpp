@@ -0,0 +1,178 @@
+// Host-side replay of candump logs through processEcoFlowCAN().
+//
+//   pio run -e native_replay && .pio/build/native_replay/program [-v] [--tx] log.txt [...]
+//   (or pipe a log on stdin)
+//
+// Feeds every "(ts) vcanRx ID#DATA" line to the real decoder/reassembler/
+// dispatch code with millis()/micros() following the log's timestamps, so
+// stream timeouts behave as they did on the bus. Replies the handlers queue
+// are counted through a stub canSubmit(); nothing is transmitted.
+#include <Arduino.h>
+#include <chrono>
+#include <vector>
+
+#include "ecoflow.h"
+#include "bms_params.h"
+#include "web.h"
+#include <SPIFFS.h>
+
+// ---------------- Host stubs for the firmware globals ----------------
+Config    config;
+bool      canHealth = false;
+BmsParams bmsParams;
+bool      bmsParamsValid    = false;
+uint32_t  bmsParamsLoadedMs = 0;
+HostSerial Serial;
+fs::FS     SPIFFS;
+
+volatile uint32_t can_rx_count   = 0;
+volatile uint32_t can_rx_dropped = 0;
+volatile uint32_t can_decoded    = 0;
+
+static uint64_t clockUs = 0;     // virtual time from the log
+static bool     verbose = false;
+
+uint32_t millis()              { return (uint32_t)(clockUs / 1000); }
+uint32_t micros()              { return (uint32_t)clockUs; }
+int64_t  esp_timer_get_time()  { return (int64_t)clockUs; }
+
+void HostSerial::printf(const char* fmt, ...) {
+  if (!verbose) return;
+  va_list ap;
+  va_start(ap, fmt);
+  vprintf(fmt, ap);
+  va_end(ap);
+}
+
+bool webCanLogActive() { return false; }
+bool webDebugActive()  { return verbose; }
+void streamDebug(const char* message) { if (verbose) printf("  dbg: %s\n", message); }
+
+static uint32_t txSubmitted[2] = {0, 0};
+bool canSubmit(CanTxPrio prio, uint32_t, uint32_t, uint32_t, const uint8_t*, size_t,
+               uint8_t, CanTxFirstFrameCb onFirst, uint32_t tagUs) {
+  txSubmitted[prio]++;
+  if (onFirst) onFirst(tagUs);
+  return true;
+}
+
+// ---------------- candump parsing ----------------
+static int hexNibble(char c) {
+  if (c >= '0' && c <= '9') return c - '0';
+  if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+  if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+  return -1;
+}
+
+// "(1700000000.123456) vcanRx 10014001#AABB..." -> false for anything else
+static bool parseLine(const char* line, bool wantTx, double& ts, twai_message_t& msg) {
+  char iface[32], frame[64];
+  if (sscanf(line, " (%lf) %31s %63s", &ts, iface, frame) != 3) return false;
+  const bool isTx = strstr(iface, "Tx") != nullptr;
+  if (isTx && !wantTx) return false;
+
+  char* hash = strchr(frame, '#');
+  if (!hash) return false;
+  *hash = 0;
+  char* end;
+  uint32_t id = strtoul(frame, &end, 16);
+  if (*end) return false;
+
+  msg = {};
+  msg.identifier = id & 0x1FFFFFFF;
+  msg.extd = (strlen(frame) > 3) ? 1 : 0;
+  const char* p = hash + 1;
+  uint8_t n = 0;
+  while (p[0] && p[1] && n < 8) {
+    int hi = hexNibble(p[0]), lo = hexNibble(p[1]);
+    if (hi < 0 || lo < 0) return false;
+    msg.data[n++] = (uint8_t)(hi << 4 | lo);
+    p += 2;
+  }
+  msg.data_length_code = n;
+  return true;
+}
+
+// ---------------- Replay ----------------
+static uint32_t replayFile(FILE* f, bool wantTx, double& firstTs, double& lastTs, uint32_t& skipped) {
+  char line[256];
+  uint32_t frames = 0;
+  while (fgets(line, sizeof(line), f)) {
+    double ts;
+    twai_message_t msg;
+    if (!parseLine(line, wantTx, ts, msg)) { skipped++; continue; }
+
+    if (frames == 0 && firstTs < 0) firstTs = ts;
+    if (firstTs >= 0 && ts >= firstTs) clockUs = (uint64_t)((ts - firstTs) * 1e6) + 1;
+    lastTs = ts;
+
+    ecoflowRxCheckTimeout();
+    processEcoFlowCAN(msg, micros());
+    can_rx_count++;
+    can_decoded++;
+    frames++;
+  }
+  return frames;
+}
+
+int main(int argc, char** argv) {
+  bool wantTx = false;
+  std::vector<const char*> files;
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "-v"))        verbose = true;
+    else if (!strcmp(argv[i], "--tx")) wantTx = true;
+    else if (!strcmp(argv[i], "-h") || !strcmp(argv[i], "--help")) {
+      ::printf("usage: %s [-v] [--tx] [candump.log ...]   (stdin when no file)\n", argv[0]);
+      return 0;
+    }
+    else files.push_back(argv[i]);
+  }
+
+  ecoflowHandlersInit();
+  ecoflowMessagesInit();
+
+  double   firstTs = -1, lastTs = 0;
+  uint32_t frames = 0, skipped = 0;
+  auto t0 = std::chrono::steady_clock::now();
+
+  if (files.empty()) {
+    frames += replayFile(stdin, wantTx, firstTs, lastTs, skipped);
+  } else {
+    for (const char* path : files) {
+      FILE* f = fopen(path, "r");
+      if (!f) { fprintf(stderr, "cannot open %s\n", path); return 2; }
+      frames += replayFile(f, wantTx, firstTs, lastTs, skipped);
+      fclose(f);
+    }
+  }
+  // Let a trailing partial stream run into its deadline
+  clockUs += 1000000;
+  ecoflowRxCheckTimeout();
+
+  double wallS = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+
+  ::printf("frames replayed : %u (skipped lines %u)\n", frames, skipped);
+  ::printf("log span        : %.3f s\n", firstTs >= 0 ? lastTs - firstTs : 0.0);
+  ::printf("decode time     : %.3f ms  -> %.0f frames/s\n", wallS * 1e3, wallS > 0 ? frames / wallS : 0.0);
+  ::printf("stream timeouts : %u (max eviction latency %u ms)\n",
+           ecoflowRxTimeouts(), ecoflowRxEvictLatMaxMs());
+  ::printf("slot steals     : %u\n", ecoflowRxSlotSteals());
+  ::printf("unhandled msgs  : %u\n", ecoflowUnhandledCount());
+  ::printf("tx submitted    : high=%u normal=%u\n", txSubmitted[CAN_TX_HIGH], txSubmitted[CAN_TX_NORMAL]);
+
+  ::printf("\ntype   ok      crc_fail\n");
+  uint32_t crcFailTotal = 0;
+  for (int t = 0; t < 256; t++) {
+    uint32_t ok = ecoflowRxCrcOk((uint8_t)t), bad = ecoflowRxCrcFail((uint8_t)t);
+    crcFailTotal += bad;
+    if (ok || bad) ::printf("0x%02X   %-7u %u\n", t, ok, bad);
+  }
+
+  // Handler µs stats are meaningless on the virtual clock; calls only
+  ::printf("\nhandler              calls\n");
+  EcoflowHandlerInfo h;
+  for (size_t i = 0; ecoflowHandlerInfo(i, h); i++)
+    ::printf("%-20s %u\n", h.name, h.calls);
+
+  return crcFailTotal ? 1 : 0;
+}
@@ -0,0 +1,213 @@
+// Multi-threaded host stress test of SpscRing (the CAN RX ring) against a
+// FreeRTOS-style locked queue.
+//
+//   pio run -e native_ringstress && .pio/build/native_ringstress/program [-d S] [-v]
+//
+// Producer and consumer run on their own threads with CanFrame records that
+// carry a sequence number and a check pattern. Three scenarios per container:
+//   flat-out   both sides as fast as they can (throughput)
+//   stalls     the consumer stops for 2 ms every ~1k frames, like the decode
+//              task losing the CPU, so the ring fills and drop-oldest runs
+//              continuously against a consumer mid-copy
+//   bursts     the producer sends 300-frame bursts (more than the ring holds)
+//              with pauses, like a PowerStream message storm
+// The "queue" is a copy-in/copy-out bounded FIFO under a lock, with the
+// xQueueSend(..., 0) semantics the RX task would have: full -> newest dropped.
+//
+// Checks (exit status 1 on any failure):
+//   - every delivered record is intact (no torn copies got through)
+//   - sequence numbers strictly increase (order kept, gaps = drops)
+//   - delivered + dropped == produced
+//   - single-threaded: overfilling the ring by k loses exactly the k oldest
+#include <Arduino.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+#include "can.h"
+#include "spsc_ring.h"
+
+HostSerial Serial;
+uint32_t millis() { return 0; }
+uint32_t micros() { return 0; }
+void     delay(uint32_t) {}
+
+static bool verbose = false;
+
+// ---------------- Records ----------------
+static inline void makeFrame(uint32_t seq, CanFrame& f) {
+  memset(&f, 0, sizeof(f));     // padding too: frameIntact() compares whole records
+  f.ts_us = seq;
+  f.id    = seq * 2654435761u;
+  f.dlc   = 8;
+  f.flags = CAN_FRAME_EXTD;
+  for (int i = 0; i < 8; i++) f.data[i] = (uint8_t)((seq >> (i & 3) * 8) ^ (0x5A + i));
+}
+
+static inline bool frameIntact(const CanFrame& f) {
+  CanFrame ref;
+  makeFrame(f.ts_us, ref);
+  return memcmp(&ref, &f, sizeof(ref)) == 0;
+}
+
+// ---------------- Containers under test ----------------
+static const uint32_t kCap = CAN_RX_RING;
+
+struct RingBox {
+  SpscRing<CanFrame, kCap> r;
+  static const char* name() { return "SpscRing"; }
+  bool     push(const CanFrame& f) { r.push(f); return true; }   // never refuses; drops oldest
+  bool     pop(CanFrame& f)        { return r.pop(f); }
+  uint32_t drops() const           { return r.drops(); }
+};
+
+// FreeRTOS queue model: copy under a lock, full -> sender fails (newest lost)
+struct QueueBox {
+  std::mutex           m;
+  std::deque<CanFrame> q;
+  uint32_t             dropped = 0;
+  static const char* name() { return "locked queue"; }
+  bool push(const CanFrame& f) {
+    std::lock_guard<std::mutex> l(m);
+    if (q.size() >= kCap) { dropped++; return false; }
+    q.push_back(f);
+    return true;
+  }
+  bool pop(CanFrame& f) {
+    std::lock_guard<std::mutex> l(m);
+    if (q.empty()) return false;
+    f = q.front();
+    q.pop_front();
+    return true;
+  }
+  uint32_t drops() { std::lock_guard<std::mutex> l(m); return dropped; }
+};
+
+// ---------------- One run ----------------
+enum Scenario { FLAT, STALLS, BURSTS };
+static const char* scenarioName(Scenario s) { return s == FLAT ? "flat-out" : s == STALLS ? "stalls" : "bursts"; }
+
+struct Result {
+  uint64_t produced = 0, delivered = 0, dropped = 0;
+  uint64_t torn = 0, reordered = 0, maxGap = 0;
+  double   seconds = 0;
+};
+
+static void spinUs(uint32_t us) {
+  auto t0 = std::chrono::steady_clock::now();
+  while (std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - t0).count() < us) {}
+}
+
+template <class Box>
+static Result runOne(Scenario sc, double seconds) {
+  Box box;
+  Result r;
+  std::atomic<bool>     done{false};
+  std::atomic<uint64_t> produced{0};
+
+  std::thread consumer([&] {
+    CanFrame f;
+    uint64_t last = 0;
+    bool     first = true;
+    uint32_t sinceStall = 0;
+    for (;;) {
+      if (!box.pop(f)) {
+        if (done.load(std::memory_order_acquire)) {
+          if (!box.pop(f)) break;        // final drain after the producer stopped
+        } else {
+          continue;
+        }
+      }
+      if (!frameIntact(f)) { r.torn++; continue; }
+      const uint64_t seq = f.ts_us;
+      if (!first && seq <= last) r.reordered++;
+      if (!first && seq - last - 1 > r.maxGap) r.maxGap = seq - last - 1;
+      last = seq;
+      first = false;
+      r.delivered++;
+      if (sc == STALLS && ++sinceStall >= 1000) {
+        sinceStall = 0;
+        std::this_thread::sleep_for(std::chrono::milliseconds(2));
+      }
+    }
+  });
+
+  auto t0 = std::chrono::steady_clock::now();
+  auto elapsed = [&] { return std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count(); };
+  uint32_t seq = 0;
+  CanFrame f;
+  while (elapsed() < seconds) {
+    const uint32_t batch = (sc == BURSTS) ? 300 : 4096;
+    for (uint32_t i = 0; i < batch; i++) {
+      makeFrame(seq++, f);
+      box.push(f);
+    }
+    if (sc == BURSTS) spinUs(500);
+  }
+  produced.store(seq);
+  done.store(true, std::memory_order_release);
+  consumer.join();
+
+  r.seconds  = elapsed();
+  r.produced = produced.load();
+  r.dropped  = box.drops();
+  return r;
+}
+
+template <class Box>
+static bool runAll(double seconds) {
+  bool ok = true;
+  for (Scenario sc : { FLAT, STALLS, BURSTS }) {
+    Result r = runOne<Box>(sc, seconds);
+    const bool balanced = r.delivered + r.dropped == r.produced;
+    const bool pass = balanced && r.torn == 0 && r.reordered == 0;
+    ok = ok && pass;
+    ::printf("%-13s %-9s %10.0f frames/s delivered, drop rate %6.3f%% (%llu of %llu), max gap %llu%s%s%s\n",
+             Box::name(), scenarioName(sc), r.delivered / r.seconds,
+             r.produced ? 100.0 * r.dropped / r.produced : 0.0,
+             (unsigned long long)r.dropped, (unsigned long long)r.produced, (unsigned long long)r.maxGap,
+             r.torn ? " TORN" : "", r.reordered ? " REORDERED" : "", balanced ? "" : " UNBALANCED");
+    if (verbose || !pass)
+      ::printf("    delivered %llu torn %llu reordered %llu\n",
+               (unsigned long long)r.delivered, (unsigned long long)r.torn, (unsigned long long)r.reordered);
+  }
+  return ok;
+}
+
+// Drop-oldest semantics, single-threaded and exact: overfill by k, the first
+// k records are gone and the newest N remain in order
+static bool dropOldestCheck() {
+  static SpscRing<CanFrame, kCap> r;
+  CanFrame f;
+  const uint32_t extra = 37;
+  for (uint32_t s = 0; s < kCap + extra; s++) { makeFrame(s, f); r.push(f); }
+  if (r.drops() != extra || r.size() != kCap) return false;
+  for (uint32_t s = extra; s < kCap + extra; s++) {
+    if (!r.pop(f) || f.ts_us != s || !frameIntact(f)) return false;
+  }
+  return !r.pop(f);
+}
+
+int main(int argc, char** argv) {
+  double seconds = 2;
+  for (int i = 1; i < argc; i++) {
+    const char* v = (i + 1 < argc) ? argv[i + 1] : nullptr;
+    if      (!strcmp(argv[i], "-v"))       verbose = true;
+    else if (!strcmp(argv[i], "-d") && v)  { seconds = atof(v); i++; }
+    else {
+      ::printf("usage: %s [-d S per scenario] [-v]\n", argv[0]);
+      return !strcmp(argv[i], "-h") || !strcmp(argv[i], "--help") ? 0 : 2;
+    }
+  }
+
+  bool ok = dropOldestCheck();
+  ::printf("drop-oldest (single thread): %s\n", ok ? "ok" : "FAILED");
+  ::printf("capacity %u, %.1f s per scenario, %u hw threads\n", kCap, seconds, std::thread::hardware_concurrency());
+  ok = runAll<RingBox>(seconds) && ok;
+  ok = runAll<QueueBox>(seconds) && ok;
+  ::printf("%s\n", ok ? "PASS" : "FAIL");
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,65 @@
+#pragma once
+// Host (Linux) stand-in for the Arduino core: just what the decoder path uses.
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <math.h>
+#include <string>
+
+#include "freertos/FreeRTOS.h"
+
+#define PROGMEM
+#define pgm_read_word_near(p) (*(const uint16_t*)(p))
+
+// Virtual clock, driven by the replay from the candump timestamps
+uint32_t millis();
+uint32_t micros();
+void     delay(uint32_t ms);
+inline long random(long lo, long hi) { return lo + (rand() % (hi - lo)); }
+
+class String {
+public:
+  String() {}
+  String(const char* s) : s_(s ? s : "") {}
+  String(const std::string& s) : s_(s) {}
+  String(unsigned long v) : s_(std::to_string(v)) {}
+  String(int v) : s_(std::to_string(v)) {}
+
+  String& operator=(const char* s) { s_ = s ? s : ""; return *this; }
+  String& operator+=(const char* s) { s_ += s; return *this; }
+  String& operator+=(const String& s) { s_ += s.s_; return *this; }
+  String& operator+=(char c) { s_ += c; return *this; }
+  friend String operator+(String a, const String& b) { a += b; return a; }
+  friend String operator+(String a, const char* b) { a += b; return a; }
+  bool operator==(const char* o) const { return s_ == o; }
+
+  void        reserve(size_t n) { s_.reserve(n); }
+  size_t      length() const { return s_.size(); }
+  const char* c_str() const { return s_.c_str(); }
+  char        operator[](size_t i) const { return s_[i]; }
+
+private:
+  std::string s_;
+};
+
+struct HostSerial {
+  void printf(const char* fmt, ...) __attribute__((format(printf, 2, 3)));
+  void println(const char* s = "") { ::printf("%s\n", s); }
+  void print(const char* s) { ::printf("%s", s); }
+};
+extern HostSerial Serial;
+
+// Byte stream interface: the base of bms_uart.h and of the simulated BMS in tools/bmsasync
+class Stream {
+public:
+  virtual ~Stream() {}
+  virtual int    available() = 0;
+  virtual int    read() = 0;
+  virtual int    peek() = 0;
+  virtual void   flush() {}
+  virtual size_t write(uint8_t c) = 0;
+  virtual size_t write(const uint8_t* buf, size_t n) = 0;
+};
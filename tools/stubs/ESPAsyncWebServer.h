@@ -0,0 +1,4 @@
+#pragma once
+// Host stand-in: web.h only needs the type names
+class AsyncWebServer {};
+class AsyncWebServerRequest {};
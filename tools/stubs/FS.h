@@ -0,0 +1,21 @@
+#pragma once
+#include <Arduino.h>
+
+// Host stand-in: no files, so the sequencer always runs its built-in table
+namespace fs {
+class File {
+public:
+  explicit operator bool() const { return false; }
+  size_t size() const { return 0; }
+  size_t read(uint8_t*, size_t) { return 0; }
+  size_t write(const uint8_t*, size_t) { return 0; }
+  void   close() {}
+};
+class FS {
+public:
+  bool exists(const char*) { return false; }
+  File open(const char*, const char* = "r") { return File(); }
+  bool remove(const char*) { return false; }
+};
+}
+using fs::File;
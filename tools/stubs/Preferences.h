@@ -0,0 +1,3 @@
+#pragma once
+// Host stand-in: nothing on the decoder path touches NVS
+class Preferences {};
@@ -0,0 +1,6 @@
+#pragma once
+// Host stand-in: the decoder never talks to the BMS directly
+class OverkillSolarBms2 {
+public:
+  void main_task(bool) {}
+};
@@ -0,0 +1,12 @@
+#pragma once
+#include <stdint.h>
+
+// Host stand-in for the ESP-IDF TWAI message layout
+typedef struct {
+  uint32_t extd : 1;
+  uint32_t rtr  : 1;
+  uint32_t      : 30;
+  uint32_t identifier;
+  uint8_t  data_length_code;
+  uint8_t  data[8];
+} twai_message_t;
@@ -0,0 +1,6 @@
+#pragma once
+#include "freertos/FreeRTOS.h"
+
+// Host stand-in: only the types bms_uart.h declares with
+typedef int uart_port_t;
+#define UART_NUM_1 1
@@ -0,0 +1,19 @@
+#pragma once
+#include <stdint.h>
+
+typedef void* esp_timer_handle_t;
+typedef struct {
+  void (*callback)(void*);
+  void*       arg;
+  int         dispatch_method;
+  const char* name;
+  bool        skip_unhandled_events;
+} esp_timer_create_args_t;
+
+#define ESP_OK   0
+#define ESP_FAIL -1
+
+int64_t esp_timer_get_time();
+inline int esp_timer_create(const esp_timer_create_args_t*, esp_timer_handle_t*) { return ESP_FAIL; }
+inline int esp_timer_start_once(esp_timer_handle_t, uint64_t) { return ESP_OK; }
+inline int esp_timer_stop(esp_timer_handle_t) { return ESP_OK; }
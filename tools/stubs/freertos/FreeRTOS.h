@@ -0,0 +1,50 @@
+#pragma once
+// Host stand-in: the host tools run the firmware on one thread, so the task
+// and critical-section primitives only need to compile. Queues are real
+// (bounded FIFOs) for can.cpp's TX queues.
+#include <stdint.h>
+#include <string.h>
+#include <deque>
+#include <vector>
+
+typedef void*    TaskHandle_t;
+typedef uint32_t TickType_t;
+typedef int      BaseType_t;
+struct portMUX_TYPE { int unused; };
+
+#define pdTRUE  1
+#define pdFALSE 0
+#define pdPASS  1
+#define portMAX_DELAY 0xFFFFFFFFu
+#define pdMS_TO_TICKS(ms) ((TickType_t)(ms))
+#define portMUX_INITIALIZER_UNLOCKED {0}
+#define portENTER_CRITICAL(m) ((void)(m))
+#define portEXIT_CRITICAL(m)  ((void)(m))
+
+inline void     xTaskNotifyGive(TaskHandle_t) {}
+inline uint32_t ulTaskNotifyTake(BaseType_t, TickType_t) { return 0; }
+inline BaseType_t xTaskCreatePinnedToCore(void (*)(void*), const char*, uint32_t, void*, int,
+                                          TaskHandle_t* h, int) { if (h) *h = nullptr; return pdFALSE; }
+inline void     vTaskDelay(TickType_t) {}
+
+struct HostQueue {
+  uint32_t cap;
+  uint32_t itemSize;
+  std::deque<std::vector<uint8_t>> items;
+};
+typedef HostQueue* QueueHandle_t;
+
+inline QueueHandle_t xQueueCreate(uint32_t len, uint32_t itemSize) { return new HostQueue{ len, itemSize, {} }; }
+inline BaseType_t xQueueSend(QueueHandle_t q, const void* item, TickType_t) {
+  if (q->items.size() >= q->cap) return pdFALSE;
+  const uint8_t* p = (const uint8_t*)item;
+  q->items.emplace_back(p, p + q->itemSize);
+  return pdTRUE;
+}
+inline BaseType_t xQueueReceive(QueueHandle_t q, void* item, TickType_t) {
+  if (q->items.empty()) return pdFALSE;
+  memcpy(item, q->items.front().data(), q->itemSize);
+  q->items.pop_front();
+  return pdTRUE;
+}
+inline uint32_t uxQueueMessagesWaiting(QueueHandle_t q) { return (uint32_t)q->items.size(); }
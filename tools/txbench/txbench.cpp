@@ -0,0 +1,243 @@
+// Host benchmark of the sequencer TX path: CPU cost of one full kSeq cycle.
+//
+//   pio run -e native_txbench && .pio/build/native_txbench/program [-n CYCLES] [-v]
+//
+// Two ways of producing the same cycle of messages:
+//   old        what sendAction did before the template cache: prepareMessageXX
+//              into payload_XX, then sendCANMessage (key, CRC over header +
+//              encoded payload, wire image built per send)
+//   template   the real sequencer: ecoflowSequencerService() on a virtual
+//              clock, one step per call; 70/0B/CB/5C go through sendTemplate,
+//              4F/68/13 still through prepare + sendCANMessage
+// Both walk the active step table (read back through ecoflowTxSeqJson) and
+// end in the same canSubmit stand-in, which copies the wire bytes like the
+// TX queue does. The sequencer is also timed with every message disabled;
+// that bookkeeping is subtracted from the template figure.
+//
+// Checks (exit status 1 on any failure): with the same starting xorCounter,
+// both paths submit byte-identical messages in the same order, and the
+// template path, net of bookkeeping, is faster than the old path.
+#include <Arduino.h>
+#include <chrono>
+#include <vector>
+
+#include "ecoflow.h"
+#include "bms_params.h"
+#include "bms_snapshot.h"
+#include "reassembler.h"
+#include "tx_seq.h"
+#include "web.h"
+#include <SPIFFS.h>
+
+// ---------------- Host stubs for the firmware globals ----------------
+Config    config;
+bool      canHealth = false;
+BmsParams bmsParams;
+bool      bmsParamsValid    = false;
+uint32_t  bmsParamsLoadedMs = 0;
+HostSerial Serial;
+fs::FS     SPIFFS;
+
+volatile uint32_t can_rx_count   = 0;
+volatile uint32_t can_rx_dropped = 0;
+volatile uint32_t can_decoded    = 0;
+
+static uint64_t nowUs   = 1;     // virtual time; only the sequencer schedule reads it
+static bool     verbose = false;
+
+uint32_t millis()              { return (uint32_t)(nowUs / 1000); }
+uint32_t micros()              { return (uint32_t)nowUs; }
+int64_t  esp_timer_get_time()  { return (int64_t)nowUs; }
+
+void HostSerial::printf(const char* fmt, ...) {
+  if (!verbose) return;
+  va_list ap;
+  va_start(ap, fmt);
+  vprintf(fmt, ap);
+  va_end(ap);
+}
+
+bool webCanLogActive() { return false; }
+bool webDebugActive()  { return false; }
+void streamDebug(const char*) {}
+
+// ---------------- canSubmit stand-in ----------------
+// Copies the message like canTxTask's queue; optionally keeps it for the check
+static uint8_t  submitBuf[CAN_TX_MSG_MAX];
+static uint32_t submitCount = 0;
+static std::vector<std::vector<uint8_t>>* capture = nullptr;
+
+bool canSubmit(CanTxPrio, uint32_t, uint32_t, uint32_t,
+               const uint8_t* bytes, size_t len, uint8_t, CanTxFirstFrameCb, uint32_t) {
+  if (!bytes || len == 0 || len > CAN_TX_MSG_MAX) return false;
+  memcpy(submitBuf, bytes, len);
+  submitCount++;
+  if (capture) capture->emplace_back(bytes, bytes + len);
+  return true;
+}
+
+// ---------------- Old path ----------------
+// Name-keyed, so the table read back from the firmware maps onto it directly
+struct OldAction {
+  const char* name;
+  uint8_t*    header;
+  uint8_t*    payload;
+  void      (*prepare)(uint8_t*);
+};
+static const OldAction kOld[] = {
+  {"70",     header_70,     payload_70, prepareMessage70},
+  {"0B_04",  header_0B_04,  payload_0B, prepareMessage0B},
+  {"0B_02",  header_0B_02,  payload_0B, prepareMessage0B},
+  {"0B_05",  header_0B_05,  payload_0B, prepareMessage0B},
+  {"0B_50",  header_0B_50,  payload_0B, prepareMessage0B},
+  {"0B_08",  header_0B_08,  payload_0B, prepareMessage0B},
+  {"4F",     header_4F,     payload_4F, prepareMessage4F},
+  {"68",     header_68,     payload_68, prepareMessage68},
+  {"13",     header_13,     payload_13, prepareMessage13},
+  {"CB_321", header_CB_321, payload_CB, prepareMessageCB},
+  {"CB_141", header_CB_141, payload_CB, prepareMessageCB},
+  {"5C",     header_5C,     payload_5C, prepareMessage5C},
+  {"CB_150", header_CB_150, payload_CB, prepareMessageCB},
+};
+static const uint8_t kOldCount = sizeof(kOld) / sizeof(kOld[0]);
+
+static TxSeqStep steps[TXSEQ_MAX_STEPS];
+static uint8_t   stepCount = 0;
+
+// Active table as the sequencer sees it
+static bool loadSteps() {
+  const char* names[kOldCount];
+  for (uint8_t i = 0; i < kOldCount; i++) names[i] = kOld[i].name;
+
+  String json, err;
+  ecoflowTxSeqJson(json);
+  const char* s = strstr(json.c_str(), "\"steps\":");
+  if (!s) return false;
+  s += 8;
+  const size_t len = strlen(s) - 1;            // drop the closing '}'
+  stepCount = txSeqParse(s, len, names, kOldCount, steps, TXSEQ_MAX_STEPS, err);
+  if (!stepCount) ::printf("step table: %s\n", err.c_str());
+  return stepCount > 0;
+}
+
+static void oldCycle() {
+  for (uint8_t i = 0; i < stepCount; i++) {
+    if (!steps[i].enabled) continue;
+    const OldAction& a = kOld[steps[i].act];
+    // Payload length is header bytes 2..3 (LE)
+    const size_t plSize = a.header[2] | (a.header[3] << 8);
+    a.prepare(a.payload);
+    sendCANMessage(a.header, a.payload, REASM_HDR_LEN, plSize);
+  }
+}
+
+// ---------------- Template path ----------------
+// One step per call: the clock is moved to each step's due time in between
+static void templateCycle() {
+  canSequencer_onHeartbeatC4();              // stay ahead of the C4 loss timeout
+  for (uint8_t i = 0; i < stepCount; i++) {
+    int64_t wait = ecoflowSequencerService();
+    nowUs += wait > 0 ? (uint64_t)wait : 1;
+  }
+}
+
+// ---------------- Timing ----------------
+template <class Fn>
+static double usPerCycle(Fn fn, uint32_t cycles) {
+  auto t0 = std::chrono::steady_clock::now();
+  for (uint32_t c = 0; c < cycles; c++) fn();
+  return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - t0).count() / cycles;
+}
+
+// Best of a few runs, so a descheduled run does not count
+template <class Fn>
+static double bestUsPerCycle(Fn fn, uint32_t cycles) {
+  double best = 1e30;
+  for (int r = 0; r < 5; r++) {
+    double us = usPerCycle(fn, cycles);
+    if (us < best) best = us;
+  }
+  return best;
+}
+
+static void setMessages(bool on) {
+  config.message70 = config.message0B = config.message4F = config.message68 =
+  config.message13 = config.messageCB = config.message5C = on;
+}
+
+int main(int argc, char** argv) {
+  uint32_t cycles = 20000;
+  for (int i = 1; i < argc; i++) {
+    const char* v = (i + 1 < argc) ? argv[i + 1] : nullptr;
+    if      (!strcmp(argv[i], "-v"))       verbose = true;
+    else if (!strcmp(argv[i], "-n") && v)  { cycles = (uint32_t)atoi(v); i++; }
+    else {
+      ::printf("usage: %s [-n CYCLES] [-v]\n", argv[0]);
+      return !strcmp(argv[i], "-h") || !strcmp(argv[i], "--help") ? 0 : 2;
+    }
+  }
+  if (!cycles) cycles = 1;
+
+  // Bridge bring-up, as in psim
+  BmsSnapshot s = {};
+  s.numCells = 16;
+  for (uint8_t c = 0; c < 16; c++) s.cellMv[c] = 3300 + c;
+  s.minCellMv = 3300; s.maxCellMv = 3315;
+  s.bmsPackMv = s.packMv = 52920;
+  s.packMa = -8000; s.outputW = -423;
+  s.bmsSoc = s.soc = 55;
+  s.temp = 25;
+  s.mosdis = s.moschg = true;
+  bmsSnapshotPublish(s);
+  ecoflowHandlersInit();
+  ecoflowMessagesInit();
+  ecoflowTxSeqLoad();
+  ecoflowSequencerService();                 // adopt the staged table
+  if (!loadSteps()) { ::printf("no step table\n"); return 1; }
+
+  // ---- Equivalence: same keys in, same wire bytes out ----
+  std::vector<std::vector<uint8_t>> oldMsgs, tplMsgs;
+  templateCycle();                           // first sends build the templates
+  xorCounter = 0x5A;
+  capture = &tplMsgs;
+  templateCycle();
+  xorCounter = 0x5A;
+  capture = &oldMsgs;
+  oldCycle();
+  capture = nullptr;
+
+  uint32_t mismatches = 0;
+  size_t   bytesPerCycle = 0;
+  if (oldMsgs.size() != tplMsgs.size()) mismatches++;
+  for (size_t i = 0; i < oldMsgs.size() && i < tplMsgs.size(); i++) {
+    bytesPerCycle += tplMsgs[i].size();
+    if (oldMsgs[i] != tplMsgs[i]) {
+      mismatches++;
+      if (verbose) ::printf("message %zu (type 0x%02X) differs\n", i, tplMsgs[i].size() > 4 ? tplMsgs[i][4] : 0);
+    }
+  }
+  ::printf("cycle: %u steps, %zu messages, %zu bytes; old == template: %s\n",
+           stepCount, tplMsgs.size(), bytesPerCycle, mismatches ? "NO" : "yes");
+
+  // ---- Timing ----
+  const double oldUs = bestUsPerCycle(oldCycle, cycles);
+  const double tplUs = bestUsPerCycle(templateCycle, cycles);
+  setMessages(false);
+  const double seqUs = bestUsPerCycle(templateCycle, cycles);
+  setMessages(true);
+  const double tplNet = tplUs > seqUs ? tplUs - seqUs : 0.0;
+  const bool   faster = tplNet > 0 && tplNet < oldUs;
+
+  ::printf("%u cycles, best of 5 runs (us per cycle)\n", cycles);
+  ::printf("  old (prepare + sendCANMessage)    %8.2f\n", oldUs);
+  ::printf("  template (sequencer, sendTemplate)%8.2f\n", tplUs);
+  ::printf("  sequencer bookkeeping only        %8.2f\n", seqUs);
+  ::printf("  template, net of bookkeeping      %8.2f   x%.2f vs old\n",
+           tplNet, tplNet > 0 ? oldUs / tplNet : 0.0);
+  ::printf("  submits %u\n", submitCount);
+  if (!faster) ::printf("template path is not faster than the old path\n");
+
+  const bool ok = !mismatches && faster;
+  ::printf("%s\n", ok ? "PASS" : "FAIL");
+  return ok ? 0 : 1;
+}